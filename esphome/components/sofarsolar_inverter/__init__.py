@@ -1,21 +1,161 @@
 import esphome.codegen as cg
-from esphome.components import sensor, modbus
+from esphome import automation
+from esphome.components import sensor, modbus, uart
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome.const import CONF_ABOVE, CONF_BELOW, CONF_DURATION, CONF_FOR, CONF_ID, CONF_HOST, CONF_INTERVAL, CONF_NAME, CONF_PORT, CONF_PROTOCOL, CONF_TIMEOUT, CONF_TRIGGER_ID, CONF_UART_ID
 
-DEPENDENCIES = ["modbus"]
-AUTO_LOAD = ["binary_sensor", "button", "text_sensor", "sensor", "switch", "output"]
+# The modbus component is not auto loaded, it needs a UART. Setups on the bus configure it, TCP gateways do without.
+AUTO_LOAD = ["binary_sensor", "button", "number", "text_sensor", "sensor", "switch", "output", "socket"]
 MULTI_CONF = True
 
 CONF_MODEL = "model"
 CONF_MODBUS_ADDRESS = "modbus_address"
 CONF_ZERO_EXPORT = "zero_export"
 CONF_POWER_ID = "power_id"
+CONF_POWER_SNAPSHOT_INTERVAL = "power_snapshot_interval"
+CONF_POWER_METER_MAX_AGE = "power_meter_max_age"
+CONF_BUS_RECORDER_SIZE = "bus_recorder_size"
+CONF_LOOP_BUDGET = "loop_budget"
+CONF_PUBLISH_BUDGET = "publish_budget"
+CONF_PHASE_STATISTICS_INTERVAL = "phase_statistics_interval"
+CONF_FRESHNESS = "freshness"
+CONF_FRESHNESS_INTERVAL = "interval"
+CONF_FRESHNESS_TARGET = "target"
+CONF_STALE_AFTER = "stale_after"
+CONF_TARGET_UTILISATION = "target_utilisation"
+CONF_COMBINED_WRITE_READ = "combined_write_read"
+CONF_POLLING_PROFILES = "polling_profiles"
+CONF_WHEN = "when"
+CONF_REGISTER = "register"
+CONF_INTERVALS = "intervals"
+CONF_TCP = "tcp"
+CONF_TELEMETRY = "telemetry"
+CONF_REGISTERS = "registers"
+CONF_BATCH_INTERVAL = "batch_interval"
+CONF_UDP = "udp"
+CONF_MQTT_TOPIC = "mqtt_topic"
+CONF_ON_WRITE_COMPLETE = "on_write_complete"
+CONF_ON_READ_FAILED = "on_read_failed"
+CONF_ON_SCAN_DATA = "on_scan_data"
+CONF_CAPTURE_BUFFER_SIZE = "capture_buffer_size"
+CONF_ON_CAPTURE_COMPLETE = "on_capture_complete"
+CONF_ON_CAPTURE_DATA = "on_capture_data"
+CONF_START = "start"
+CONF_END = "end"
+CONF_FORMAT = "format"
+CONF_RESOLUTION = "resolution"
+CONF_MAX_OUTSTANDING = "max_outstanding"
+CONF_IO_TASK = "io_task"
+CONF_CORE = "core"
+CONF_PRIORITY = "priority"
+CONF_BAUD_RATE_DETECTION = "baud_rate_detection"
+CONF_BAUD_RATES = "baud_rates"
+CONF_TARGET_BAUD_RATE = "target_baud_rate"
+CONF_SPEED_SETTING_REGISTER = "speed_setting_register"
+CONF_SPEED_SETTING_VALUES = "speed_setting_values"
+
+BAUD_RATES = [9600, 19200, 38400, 57600, 115200]
+
+TCP_PROTOCOLS = {
+    "modbus_tcp": 0x01,
+    "rtu_over_tcp": 0x02,
+}
+
+# RTU over TCP has no transaction ids, a late response would be taken for the response of the next request
+def validate_tcp(config):
+    if config[CONF_PROTOCOL] == "rtu_over_tcp":
+        if config.get(CONF_MAX_OUTSTANDING, 1) > 1:
+            raise cv.Invalid(f"{CONF_MAX_OUTSTANDING} has to be 1 for rtu_over_tcp, responses have no transaction id")
+        config[CONF_MAX_OUTSTANDING] = 1
+    elif CONF_MAX_OUTSTANDING not in config:
+        config[CONF_MAX_OUTSTANDING] = 4
+    return config
+
+TCP_SCHEMA = cv.All(cv.Schema({
+    cv.Required(CONF_HOST): cv.ipv4address,
+    cv.Optional(CONF_PORT, default=502): cv.port,
+    cv.Optional(CONF_PROTOCOL, default="modbus_tcp"): cv.one_of(*TCP_PROTOCOLS, lower=True),
+    cv.Optional(CONF_MAX_OUTSTANDING): cv.int_range(1, 16),
+    cv.Optional(CONF_TIMEOUT, default="1s"): cv.positive_time_period_milliseconds,
+    # Runs the TCP transport on a FreeRTOS task of its own, only the dual core ESP32 variants gain from it
+    cv.Optional(CONF_IO_TASK): cv.All(cv.Schema({
+        cv.Optional(CONF_CORE, default=0): cv.int_range(0, 1),
+        cv.Optional(CONF_PRIORITY, default=5): cv.int_range(1, 24),
+    }), cv.only_on_esp32),
+}), validate_tcp)
+
+# Sensor names whose register key is not the upper case name
+REGISTER_KEYS = {f"battery_temperature_environment_{i}": f"BATTERY_TEMPERATUR_ENV_{i}" for i in range(1, 9)}
+
+def register_key(name):
+    return cg.RawExpression(REGISTER_KEYS.get(name, name.upper()))
+
+def validate_register_name(value):
+    from .sensor import TYPES  # The sensor platform imports this module, its names are only known at validation time
+    return cv.one_of(*TYPES, lower=True)(value)
+
+POLLING_PROFILE_SCHEMA = cv.Schema({
+    cv.Required(CONF_NAME): cv.string,
+    cv.Required(CONF_WHEN): cv.All(cv.Schema({
+        cv.Required(CONF_REGISTER): validate_register_name,
+        cv.Optional(CONF_ABOVE): cv.float_,
+        cv.Optional(CONF_BELOW): cv.float_,
+        cv.Optional(CONF_FOR, default="0s"): cv.positive_time_period_milliseconds,
+    }), cv.has_at_least_one_key(CONF_ABOVE, CONF_BELOW)),
+    cv.Required(CONF_INTERVALS): cv.Schema({validate_register_name: cv.positive_time_period_seconds}),
+})
+
+# Raw samples of the listed registers, streamed in delta encoded batches instead of published one by one
+TELEMETRY_SCHEMA = cv.All(cv.Schema({
+    cv.Required(CONF_REGISTERS): cv.All(cv.ensure_list(validate_register_name), cv.Length(min=1, max=32)),
+    cv.Optional(CONF_INTERVAL, default="250ms"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_BATCH_INTERVAL, default="1s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_UDP): cv.Schema({
+        cv.Required(CONF_HOST): cv.ipv4address,
+        cv.Required(CONF_PORT): cv.port,
+    }),
+    cv.Optional(CONF_MQTT_TOPIC): cv.All(cv.requires_component("mqtt"), cv.publish_topic),
+}), cv.has_at_least_one_key(CONF_UDP, CONF_MQTT_TOPIC))
+
+def validate_baud_rate_detection(config):
+    if CONF_TARGET_BAUD_RATE in config:
+        if CONF_SPEED_SETTING_REGISTER not in config:
+            raise cv.Invalid(f"{CONF_SPEED_SETTING_REGISTER} is required to switch to {CONF_TARGET_BAUD_RATE}")
+        if config[CONF_TARGET_BAUD_RATE] not in config[CONF_SPEED_SETTING_VALUES]:
+            raise cv.Invalid(f"{CONF_SPEED_SETTING_VALUES} has no value for {config[CONF_TARGET_BAUD_RATE]} baud")
+    return config
+
+# The speed setting register and its values differ between firmware versions, they have to be configured
+BAUD_RATE_DETECTION_SCHEMA = cv.All(
+    cv.Schema({
+        cv.Required(CONF_UART_ID): cv.use_id(uart.UARTComponent),
+        cv.Optional(CONF_BAUD_RATES, default=[9600, 19200, 38400, 115200]): cv.ensure_list(cv.one_of(*BAUD_RATES, int=True)),
+        cv.Optional(CONF_TARGET_BAUD_RATE): cv.one_of(*BAUD_RATES, int=True),
+        cv.Optional(CONF_SPEED_SETTING_REGISTER): cv.hex_uint16_t,
+        cv.Optional(CONF_SPEED_SETTING_VALUES, default={}): cv.Schema({cv.one_of(*BAUD_RATES, int=True): cv.uint16_t}),
+    }),
+    validate_baud_rate_detection,
+)
 
 CONF_SOFARSOLAR_INVERTER_ID = "sofarsolar_inverter_id"
 
 sofarsolar_inverter_ns = cg.esphome_ns.namespace("sofarsolar_inverter")
 SofarSolar_Inverter = sofarsolar_inverter_ns.class_("SofarSolar_Inverter", cg.Component, modbus.ModbusDevice)
+SofarSolar_WriteCompleteTrigger = sofarsolar_inverter_ns.class_("SofarSolar_WriteCompleteTrigger", automation.Trigger.template(cg.uint16))
+SofarSolar_ReadFailedTrigger = sofarsolar_inverter_ns.class_("SofarSolar_ReadFailedTrigger", automation.Trigger.template(cg.uint16, cg.std_string))
+SofarSolar_ScanDataTrigger = sofarsolar_inverter_ns.class_("SofarSolar_ScanDataTrigger", automation.Trigger.template(cg.uint16, cg.std_string))
+SofarSolar_ScanRegistersAction = sofarsolar_inverter_ns.class_("SofarSolar_ScanRegistersAction", automation.Action)
+SofarSolar_CaptureCompleteTrigger = sofarsolar_inverter_ns.class_("SofarSolar_CaptureCompleteTrigger", automation.Trigger.template())
+SofarSolar_CaptureDataTrigger = sofarsolar_inverter_ns.class_("SofarSolar_CaptureDataTrigger", automation.Trigger.template(cg.std_string))
+SofarSolar_StartCaptureAction = sofarsolar_inverter_ns.class_("SofarSolar_StartCaptureAction", automation.Action)
+SofarSolar_StopCaptureAction = sofarsolar_inverter_ns.class_("SofarSolar_StopCaptureAction", automation.Action)
+SofarSolar_DumpCaptureAction = sofarsolar_inverter_ns.class_("SofarSolar_DumpCaptureAction", automation.Action)
+SofarSolar_StopScanAction = sofarsolar_inverter_ns.class_("SofarSolar_StopScanAction", automation.Action)
+
+SCAN_FORMATS = {
+    "hex": 0,
+    "json": 1,
+}
 
 SOFARSOLAR_INVERTER_COMPONENT_SCHEMA = cv.Schema(
     {
@@ -23,18 +163,78 @@ SOFARSOLAR_INVERTER_COMPONENT_SCHEMA = cv.Schema(
     }
 )
 
-CONFIG_SCHEMA = cv.Schema({
+BASE_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(SofarSolar_Inverter),
     cv.Required(CONF_MODEL): cv.string,
     cv.Optional(CONF_MODBUS_ADDRESS, default=1): cv.int_range(0, 255),
     cv.Optional(CONF_ZERO_EXPORT, default=False): cv.boolean,
     cv.Optional(CONF_POWER_ID): cv.use_id(sensor.Sensor),
-}).extend(modbus.modbus_device_schema(0x01))
+    cv.Optional(CONF_POWER_SNAPSHOT_INTERVAL): cv.positive_time_period_milliseconds,
+    # The zero export control limits the export to 0 when the last reading of power_id is older
+    cv.Optional(CONF_POWER_METER_MAX_AGE, default="5s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_BUS_RECORDER_SIZE, default=0): cv.int_range(0, 1024),
+    cv.Optional(CONF_LOOP_BUDGET): cv.positive_time_period_microseconds,
+    cv.Optional(CONF_PUBLISH_BUDGET, default="2ms"): cv.positive_time_period_microseconds,
+    cv.Optional(CONF_PHASE_STATISTICS_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_FRESHNESS, default={}): cv.Schema({
+        cv.Optional(CONF_FRESHNESS_INTERVAL, default="10s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_FRESHNESS_TARGET, default=2.0): cv.float_range(min=1.0),
+        cv.Optional(CONF_STALE_AFTER, default=0): cv.int_range(0, 255),
+    }),
+    cv.Optional(CONF_TARGET_UTILISATION, default="80%"): cv.percentage,
+    cv.Optional(CONF_COMBINED_WRITE_READ, default=True): cv.boolean,
+    cv.Optional(CONF_POLLING_PROFILES): cv.ensure_list(POLLING_PROFILE_SCHEMA),
+    cv.Optional(CONF_TELEMETRY): TELEMETRY_SCHEMA,
+    # Samples of one capture, 12 bytes each, allocated at boot
+    cv.Optional(CONF_CAPTURE_BUFFER_SIZE, default=0): cv.int_range(0, 16384),
+    cv.Optional(CONF_ON_WRITE_COMPLETE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SofarSolar_WriteCompleteTrigger),
+    }),
+    cv.Optional(CONF_ON_READ_FAILED): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SofarSolar_ReadFailedTrigger),
+    }),
+    cv.Optional(CONF_ON_SCAN_DATA): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SofarSolar_ScanDataTrigger),
+    }),
+    cv.Optional(CONF_ON_CAPTURE_COMPLETE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SofarSolar_CaptureCompleteTrigger),
+    }),
+    cv.Optional(CONF_ON_CAPTURE_DATA): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SofarSolar_CaptureDataTrigger),
+    }),
+})
+
+# The inverter is either a device on a modbus bus or reached through a TCP gateway
+CONFIG_SCHEMA = cv.Any(
+    BASE_SCHEMA.extend({cv.Required(CONF_TCP): TCP_SCHEMA}),
+    BASE_SCHEMA.extend({cv.Optional(CONF_BAUD_RATE_DETECTION): BAUD_RATE_DETECTION_SCHEMA}).extend(modbus.modbus_device_schema(0x01)),
+)
 
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
-    await modbus.register_modbus_client_device(var, config)
+    if tcp_config := config.get(CONF_TCP):
+        cg.add(var.set_tcp_transport(
+            str(tcp_config[CONF_HOST]),
+            tcp_config[CONF_PORT],
+            TCP_PROTOCOLS[tcp_config[CONF_PROTOCOL]],
+            tcp_config[CONF_MAX_OUTSTANDING],
+            tcp_config[CONF_TIMEOUT],
+        ))
+        if io_task_config := tcp_config.get(CONF_IO_TASK):
+            cg.add(var.set_io_task(io_task_config[CONF_CORE], io_task_config[CONF_PRIORITY]))
+    else:
+        cg.add_define("USE_SOFARSOLAR_MODBUS")
+        await modbus.register_modbus_client_device(var, config)
+        if detection_config := config.get(CONF_BAUD_RATE_DETECTION):
+            uart_component = await cg.get_variable(detection_config[CONF_UART_ID])
+            cg.add(var.set_uart(uart_component))
+            for baud_rate in detection_config[CONF_BAUD_RATES]:
+                cg.add(var.add_baud_rate(baud_rate))
+            if CONF_TARGET_BAUD_RATE in detection_config:
+                cg.add(var.set_target_baud_rate(detection_config[CONF_TARGET_BAUD_RATE], detection_config[CONF_SPEED_SETTING_REGISTER]))
+                for baud_rate, value in detection_config[CONF_SPEED_SETTING_VALUES].items():
+                    cg.add(var.add_speed_setting_value(baud_rate, value))
 
     cg.add(var.set_model(config[CONF_MODEL]))
     cg.add(var.set_modbus_address(config[CONF_MODBUS_ADDRESS]))
@@ -42,4 +242,144 @@ async def to_code(config):
 
     if bar := config.get(CONF_POWER_ID):
         power_sensor = await cg.get_variable(config[CONF_POWER_ID])
-        cg.add(var.set_power_id(power_sensor))
\ No newline at end of file
+        cg.add(var.set_power_id(power_sensor))
+
+    if CONF_POWER_SNAPSHOT_INTERVAL in config:
+        cg.add(var.set_power_snapshot_interval(config[CONF_POWER_SNAPSHOT_INTERVAL]))
+    cg.add(var.set_power_meter_max_age(config[CONF_POWER_METER_MAX_AGE]))
+
+    if config[CONF_BUS_RECORDER_SIZE] > 0:
+        cg.add(var.set_bus_recorder_size(config[CONF_BUS_RECORDER_SIZE]))
+
+    if CONF_LOOP_BUDGET in config:
+        cg.add(var.set_loop_budget(config[CONF_LOOP_BUDGET]))
+    cg.add(var.set_publish_budget(config[CONF_PUBLISH_BUDGET]))
+    cg.add(var.set_phase_statistics_interval(config[CONF_PHASE_STATISTICS_INTERVAL]))
+    freshness_config = config[CONF_FRESHNESS]
+    cg.add(var.set_freshness(freshness_config[CONF_FRESHNESS_INTERVAL], freshness_config[CONF_FRESHNESS_TARGET], freshness_config[CONF_STALE_AFTER]))
+    cg.add(var.set_target_utilisation(config[CONF_TARGET_UTILISATION]))
+    cg.add(var.set_combined_write_read(config[CONF_COMBINED_WRITE_READ]))
+    for index, profile_config in enumerate(config.get(CONF_POLLING_PROFILES, [])):
+        when_config = profile_config[CONF_WHEN]
+        cg.add(var.add_polling_profile(
+            profile_config[CONF_NAME],
+            register_key(when_config[CONF_REGISTER]),
+            when_config.get(CONF_ABOVE, cg.RawExpression("NAN")),
+            when_config.get(CONF_BELOW, cg.RawExpression("NAN")),
+            when_config[CONF_FOR],
+        ))
+        for name, interval in profile_config[CONF_INTERVALS].items():
+            cg.add(var.add_polling_profile_interval(index, register_key(name), interval))
+    if config[CONF_CAPTURE_BUFFER_SIZE] > 0:
+        cg.add(var.set_capture_buffer_size(config[CONF_CAPTURE_BUFFER_SIZE]))
+    if telemetry_config := config.get(CONF_TELEMETRY):
+        cg.add(var.set_telemetry(telemetry_config[CONF_INTERVAL], telemetry_config[CONF_BATCH_INTERVAL]))
+        for name in telemetry_config[CONF_REGISTERS]:
+            cg.add(var.add_telemetry_register(register_key(name)))
+        if udp_config := telemetry_config.get(CONF_UDP):
+            cg.add(var.set_telemetry_udp(str(udp_config[CONF_HOST]), udp_config[CONF_PORT]))
+        if CONF_MQTT_TOPIC in telemetry_config:
+            cg.add(var.set_telemetry_mqtt_topic(telemetry_config[CONF_MQTT_TOPIC]))
+    for conf in config.get(CONF_ON_WRITE_COMPLETE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.uint16, "address")], conf)
+    for conf in config.get(CONF_ON_READ_FAILED, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.uint16, "address"), (cg.std_string, "reason")], conf)
+    for conf in config.get(CONF_ON_SCAN_DATA, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.uint16, "address"), (cg.std_string, "data")], conf)
+    for conf in config.get(CONF_ON_CAPTURE_COMPLETE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [], conf)
+    for conf in config.get(CONF_ON_CAPTURE_DATA, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.std_string, "line")], conf)
+
+
+def validate_scan_range(config):
+    if isinstance(config[CONF_START], int) and isinstance(config[CONF_END], int) and config[CONF_END] < config[CONF_START]:
+        raise cv.Invalid(f"{CONF_END} has to be at or after {CONF_START}")
+    return config
+
+
+@automation.register_action(
+    "sofarsolar_inverter.scan_registers",
+    SofarSolar_ScanRegistersAction,
+    cv.All(
+        cv.Schema({
+            cv.GenerateID(): cv.use_id(SofarSolar_Inverter),
+            cv.Required(CONF_START): cv.templatable(cv.hex_uint16_t),
+            cv.Required(CONF_END): cv.templatable(cv.hex_uint16_t),
+            cv.Optional(CONF_FORMAT, default="hex"): cv.enum(SCAN_FORMATS, lower=True),
+            cv.Optional(CONF_RESOLUTION, default=1): cv.int_range(1, 125),
+        }),
+        validate_scan_range,
+    ),
+)
+async def scan_registers_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, parent)
+    start_address = await cg.templatable(config[CONF_START], args, cg.uint16)
+    cg.add(var.set_start_address(start_address))
+    end_address = await cg.templatable(config[CONF_END], args, cg.uint16)
+    cg.add(var.set_end_address(end_address))
+    cg.add(var.set_format(config[CONF_FORMAT]))
+    cg.add(var.set_resolution(config[CONF_RESOLUTION]))
+    return var
+
+
+@automation.register_action(
+    "sofarsolar_inverter.stop_scan",
+    SofarSolar_StopScanAction,
+    automation.maybe_simple_id({
+        cv.GenerateID(): cv.use_id(SofarSolar_Inverter),
+    }),
+)
+async def stop_scan_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, parent)
+
+
+@automation.register_action(
+    "sofarsolar_inverter.start_capture",
+    SofarSolar_StartCaptureAction,
+    cv.Schema({
+        cv.GenerateID(): cv.use_id(SofarSolar_Inverter),
+        cv.Optional(CONF_REGISTERS, default=["total_active_power_inverter", "active_power_export_limit"]): cv.All(cv.ensure_list(validate_register_name), cv.Length(min=1, max=32)),
+        # Timestamps are microseconds in 32 bits, they wrap after 71 minutes
+        cv.Optional(CONF_DURATION, default="10s"): cv.templatable(cv.All(cv.positive_time_period_milliseconds, cv.Range(max=cv.TimePeriod(minutes=60)))),
+    }),
+)
+async def start_capture_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    var = cg.new_Pvariable(action_id, template_arg, parent)
+    for name in config[CONF_REGISTERS]:
+        cg.add(var.add_register(register_key(name)))
+    duration = await cg.templatable(config[CONF_DURATION], args, cg.uint32)
+    cg.add(var.set_duration(duration))
+    return var
+
+
+@automation.register_action(
+    "sofarsolar_inverter.stop_capture",
+    SofarSolar_StopCaptureAction,
+    automation.maybe_simple_id({
+        cv.GenerateID(): cv.use_id(SofarSolar_Inverter),
+    }),
+)
+async def stop_capture_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, parent)
+
+
+@automation.register_action(
+    "sofarsolar_inverter.dump_capture",
+    SofarSolar_DumpCaptureAction,
+    automation.maybe_simple_id({
+        cv.GenerateID(): cv.use_id(SofarSolar_Inverter),
+    }),
+)
+async def dump_capture_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, parent)
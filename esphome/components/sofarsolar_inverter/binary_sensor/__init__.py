@@ -0,0 +1,87 @@
+import esphome.codegen as cg
+from esphome.components import binary_sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    DEVICE_CLASS_PROBLEM,
+    DEVICE_CLASS_HEAT,
+    DEVICE_CLASS_SAFETY,
+    DEVICE_CLASS_EMPTY,
+)
+
+from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA
+
+
+CONF_GRID_FAULT = "grid_fault"
+CONF_INSULATION_FAULT = "insulation_fault"
+CONF_OVER_TEMPERATURE = "over_temperature"
+CONF_BATTERY_FAULT = "battery_fault"
+CONF_FAULTS = "faults"
+CONF_FAULT_ID = "fault_id"
+
+CONF_POWER_CONTROL_EXPORT_LIMIT = "power_control_export_limit"
+CONF_POWER_CONTROL_IMPORT_LIMIT = "power_control_import_limit"
+CONF_POWER_CONTROL_REACTIVE_POWER = "power_control_reactive_power"
+CONF_POWER_CONTROL_POWER_FACTOR = "power_control_power_factor"
+CONF_POWER_CONTROL_ACTIVE_POWER = "power_control_active_power"
+
+UPDATE_INTERVAL = "update_interval"
+
+# The fault registers 0x0405 to 0x0416 hold one bit per fault ID, ID001 is bit 0 of the first word
+FAULT_WORDS = 18
+
+def fault_bits(*fault_ids):
+    word = (fault_ids[0] - 1) // 16
+    mask = 0
+    for fault_id in fault_ids:
+        assert (fault_id - 1) // 16 == word
+        mask |= 1 << ((fault_id - 1) % 16)
+    return word, mask
+
+FAULT_TYPES = {
+    CONF_GRID_FAULT: (fault_bits(1, 2, 3, 4), DEVICE_CLASS_PROBLEM), # ID001 to ID004: grid over/under voltage and frequency
+    CONF_INSULATION_FAULT: (fault_bits(39), DEVICE_CLASS_SAFETY), # ID039: insulation resistance too low
+    CONF_OVER_TEMPERATURE: (fault_bits(*range(49, 65)), DEVICE_CLASS_HEAT), # ID049 to ID064: temperature faults
+    CONF_BATTERY_FAULT: (fault_bits(*range(81, 97)), DEVICE_CLASS_PROBLEM), # ID081 to ID096: battery faults
+}
+
+POWER_CONTROL_TYPES = {
+    CONF_POWER_CONTROL_EXPORT_LIMIT: 0b00001,
+    CONF_POWER_CONTROL_IMPORT_LIMIT: 0b00010,
+    CONF_POWER_CONTROL_REACTIVE_POWER: 0b00100,
+    CONF_POWER_CONTROL_POWER_FACTOR: 0b01000,
+    CONF_POWER_CONTROL_ACTIVE_POWER: 0b10000,
+}
+
+CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend(
+    {
+        cv.Optional(UPDATE_INTERVAL, default="5s"): cv.positive_time_period_seconds,
+        cv.Optional(CONF_FAULTS): cv.ensure_list(
+            binary_sensor.binary_sensor_schema(device_class=DEVICE_CLASS_PROBLEM).extend(
+                {
+                    cv.Required(CONF_FAULT_ID): cv.int_range(1, FAULT_WORDS * 16),
+                }
+            )
+        ),
+    }
+).extend(
+    {cv.Optional(type): binary_sensor.binary_sensor_schema(device_class=device_class) for type, (_, device_class) in FAULT_TYPES.items()}
+).extend(
+    {cv.Optional(type): binary_sensor.binary_sensor_schema(device_class=DEVICE_CLASS_EMPTY) for type in POWER_CONTROL_TYPES}
+)
+
+async def to_code(config):
+    var = await cg.get_variable(config[CONF_SOFARSOLAR_INVERTER_ID])
+    cg.add(var.set_binary_sensor_update_interval(config[UPDATE_INTERVAL]))
+
+    for type, ((word, mask), _) in FAULT_TYPES.items():
+        if type in config:
+            sens = await binary_sensor.new_binary_sensor(config[type])
+            cg.add(var.add_fault_binary_sensor(sens, word, mask))
+    for conf in config.get(CONF_FAULTS, []):
+        sens = await binary_sensor.new_binary_sensor(conf)
+        word, mask = fault_bits(conf[CONF_FAULT_ID])
+        cg.add(var.add_fault_binary_sensor(sens, word, mask))
+    for type, mask in POWER_CONTROL_TYPES.items():
+        if type in config:
+            sens = await binary_sensor.new_binary_sensor(config[type])
+            cg.add(var.add_power_control_binary_sensor(sens, mask))
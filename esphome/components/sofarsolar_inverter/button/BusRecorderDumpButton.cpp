@@ -0,0 +1,9 @@
+#include "BusRecorderDumpButton.h"
+
+namespace esphome {
+    namespace sofarsolar_inverter {
+
+        void BusRecorderDumpButton::press_action() { this->parent_->dump_bus_recorder(); }
+
+    }  // namespace sofarsolar_inverter
+}  // namespace esphome
\ No newline at end of file
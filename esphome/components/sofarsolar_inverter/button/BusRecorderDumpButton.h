@@ -0,0 +1,18 @@
+#pragma once
+
+#include "esphome/components/button/button.h"
+#include "../sofarsolar_inverter.h"
+
+namespace esphome {
+    namespace sofarsolar_inverter {
+
+        class BusRecorderDumpButton : public button::Button, public Parented<SofarSolar_Inverter> {
+        public:
+            BusRecorderDumpButton() = default;
+
+        protected:
+            void press_action() override;
+        };
+
+    }  // namespace sofarsolar_inverter
+}  // namespace esphome
\ No newline at end of file
@@ -4,13 +4,14 @@ import esphome.config_validation as cv
 
 from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA, sofarsolar_inverter_ns
 
-DEPENDENCIES = ["modbus"]
 
 CONF_BATTERY_ACTIVATION_BUTTON = "battery_activation"
 CONF_BATTERY_CONFIG_WRITE_BUTTON = "battery_config_write"
+CONF_BUS_RECORDER_DUMP_BUTTON = "bus_recorder_dump"
 
 BatteryActivationButton = sofarsolar_inverter_ns.class_("BatteryActivationButton", button.Button)
 BatteryConfigWriteButton = sofarsolar_inverter_ns.class_("BatteryConfigWriteButton", button.Button)
+BusRecorderDumpButton = sofarsolar_inverter_ns.class_("BusRecorderDumpButton", button.Button)
 
 CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend(
     {
@@ -20,6 +21,9 @@ CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend(
         cv.Optional(CONF_BATTERY_CONFIG_WRITE_BUTTON): button.button_schema(
             BatteryConfigWriteButton,
         ),
+        cv.Optional(CONF_BUS_RECORDER_DUMP_BUTTON): button.button_schema(
+            BusRecorderDumpButton,
+        ),
     }
 )
 
@@ -32,4 +36,8 @@ async def to_code(config):
     if battery_write_conf := config.get(CONF_BATTERY_CONFIG_WRITE_BUTTON):
         b = await button.new_button(battery_write_conf)
         await cg.register_parented(b, config[CONF_SOFARSOLAR_INVERTER_ID])
-        cg.add(paren.set_battery_config_write_button(b))
\ No newline at end of file
+        cg.add(paren.set_battery_config_write_button(b))
+    if bus_recorder_dump_conf := config.get(CONF_BUS_RECORDER_DUMP_BUTTON):
+        b = await button.new_button(bus_recorder_dump_conf)
+        await cg.register_parented(b, config[CONF_SOFARSOLAR_INVERTER_ID])
+        cg.add(paren.set_bus_recorder_dump_button(b))
\ No newline at end of file
@@ -0,0 +1,70 @@
+import esphome.codegen as cg
+from esphome.components import number
+import esphome.config_validation as cv
+from esphome.const import (
+    DEVICE_CLASS_POWER,
+    DEVICE_CLASS_EMPTY,
+    UNIT_WATT,
+    UNIT_PERCENT,
+    UNIT_EMPTY,
+    ENTITY_CATEGORY_CONFIG,
+)
+
+from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA, sofarsolar_inverter_ns
+
+
+CONF_DESIRED_GRID_POWER = "desired_grid_power"
+CONF_MINIMUM_BATTERY_POWER = "minimum_battery_power"
+CONF_MAXIMUM_BATTERY_POWER = "maximum_battery_power"
+CONF_ACTIVE_POWER_EXPORT_LIMIT = "active_power_export_limit"
+CONF_ACTIVE_POWER_IMPORT_LIMIT = "active_power_import_limit"
+CONF_BATTERY_CONF_ID = "battery_conf_id"
+CONF_BATTERY_CONF_ADDRESS = "battery_conf_address"
+
+UPDATE_INTERVAL = "update_interval"
+WRITE_DEBOUNCE = "write_debounce"
+WRITE_MAX_DELAY = "write_max_delay"
+
+SofarSolar_Inverter_Number = sofarsolar_inverter_ns.class_("SofarSolar_Inverter_Number", number.Number)
+
+# Minimum, maximum and step of the value as shown in Home Assistant, the register scale is applied by the component
+TYPES = {
+    CONF_DESIRED_GRID_POWER: (-20000, 20000, 1, UNIT_WATT, DEVICE_CLASS_POWER),
+    CONF_MINIMUM_BATTERY_POWER: (-20000, 20000, 1, UNIT_WATT, DEVICE_CLASS_POWER),
+    CONF_MAXIMUM_BATTERY_POWER: (-20000, 20000, 1, UNIT_WATT, DEVICE_CLASS_POWER),
+    CONF_ACTIVE_POWER_EXPORT_LIMIT: (0, 100, 0.1, UNIT_PERCENT, DEVICE_CLASS_EMPTY),
+    CONF_ACTIVE_POWER_IMPORT_LIMIT: (0, 100, 0.1, UNIT_PERCENT, DEVICE_CLASS_EMPTY),
+    CONF_BATTERY_CONF_ID: (0, 65535, 1, UNIT_EMPTY, DEVICE_CLASS_EMPTY),
+    CONF_BATTERY_CONF_ADDRESS: (0, 255, 1, UNIT_EMPTY, DEVICE_CLASS_EMPTY),
+}
+
+CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend(
+    {
+        cv.Optional(WRITE_DEBOUNCE, default="1s"): cv.positive_time_period_milliseconds,
+        cv.Optional(WRITE_MAX_DELAY, default="10s"): cv.positive_time_period_milliseconds,
+        **{
+            cv.Optional(type): number.number_schema(
+                SofarSolar_Inverter_Number,
+                unit_of_measurement=unit,
+                device_class=device_class,
+                entity_category=ENTITY_CATEGORY_CONFIG,
+            ).extend(
+                {
+                    cv.Optional(UPDATE_INTERVAL, default="60s"): cv.positive_time_period_seconds,
+                }
+            )
+            for type, (_, _, _, unit, device_class) in TYPES.items()
+        },
+    }
+)
+
+async def to_code(config):
+    var = await cg.get_variable(config[CONF_SOFARSOLAR_INVERTER_ID])
+    cg.add(var.set_write_debounce(config[WRITE_DEBOUNCE], config[WRITE_MAX_DELAY]))
+    for type, (min_value, max_value, step, _, _) in TYPES.items():
+        if type in config:
+            conf = config[type]
+            num = await number.new_number(conf, min_value=min_value, max_value=max_value, step=step)
+            await cg.register_parented(num, config[CONF_SOFARSOLAR_INVERTER_ID])
+            cg.add(getattr(var, f"set_{type}_number")(num))
+            cg.add(getattr(var, f"set_{type}_number_update_interval")(conf[UPDATE_INTERVAL]))
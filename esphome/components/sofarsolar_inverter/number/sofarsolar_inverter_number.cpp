@@ -0,0 +1,15 @@
+#include "sofarsolar_inverter_number.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+    namespace sofarsolar_inverter {
+
+        static const char *const TAG = "sofarsolar_inverter.number";
+
+        void SofarSolar_Inverter_Number::control(float value) {
+            ESP_LOGD(TAG, "Setting %s to %f", this->get_name().c_str(), value);
+            this->parent_->set_number_value(this, value);
+            this->publish_state(value);
+        }
+    }
+}
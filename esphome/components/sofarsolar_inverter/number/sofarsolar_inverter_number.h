@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../sofarsolar_inverter.h"
+#include "esphome/components/number/number.h"
+#include "esphome/core/component.h"
+
+namespace esphome {
+    namespace sofarsolar_inverter {
+        class SofarSolar_Inverter;
+        class SofarSolar_Inverter_Number : public number::Number, public Parented<SofarSolar_Inverter> {
+            protected:
+                void control(float value) override;
+        };
+    }
+}
@@ -1,8 +1,11 @@
+import logging
+
 import esphome.codegen as cg
 from esphome.components import sensor
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 
-from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA
+from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA, CONF_TCP, CONF_MAX_OUTSTANDING, CONF_BAUD_RATE_DETECTION, CONF_TARGET_BAUD_RATE, CONF_TARGET_UTILISATION
 
 from esphome.const import (
     DEVICE_CLASS_POWER,
@@ -27,10 +30,12 @@ from esphome.const import (
     UNIT_SECOND,
     UNIT_CELSIUS,
 
-    UNIT_EMPTY
+    UNIT_EMPTY,
+    ENTITY_CATEGORY_DIAGNOSTIC,
 )
 
-DEPENDENCIES = ["modbus"]
+
+_LOGGER = logging.getLogger(__name__)
 
 CONF_PV_GENERATION_TODAY = "pv_generation_today"
 CONF_PV_GENERATION_TOTAL = "pv_generation_total"
@@ -169,6 +174,88 @@ CONF_REACTIVE_POWER_RESPONSE_TIME = "reactive_power_response_time"
 UPDATE_INTERVAL = "update_interval"
 DEFAULT_VALUE = "default_value"
 ENFORCE_DEFAULT_VALUE = "enforce_default_value"
+AGGREGATION = "aggregation"
+AGGREGATION_WINDOW = "window"
+AGGREGATION_MODE = "mode"
+AGGREGATION_MIN = "min"
+AGGREGATION_MAX = "max"
+
+# Loop phases with their index in the component, each has a max and an avg run time sensor
+PHASES = {
+    "scan": 0,
+    "control": 1,
+    "dispatch": 2,
+    "parse": 3,
+    "publish": 4,
+}
+
+PHASE_TIME_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement="µs",
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+CONF_STALE_REGISTERS = "stale_registers"
+CONF_MAX_AGE_RATIO = "max_age_ratio"
+CONF_LINK_BAUD_RATE = "link_baud_rate"
+CONF_LINK_THROUGHPUT = "link_throughput"
+CONF_BUS_UTILISATION = "bus_utilisation"
+CONF_INTERVAL_SCALE = "interval_scale"
+
+LINK_BAUD_RATE_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement="Bd",
+    accuracy_decimals=0,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+LINK_THROUGHPUT_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement="registers/s",
+    accuracy_decimals=1,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+BUS_UTILISATION_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_PERCENT,
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+INTERVAL_SCALE_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=2,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+STALE_REGISTERS_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+MAX_AGE_RATIO_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=1,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+AGGREGATION_MODES = {
+    "mean": 0,
+    "min": 1,
+    "max": 2,
+    "last": 3,
+}
+
+AGGREGATION_SCHEMA = cv.Schema(
+    {
+        cv.Required(AGGREGATION_WINDOW): cv.positive_time_period_milliseconds,
+        cv.Optional(AGGREGATION_MODE, default="mean"): cv.one_of(*AGGREGATION_MODES, lower=True),
+        cv.Optional(AGGREGATION_MIN): sensor.sensor_schema(),
+        cv.Optional(AGGREGATION_MAX): sensor.sensor_schema(),
+    }
+)
 
 TYPES = {
     CONF_PV_GENERATION_TODAY: sensor.sensor_schema(
@@ -1462,9 +1549,60 @@ TYPES = {
 }
 
 CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend({
-    **{cv.Optional(type): schema for type, schema in TYPES.items()},
+    **{cv.Optional(type): schema.extend({cv.Optional(AGGREGATION): AGGREGATION_SCHEMA}) for type, schema in TYPES.items()},
+    **{cv.Optional(f"{phase}_time_{stat}"): PHASE_TIME_SCHEMA for phase in PHASES for stat in ("max", "avg")},
+    cv.Optional(CONF_STALE_REGISTERS): STALE_REGISTERS_SCHEMA,
+    cv.Optional(CONF_MAX_AGE_RATIO): MAX_AGE_RATIO_SCHEMA,
+    cv.Optional(CONF_LINK_BAUD_RATE): LINK_BAUD_RATE_SCHEMA,
+    cv.Optional(CONF_LINK_THROUGHPUT): LINK_THROUGHPUT_SCHEMA,
+    cv.Optional(CONF_BUS_UTILISATION): BUS_UTILISATION_SCHEMA,
+    cv.Optional(CONF_INTERVAL_SCALE): INTERVAL_SCALE_SCHEMA,
 })
 
+# Same cost model as SofarSolar_Inverter::estimate_transaction_time, before any round trip has been measured.
+# The register widths are not known here, every read is counted as two registers.
+RTU_REQUEST_GAP = 0.15
+TCP_ROUND_TRIP = 0.05
+
+
+def _config_for_id(full_config, id):
+    try:
+        return full_config.get_config_for_path(full_config.get_path_for_id(id)[:-1])
+    except (KeyError, ValueError):
+        return None
+
+
+def _bus_baud_rate(full_config, hub_config):
+    detection_config = hub_config.get(CONF_BAUD_RATE_DETECTION)
+    if detection_config and CONF_TARGET_BAUD_RATE in detection_config:
+        return detection_config[CONF_TARGET_BAUD_RATE]
+    modbus_config = _config_for_id(full_config, hub_config.get("modbus_id"))
+    uart_config = _config_for_id(full_config, modbus_config.get("uart_id")) if modbus_config else None
+    return uart_config.get("baud_rate", 9600) if uart_config else 9600
+
+
+def _validate_bus_capacity(config):
+    full_config = fv.full_config.get()
+    hub_config = _config_for_id(full_config, config[CONF_SOFARSOLAR_INVERTER_ID])
+    if hub_config is None:
+        return config
+    if tcp_config := hub_config.get(CONF_TCP):
+        transaction_time = TCP_ROUND_TRIP / tcp_config[CONF_MAX_OUTSTANDING]
+    else:
+        transaction_time = RTU_REQUEST_GAP + (13 + 2 * 2) * 10 / _bus_baud_rate(full_config, hub_config)
+    load = sum(transaction_time / conf[UPDATE_INTERVAL].total_seconds for type, conf in config.items() if type in TYPES and conf[UPDATE_INTERVAL].total_seconds > 0)
+    target = hub_config.get(CONF_TARGET_UTILISATION, 0.8)
+    if load > max(target, 0.01):
+        _LOGGER.warning(
+            "The sensor update intervals of %s need about %.0f%% of the bus time, more than the target utilisation of %.0f%%. "
+            "Low priority registers will be polled less often than configured, consider longer update intervals.",
+            config[CONF_SOFARSOLAR_INVERTER_ID], load * 100, target * 100,
+        )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _validate_bus_capacity
+
 
 async def to_code(config):
     var = await cg.get_variable(config[CONF_SOFARSOLAR_INVERTER_ID])
@@ -1477,4 +1615,33 @@ async def to_code(config):
             if DEFAULT_VALUE in conf:
                 cg.add(getattr(var, f"set_{type}_sensor_default_value")(conf[DEFAULT_VALUE]))
             if ENFORCE_DEFAULT_VALUE in conf:
-                cg.add(getattr(var, f"set_{type}_sensor_enforce_default_value")(conf[ENFORCE_DEFAULT_VALUE]))
\ No newline at end of file
+                cg.add(getattr(var, f"set_{type}_sensor_enforce_default_value")(conf[ENFORCE_DEFAULT_VALUE]))
+            if aggregation_conf := conf.get(AGGREGATION):
+                min_sens = cg.nullptr
+                max_sens = cg.nullptr
+                if AGGREGATION_MIN in aggregation_conf:
+                    min_sens = await sensor.new_sensor(aggregation_conf[AGGREGATION_MIN])
+                if AGGREGATION_MAX in aggregation_conf:
+                    max_sens = await sensor.new_sensor(aggregation_conf[AGGREGATION_MAX])
+                cg.add(var.add_sensor_aggregation(sens, aggregation_conf[AGGREGATION_WINDOW], AGGREGATION_MODES[aggregation_conf[AGGREGATION_MODE]], min_sens, max_sens))
+    for phase, index in PHASES.items():
+        max_sens = cg.nullptr
+        avg_sens = cg.nullptr
+        if f"{phase}_time_max" in config:
+            max_sens = await sensor.new_sensor(config[f"{phase}_time_max"])
+        if f"{phase}_time_avg" in config:
+            avg_sens = await sensor.new_sensor(config[f"{phase}_time_avg"])
+        if max_sens is not cg.nullptr or avg_sens is not cg.nullptr:
+            cg.add(var.set_phase_time_sensor(index, max_sens, avg_sens))
+    if CONF_LINK_BAUD_RATE in config:
+        cg.add(var.set_link_baud_rate_sensor(await sensor.new_sensor(config[CONF_LINK_BAUD_RATE])))
+    if CONF_LINK_THROUGHPUT in config:
+        cg.add(var.set_link_throughput_sensor(await sensor.new_sensor(config[CONF_LINK_THROUGHPUT])))
+    if CONF_BUS_UTILISATION in config:
+        cg.add(var.set_bus_utilisation_sensor(await sensor.new_sensor(config[CONF_BUS_UTILISATION])))
+    if CONF_INTERVAL_SCALE in config:
+        cg.add(var.set_interval_scale_sensor(await sensor.new_sensor(config[CONF_INTERVAL_SCALE])))
+    if CONF_STALE_REGISTERS in config:
+        cg.add(var.set_stale_registers_sensor(await sensor.new_sensor(config[CONF_STALE_REGISTERS])))
+    if CONF_MAX_AGE_RATIO in config:
+        cg.add(var.set_max_age_ratio_sensor(await sensor.new_sensor(config[CONF_MAX_AGE_RATIO])))
@@ -0,0 +1,84 @@
+#pragma once
+#include "vector"
+#include "algorithm"
+#include "cstdint"
+
+// Baud rate detection and switching at startup, shared by the inverter and the host tests.
+
+#define BAUD_DONE 0
+#define BAUD_DETECT 1
+#define BAUD_SWITCH 2
+#define BAUD_VERIFY 3
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Decides which baud rate is probed next and whether the inverter is switched to the target rate. The owner
+		// applies the rates to its UART, sends the probe reads and the speed setting and reports their results.
+		class SofarSolar_BaudNegotiation {
+		public:
+			void add_baud_rate(uint32_t baud_rate) { this->baud_rates_.push_back(baud_rate); }
+			void set_target_baud_rate(uint32_t target_baud_rate) { this->target_baud_rate_ = target_baud_rate; }
+
+			bool is_enabled() const { return !this->baud_rates_.empty(); }
+			uint8_t get_state() const { return this->state_; }
+			uint32_t get_original_baud_rate() const { return this->original_baud_rate_; }
+			uint32_t get_target_baud_rate() const { return this->target_baud_rate_; }
+
+			// Starts the detection, returns the rate to probe first
+			uint32_t start(uint32_t original_baud_rate) {
+				this->original_baud_rate_ = original_baud_rate;
+				// Probe the configured rate first, a correctly configured bus is confirmed with a single read
+				this->baud_rates_.erase(std::remove(this->baud_rates_.begin(), this->baud_rates_.end(), original_baud_rate), this->baud_rates_.end());
+				this->baud_rates_.insert(this->baud_rates_.begin(), original_baud_rate);
+				this->index_ = 0;
+				this->state_ = BAUD_DETECT;
+				return original_baud_rate;
+			}
+
+			// The inverter answered the probe at the rate. Returns BAUD_SWITCH if the speed setting has to be written
+			// next, BAUD_DONE if the rate is settled.
+			uint8_t on_probe_answered(uint32_t baud_rate) {
+				if (this->state_ == BAUD_DETECT && this->target_baud_rate_ > 0 && baud_rate != this->target_baud_rate_ && !this->switch_attempted_) {
+					this->switch_attempted_ = true; // The speed setting is written at most once per boot
+					this->state_ = BAUD_SWITCH;
+				} else {
+					this->state_ = BAUD_DONE;
+				}
+				return this->state_;
+			}
+
+			// The speed setting was written or failed, returns the target rate to verify with a probe. The answer to the
+			// write may already be lost to the switch, the probe at the new rate decides.
+			uint32_t on_switch_sent() {
+				this->state_ = BAUD_VERIFY;
+				return this->target_baud_rate_;
+			}
+
+			// The probe was not answered. Returns the rate to probe next, or the original rate with the state BAUD_DONE
+			// if no rate answered.
+			uint32_t on_probe_failed() {
+				if (this->state_ == BAUD_VERIFY) {
+					// The inverter may have rejected the setting or only applies it after a restart, find it again
+					this->state_ = BAUD_DETECT;
+					this->index_ = 0;
+					return this->baud_rates_[0];
+				}
+				if (++this->index_ < this->baud_rates_.size()) {
+					return this->baud_rates_[this->index_];
+				}
+				this->state_ = BAUD_DONE;
+				return this->original_baud_rate_;
+			}
+
+		protected:
+			std::vector<uint32_t> baud_rates_; // Baud rates probed, the original rate first once started
+			uint32_t target_baud_rate_ = 0; // Baud rate the inverter is switched to, 0 to keep the detected rate
+			uint32_t original_baud_rate_ = 0; // Baud rate of the UART configuration, used as fallback
+			size_t index_ = 0; // Index of the baud rate currently probed
+			uint8_t state_ = BAUD_DONE;
+			bool switch_attempted_ = false;
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
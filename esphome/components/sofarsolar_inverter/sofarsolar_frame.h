@@ -0,0 +1,72 @@
+#pragma once
+#include "cstdint"
+#include "cstddef"
+
+namespace esphome {
+    namespace sofarsolar_inverter {
+
+        // Read only view over a received Modbus payload. The view does not copy the buffer and every
+        // access is checked against its size, reads outside the payload fail instead of reading past it.
+        class FrameView {
+        public:
+            FrameView() : data_(nullptr), size_(0) {}
+            FrameView(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+            size_t size() const { return this->size_; }
+            const uint8_t *data() const { return this->data_; }
+
+            bool contains(size_t offset, size_t length) const { return offset <= this->size_ && length <= this->size_ - offset; }
+
+            bool read_uint16(size_t offset, uint16_t &value) const {
+                if (!this->contains(offset, 2)) {
+                    return false;
+                }
+                value = (static_cast<uint16_t>(this->data_[offset]) << 8) | this->data_[offset + 1];
+                return true;
+            }
+
+            bool read_uint32(size_t offset, uint32_t &value) const {
+                if (!this->contains(offset, 4)) {
+                    return false;
+                }
+                value = (static_cast<uint32_t>(this->data_[offset]) << 24) | (static_cast<uint32_t>(this->data_[offset + 1]) << 16) | (static_cast<uint32_t>(this->data_[offset + 2]) << 8) | this->data_[offset + 3];
+                return true;
+            }
+
+        protected:
+            const uint8_t *data_;
+            size_t size_;
+        };
+
+        // Precomputed description of one numeric value in a response, built once per block layout
+        struct DecodeDescriptor {
+            uint16_t offset; // Byte offset of the value in the response
+            uint8_t width; // Width of the value in registers, 1 or 2
+            bool is_signed; // Flag to indicate a two's complement value
+            float multiplier; // Scale factor applied to the raw value
+            uint8_t slot; // Index of the decoded value in the output array
+        };
+
+        // Converts all described values of a response in one pass. Returns the number of values decoded,
+        // decoding stops at the first value that is not fully contained in the frame.
+        inline size_t decode_block(const FrameView &frame, const DecodeDescriptor *descriptors, size_t count, float *values) {
+            const uint8_t *data = frame.data();
+            for (size_t i = 0; i < count; i++) {
+                const DecodeDescriptor &descriptor = descriptors[i];
+                if (!frame.contains(descriptor.offset, descriptor.width * 2)) {
+                    return i;
+                }
+                const uint8_t *raw = data + descriptor.offset;
+                if (descriptor.width == 2) {
+                    uint32_t value = (static_cast<uint32_t>(raw[0]) << 24) | (static_cast<uint32_t>(raw[1]) << 16) | (static_cast<uint32_t>(raw[2]) << 8) | raw[3];
+                    values[descriptor.slot] = (descriptor.is_signed ? static_cast<float>(static_cast<int32_t>(value)) : static_cast<float>(value)) * descriptor.multiplier;
+                } else {
+                    uint16_t value = (static_cast<uint16_t>(raw[0]) << 8) | raw[1];
+                    values[descriptor.slot] = (descriptor.is_signed ? static_cast<float>(static_cast<int16_t>(value)) : static_cast<float>(value)) * descriptor.multiplier;
+                }
+            }
+            return count;
+        }
+
+    }  // namespace sofarsolar_inverter
+}  // namespace esphome
\ No newline at end of file
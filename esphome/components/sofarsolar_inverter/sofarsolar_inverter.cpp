@@ -1,7 +1,12 @@
 #include "queue"
+#include "algorithm"
+#include "cstring"
 #include "sofarsolar_inverter.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#ifdef USE_MQTT
+#include "esphome/components/mqtt/mqtt_client.h"
+#endif
 
 namespace esphome
 {
@@ -9,177 +14,890 @@ namespace esphome
 		static const char *TAG = "sofarsolar_inverter.component";
 
 		struct SofarSolar_RegisterDynamic {
-			uint32_t last_update; // Last update time in milliseconds
+			uint32_t last_update; // Time in milliseconds the last read was scheduled
+			uint32_t last_success = 0; // Time in milliseconds of the last successful read
+			bool stale = false; // Flag to indicate that the value has been published as unavailable
 			uint32_t update_interval; // Update interval in milliseconds
+			uint32_t effective_interval = 0; // Update interval in milliseconds after admission control
+			uint32_t achieved_interval = 0; // Smoothed time in milliseconds between two successful reads
+			uint32_t base_interval = 0; // Configured update interval in milliseconds, used when no polling profile sets one
+			float last_value = NAN; // Last value read, also while the sensor only publishes aggregates
+			uint32_t publish_interval = 0; // Minimum time in milliseconds between two published values, 0 to publish every read
+			uint32_t last_publish = 0; // Time in milliseconds the last value was queued for publishing
 			sensor::Sensor *sensor; // Pointer to the sensor associated with the register
+			text_sensor::TextSensor *text_sensor = nullptr; // Pointer to the text sensor associated with ASCII and ENUM registers
+			number::Number *number = nullptr; // Pointer to the number setting the register
+			bool read_once = false; // Flag to indicate that the register is static and only read until it succeeded once
+			bool read_complete = false; // Flag to indicate that a static register has been read
 			SofarSolar_RegisterValue default_value; // Value of the register
-			SofarSolar_RegisterValue write_value; // Value to write to the register
 			bool default_value_set; // Flag to indicate if the default value is set
 			bool enforce_default_value; // Flag to indicate if the default value should be enforced
-			bool write_set_value = false; // Flag to indicate if the write value is set
 			bool is_queued = false; // Flag to indicate if the register is queued for reading/writing
+			SofarSolar_Aggregate *aggregate = nullptr; // Window aggregation of the samples, only allocated when configured
 			SofarSolar_RegisterDynamic() : sensor(nullptr), update_interval(0), last_update(0), default_value({}), default_value_set(false), enforce_default_value(false) {}
 		};
 
-		struct register_read_task {
-			uint8_t register_key; // Pointer to the register to read
-			bool operator<(const register_read_task &other) const {
-				return G3_registers.at(this->register_key).priority > G3_registers.at(other.register_key).priority;
-			}
-		};
-
-		struct register_write_task {
-			uint8_t first_register_key; // Pointer to the register to write
-			uint8_t number_of_registers; // Number of registers to write
-			std::vector<uint8_t> data; // Data to write to the register
-			bool operator<(const register_write_task &other) const {
-				return G3_registers.at(this->first_register_key).priority > G3_registers.at(other.first_register_key).priority;
-			}
-		};
-
 		SofarSolar_Inverter::SofarSolar_Inverter() {
 		}
 
-		int time_last_loop = 0;
-		bool current_reading = false; // Pointer to the current reading task
-		bool current_writing = false; // Pointer to the current writing task
-		register_write_task current_write_task; // Pointer to the current writing task
-		uint32_t time_begin_modbus_operation = 0;
-		uint32_t zero_export_last_update = 0;
-		std::priority_queue<register_read_task> register_read_queue; // Priority queue for register read tasks
-		std::priority_queue<register_write_task> register_write_queue; // Priority queue for register write tasks
+		float SofarSolar_Snapshot::value(uint8_t register_key) const {
+			auto it = this->values.find(register_key);
+			return it != this->values.end() ? it->second : NAN;
+		}
+
+		uint32_t SofarSolar_Snapshot::age(uint8_t register_key) const {
+			auto it = this->timestamps.find(register_key);
+			return it != this->timestamps.end() ? millis() - it->second : UINT32_MAX;
+		}
 
 		void SofarSolar_Inverter::setup() {
 			ESP_LOGCONFIG(TAG, "Setting up Sofar Solar Inverter");
-			G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_value.uint16_value = 1;
-			G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_set_value = true;
-			G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_value.uint16_value = 1;
-			G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_set_value = true;
+			if (this->power_sensor_ != nullptr) {
+				this->power_sensor_->add_on_state_callback([this](float state) {
+					this->power_meter_last_update_ = millis();
+					if (this->capture_.active) {
+						this->add_capture_sample(CAPTURE_CHANNEL_POWER_METER, state, micros());
+					}
+				});
+			}
+			// The poller talks to the inverter either through the modbus component or through a TCP gateway
+			this->poller_.set_clock(&millis);
+			this->poller_.set_sink(this);
+			this->poller_.set_modbus_address(this->modbus_address_);
+			if (this->tcp_transport_ != nullptr) {
+				this->tcp_transport_->set_unit_id(this->modbus_address_);
+			}
+#ifdef USE_ESP32
+			if (this->tcp_transport_ != nullptr && this->io_task_ != nullptr) {
+				// The I/O task runs its own poller on the TCP transport, the main loop only exchanges tasks and results with it
+				this->io_task_->set_record_frames(!this->bus_recorder_.empty());
+				if (!this->io_task_->start(this->tcp_transport_, this->modbus_address_, &millis, this->io_task_core_, this->io_task_priority_)) {
+					ESP_LOGE(TAG, "Could not start the Modbus I/O task, polling on the main loop");
+					delete this->io_task_;
+					this->io_task_ = nullptr;
+					this->poller_.set_transport(this->tcp_transport_);
+				}
+			} else
+#endif
+			if (this->tcp_transport_ != nullptr) {
+				this->poller_.set_transport(this->tcp_transport_);
+			}
+#ifdef USE_SOFARSOLAR_MODBUS
+			else {
+				this->poller_.set_transport(&this->modbus_transport_);
+			}
+#endif
+			if ((this->zero_export_ || this->site_controlled_) && this->power_snapshot_interval_ == 0) {
+				this->power_snapshot_interval_ = ZERO_EXPORT_INTERVAL; // The zero export control always works on snapshots
+			}
+			if (this->power_snapshot_interval_ > 0) {
+				// Merge the snapshot registers into as few block reads as possible
+				std::vector<uint8_t> keys = power_flow_snapshot_registers;
+				std::sort(keys.begin(), keys.end(), [](uint8_t a, uint8_t b) { return G3_registers.at(a).start_address < G3_registers.at(b).start_address; });
+				for (uint8_t key : keys) {
+					const SofarSolar_Register &reg = G3_registers.at(key);
+					if (!this->power_snapshot_blocks_.empty()) {
+						SofarSolar_ReadBlock &block = this->power_snapshot_blocks_.back();
+						if (reg.start_address + reg.register_count - block.start_address <= MODBUS_MAX_READ_REGISTERS) {
+							block.register_count = std::max<uint16_t>(block.register_count, reg.start_address + reg.register_count - block.start_address);
+							continue;
+						}
+					}
+					this->power_snapshot_blocks_.push_back(SofarSolar_ReadBlock{key, reg.start_address, reg.register_count});
+				}
+				ESP_LOGCONFIG(TAG, "Power flow snapshot uses %d block reads for %d registers", this->power_snapshot_blocks_.size(), keys.size());
+			}
+			if (this->telemetry_ != nullptr) {
+				this->setup_telemetry();
+			}
+			this->capture_.samples.reserve(this->capture_buffer_size_); // Captures never allocate while they run
+			if (this->uart_ != nullptr && this->baud_negotiation_.is_enabled()) {
+				this->start_baud_negotiation(); // Polling starts once the inverter answered
+			} else {
+				this->start_polling();
+			}
+		}
+
+		void SofarSolar_Inverter::start_polling() {
+			this->link_statistics_since_ = millis();
+			this->freshness_last_check_ = millis();
+			for (auto &dynamic_register : G3_dynamic) {
+				dynamic_register.second.last_success = millis(); // The age of values never read counts from the start of polling
+				dynamic_register.second.base_interval = dynamic_register.second.update_interval;
+			}
+			for (const SofarSolar_PollingProfile &profile : this->polling_profiles_) {
+				if (G3_dynamic.find(profile.condition_register) == G3_dynamic.end()) {
+					ESP_LOGE(TAG, "Register %d of polling profile %s is not polled, the profile is never activated", profile.condition_register, profile.name.c_str());
+				}
+			}
+			this->check_admission();
+			if (this->polling_profile_text_sensor_ != nullptr) {
+				this->polling_profile_text_sensor_->publish_state("default");
+			}
+			for (auto &dynamic_register : G3_dynamic) {
+				if (dynamic_register.second.read_once) {
+					// Static registers are read right away, the update interval is only used to retry failed reads
+					dynamic_register.second.last_update = millis();
+					dynamic_register.second.is_queued = true;
+					this->queue_read(register_read_task(dynamic_register.first));
+				}
+			}
+			this->pending_write(BATTERY_ACTIVE_CONTROL).uint16_value = 1;
+			this->pending_write(BATTERY_ACTIVE_ONESHOT).uint16_value = 1;
 			this->write_battery_active(); // Write the battery active control register
 		}
 
+		float SofarSolar_Inverter::get_inverter_power() const {
+			if (this->power_snapshot_.valid) {
+				ESP_LOGV(TAG, "Using power flow snapshot: inverter power age %d ms, power meter age %d ms", this->power_snapshot_.age(TOTAL_ACTIVE_POWER_INVERTER), this->get_power_meter_age());
+				return this->power_snapshot_.value(TOTAL_ACTIVE_POWER_INVERTER);
+			}
+			auto it = G3_dynamic.find(TOTAL_ACTIVE_POWER_INVERTER);
+			return it != G3_dynamic.end() && it->second.sensor != nullptr ? it->second.sensor->state : NAN;
+		}
+
+		void SofarSolar_Inverter::update_zero_export() {
+			this->zero_export_last_update_ = millis();
+			ESP_LOGV(TAG, "Updating zero export status");
+			uint32_t meter_age = this->get_power_meter_age();
+			if (meter_age > this->power_meter_max_age_) {
+				// The load may have dropped since, a limit based on the old reading could export
+				ESP_LOGW(TAG, "Power meter reading is too old (%u ms), limiting the export to 0", meter_age);
+				this->apply_export_limit(0);
+				return;
+			}
+			float inverter_power = this->get_inverter_power();
+			float grid_power = this->get_power_meter_value();
+			if (std::isnan(inverter_power) || std::isnan(grid_power)) {
+				ESP_LOGW(TAG, "Inverter power or power meter not available, export limit unchanged");
+				return;
+			}
+			ESP_LOGV(TAG, "Current total active power inverter: %f W + %f W / %d W", inverter_power, grid_power, this->get_max_output_power());
+			ESP_LOGVV(TAG, "Model id %d, %d W", this->model_id_, this->get_max_output_power());
+			this->apply_export_limit(zero_export_limit(zero_export_target(inverter_power, grid_power), this->get_max_output_power()));
+		}
+
+		void SofarSolar_Inverter::apply_export_limit(int percentage) {
+			// Read the current zero export status
+			this->pending_write(POWER_CONTROL).uint16_value = 0b00001;
+			if (percentage < 0) {
+				percentage = 0;
+			} else if (percentage > 1000) {
+				percentage = 1000;
+			}
+			this->pending_write(ACTIVE_POWER_EXPORT_LIMIT).uint16_value = percentage;
+			ESP_LOGV(TAG, "Setting active power export limit to %d (percentage: %f%%)", this->pending_write(ACTIVE_POWER_EXPORT_LIMIT).uint16_value, (float) percentage / 10);
+
+			this->pending_write(ACTIVE_POWER_IMPORT_LIMIT).uint16_value = 0;
+
+			this->pending_write(REACTIVE_POWER_SETTING).int16_value = 0;
+
+			this->pending_write(POWER_FACTOR_SETTING).int16_value = 0;
+
+			this->pending_write(ACTIVE_POWER_LIMIT_SPEED).uint16_value = ZERO_EXPORT_LIMIT_SPEED;
+
+			this->pending_write(REACTIVE_POWER_RESPONSE_TIME).uint16_value = 0;
+
+			this->write_power(); // Write the power control registers=
+
+			int32_t desired_grid_power = this->get_max_output_power();
+			int32_t minimum_battery_power = this->battery_charge_only_switch_state_ ? 0 : -5000;
+			int32_t maximum_battery_power = this->battery_discharge_only_switch_state_ ? 0 : 5000;
+			bool known = this->has_register_value(DESIRED_GRID_POWER) && this->has_register_value(MINIMUM_BATTERY_POWER) && this->has_register_value(MAXIMUM_BATTERY_POWER);
+			if (known && this->register_value(DESIRED_GRID_POWER) == desired_grid_power && this->register_value(MINIMUM_BATTERY_POWER) == minimum_battery_power && this->register_value(MAXIMUM_BATTERY_POWER) == maximum_battery_power) {
+				return; // The inverter holds the values already
+			}
+			this->pending_write(DESIRED_GRID_POWER).int32_value = desired_grid_power;
+			this->pending_write(MINIMUM_BATTERY_POWER).int32_value = minimum_battery_power;
+			this->pending_write(MAXIMUM_BATTERY_POWER).int32_value = maximum_battery_power;
+			ESP_LOGV(TAG, "New desired grid power: %d W", desired_grid_power);
+			// Without values read before, the group is fetched first and the write skipped if the inverter holds the values
+			this->queue_group_write(DESIRED_GRID_POWER, nullptr, !known);
+		}
+
 		void SofarSolar_Inverter::loop() {
-			if (millis() - zero_export_last_update > 1000 && this->zero_export_) {
-				zero_export_last_update = millis();
-				ESP_LOGV(TAG, "Updating zero export status");
-				// Read the current zero export status
-				G3_dynamic.at(POWER_CONTROL).write_value.uint16_value = 0b00001;
-				G3_dynamic.at(POWER_CONTROL).write_set_value = true;
-
-				ESP_LOGV(TAG, "Current total active power inverter: %f W + %f W / %d W", G3_dynamic.at(TOTAL_ACTIVE_POWER_INVERTER).sensor->state, this->power_sensor_->state, model_parameters.at(this->model_id_).max_output_power_w);
-				ESP_LOGVV(TAG, "Model id %d, %d W", this->model_id_, model_parameters.at(this->model_id_).max_output_power_w);
-				int percentage = (G3_dynamic.at(TOTAL_ACTIVE_POWER_INVERTER).sensor->state + this->power_sensor_->state + 10) * 1000 / model_parameters.at(this->model_id_).max_output_power_w;
-				if (percentage < 0) {
-					percentage = 0;
-				} else if (percentage > 1000) {
-					percentage = 1000;
-				}
-				G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).write_value.uint16_value = percentage;
-				G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).write_set_value = true;
-				ESP_LOGV(TAG, "Setting active power export limit to %d (percentage: %f%%)", G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).write_value.uint16_value, (float) percentage / 10);
-
-				G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).write_value.uint16_value = 0;
-				G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).write_set_value = true;
-
-				G3_dynamic.at(REACTIVE_POWER_SETTING).write_value.int16_value = 0;
-				G3_dynamic.at(REACTIVE_POWER_SETTING).write_set_value = true;
-
-				G3_dynamic.at(POWER_FACTOR_SETTING).write_value.int16_value = 0;
-				G3_dynamic.at(POWER_FACTOR_SETTING).write_set_value = true;
-
-				G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).write_value.uint16_value = 1;
-				G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).write_set_value = true;
-
-				G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).write_value.uint16_value = 0;
-				G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).write_set_value = true;
-
-				this->write_power(); // Write the power control registers=
-
-				if (!(((battery_charge_only_switch_state_ == true && G3_dynamic.at(MINIMUM_BATTERY_POWER).sensor->state == 0) || (battery_charge_only_switch_state_ == false && G3_dynamic.at(MINIMUM_BATTERY_POWER).sensor->state == -5000)) && ((battery_discharge_only_switch_state_ == true && G3_dynamic.at(MAXIMUM_BATTERY_POWER).sensor->state == 0) || (battery_discharge_only_switch_state_ == false && G3_dynamic.at(MAXIMUM_BATTERY_POWER).sensor->state == 5000)) && (-model_parameters.at(this->model_id_).max_output_power_w == G3_dynamic.at(DESIRED_GRID_POWER).sensor->state))) {
-					G3_dynamic.at(DESIRED_GRID_POWER).write_value.int32_value = model_parameters.at(this->model_id_).max_output_power_w;
-					G3_dynamic.at(DESIRED_GRID_POWER).write_set_value = true;
-					if (battery_charge_only_switch_state_) {
-						G3_dynamic.at(MINIMUM_BATTERY_POWER).write_value.int32_value = 0;
-					} else {
-						G3_dynamic.at(MINIMUM_BATTERY_POWER).write_value.int32_value = -5000;
-					}
-					G3_dynamic.at(MINIMUM_BATTERY_POWER).write_set_value = true;
-					if (battery_discharge_only_switch_state_) {
-						G3_dynamic.at(MAXIMUM_BATTERY_POWER).write_value.int32_value = 0;
-					} else {
-						G3_dynamic.at(MAXIMUM_BATTERY_POWER).write_value.int32_value = 5000;
-					}
-					G3_dynamic.at(MAXIMUM_BATTERY_POWER).write_set_value = true;
-					ESP_LOGV(TAG, "New desired grid power: %d W", G3_dynamic.at(DESIRED_GRID_POWER).write_value.int32_value);
-					this->write_desired_grid_power(); // Write the new desired grid power, minimum battery power, and maximum battery power
-				}
+			if (this->baud_negotiation_.get_state() != BAUD_DONE) {
+				this->run_transactions(); // Only the probe and speed setting requests run until the baud rate is settled
+				return;
+			}
+			uint32_t loop_start = micros();
+			uint32_t phase_start = loop_start;
+			if (this->power_snapshot_interval_ > 0 && this->power_snapshot_pending_blocks_ == 0 && millis() - this->power_snapshot_last_request_ >= this->power_snapshot_interval_) {
+				this->queue_power_snapshot();
+			}
+
+			if (millis() - this->zero_export_last_update_ > ZERO_EXPORT_INTERVAL && this->zero_export_ && !this->site_controlled_ && this->power_snapshot_interval_ == 0) {
+				this->update_zero_export();
+			}
+			if (!this->debounced_writes_.empty()) {
+				this->flush_debounced_writes();
+			}
+			if (!this->polling_profiles_.empty() && millis() - this->polling_profile_last_check_ >= 1000) {
+				this->update_polling_profile();
+			}
+			phase_start = this->end_phase(PHASE_CONTROL, phase_start);
+
+			if (this->capture_.active && ((micros() - this->capture_.started) / 1000 >= this->capture_.duration || this->capture_.samples.size() == this->capture_.samples.capacity())) {
+				this->stop_capture();
 			}
 
-			for (auto &dynamic_register : this->G3_dynamic) {
+			// Resume the scan where the previous loop ran out of budget, polling pauses while a capture uses the bus
+			auto scan_it = this->capture_.active ? this->G3_dynamic.end() : this->G3_dynamic.lower_bound(this->scan_next_key_);
+			this->scan_next_key_ = 0;
+			for (; scan_it != this->G3_dynamic.end(); ++scan_it) {
+				auto &dynamic_register = *scan_it;
+				if (this->loop_budget_ > 0 && micros() - loop_start >= this->loop_budget_) {
+					ESP_LOGVV(TAG, "Loop budget exhausted, deferring scan from register %d", dynamic_register.first);
+					this->scan_next_key_ = dynamic_register.first;
+					break;
+				}
 				ESP_LOGVV(TAG, "Checking register %d for update. Last update %d, Update Intervall %d", dynamic_register.first, millis() - dynamic_register.second.last_update, dynamic_register.second.update_interval);
 				if (dynamic_register.second.is_queued) {
 					ESP_LOGVV(TAG, "Register %d is currently queued for reading/writing, skipping update check", dynamic_register.first);
 				}
-				if (millis() - dynamic_register.second.last_update >= dynamic_register.second.update_interval  && !dynamic_register.second.is_queued) {
+				if (dynamic_register.second.read_once && dynamic_register.second.read_complete) {
+					continue; // Static registers are never polled again
+				}
+				if (millis() - dynamic_register.second.last_update >= dynamic_register.second.effective_interval && !dynamic_register.second.is_queued) {
 					dynamic_register.second.last_update = millis(); // Update the last update time
-					register_read_task task;
-					task.register_key = dynamic_register.first; // Set the register key for the task
+					register_read_task task(dynamic_register.first);
 					dynamic_register.second.is_queued = true; // Mark the register as queued
-					register_read_queue.push(task); // Add the task to the read queue
-					ESP_LOGV(TAG, "Current reading queue size: %d", register_read_queue.size());
+					this->queue_read(task); // Add the task to the read queue
+					ESP_LOGV(TAG, "Current reading queue size: %d", this->poller_.get_read_queue_size());
 					ESP_LOGV(TAG, "Queued register %d for reading", dynamic_register.first);
 				}
 			}
+			phase_start = this->end_phase(PHASE_SCAN, phase_start);
+
+			ESP_LOGVV(TAG, "Current write queue size: %d", this->poller_.get_write_queue_size());
+			this->run_transactions();
+			phase_start = this->end_phase(PHASE_DISPATCH, phase_start);
+
+			// The next requests are on the bus already, the values of the responses are published in the remaining time
+			if (!this->publish_queue_.empty()) {
+				this->publish_queued_values(phase_start);
+				this->end_phase(PHASE_PUBLISH, phase_start);
+			}
+
+			if (this->telemetry_ != nullptr && !this->telemetry_->empty() && millis() - this->telemetry_->get_start() >= this->telemetry_batch_interval_) {
+				this->send_telemetry();
+			}
+
+			if (millis() - this->phase_statistics_last_publish_ >= this->phase_statistics_interval_) {
+				this->publish_phase_stats();
+				this->publish_link_stats();
+			}
+			if (millis() - this->freshness_last_check_ >= this->freshness_interval_ && !this->capture_.active) {
+				this->check_admission();
+				this->check_freshness();
+			}
+		}
+
+		void SofarSolar_Inverter::check_freshness() {
+			uint32_t now = millis();
+			this->freshness_last_check_ = now;
+			memset(this->freshness_histogram_, 0, sizeof(this->freshness_histogram_));
+			uint16_t missed = 0;
+			float max_ratio = 0;
+			for (auto &dynamic_register : G3_dynamic) {
+				SofarSolar_RegisterDynamic &reg = dynamic_register.second;
+				if (reg.effective_interval == 0 || (reg.read_once && reg.read_complete)) {
+					continue;
+				}
+				float ratio = static_cast<float>(now - reg.last_success) / reg.effective_interval;
+				uint8_t bucket = ratio < 1 ? 0 : ratio < 2 ? 1 : ratio < 4 ? 2 : 3;
+				this->freshness_histogram_[std::min<uint8_t>(register_priority(dynamic_register.first), FRESHNESS_CLASSES - 1)][bucket]++;
+				max_ratio = std::max(max_ratio, ratio);
+				if (ratio > this->freshness_target_) {
+					missed++;
+					ESP_LOGV(TAG, "Register %d is %.1f update intervals old", dynamic_register.first, ratio);
+				}
+				if (this->stale_after_ > 0 && ratio >= this->stale_after_ && !reg.stale) {
+					ESP_LOGW(TAG, "Register %d not read for %u ms, publishing it as unavailable", dynamic_register.first, now - reg.last_success);
+					reg.stale = true;
+					if (reg.sensor != nullptr) {
+						reg.sensor->publish_state(NAN);
+					}
+				}
+			}
+			for (uint8_t priority = 0; priority < FRESHNESS_CLASSES; priority++) {
+				const uint16_t *buckets = this->freshness_histogram_[priority];
+				ESP_LOGV(TAG, "Freshness of priority %d: %d fresh, %d within 2, %d within 4, %d older", priority, buckets[0], buckets[1], buckets[2], buckets[3]);
+			}
+			if (missed > 0) {
+				ESP_LOGD(TAG, "%d registers miss their freshness target, the poll schedule may be oversubscribed", missed);
+			}
+			if (this->stale_registers_sensor_ != nullptr) {
+				this->stale_registers_sensor_->publish_state(missed);
+			}
+			if (this->max_age_ratio_sensor_ != nullptr) {
+				this->max_age_ratio_sensor_->publish_state(max_ratio);
+			}
+		}
+
+		uint32_t SofarSolar_Inverter::get_average_round_trip() const {
+#ifdef USE_ESP32
+			if (this->io_task_ != nullptr) {
+				return this->io_task_->get_average_round_trip();
+			}
+#endif
+			return this->poller_.get_average_round_trip();
+		}
+
+		float SofarSolar_Inverter::estimate_transaction_time(uint16_t register_count) const {
+#ifdef USE_SOFARSOLAR_MODBUS
+			const SofarSolar_Transport *transport = this->tcp_transport_ != nullptr ? static_cast<const SofarSolar_Transport *>(this->tcp_transport_) : &this->modbus_transport_;
+#else
+			const SofarSolar_Transport *transport = this->tcp_transport_;
+#endif
+			float round_trip = this->get_average_round_trip();
+			if (this->tcp_transport_ == nullptr) {
+				// RTU read request of 8 bytes and response of 5 bytes plus the data, 10 bits per byte on the line
+				uint32_t baud_rate = this->current_baud_rate_ > 0 ? this->current_baud_rate_ : 9600;
+				round_trip = std::max(round_trip, (13 + register_count * 2) * 10 * 1000.0f / baud_rate);
+			}
+			return transport->get_request_gap() + round_trip / transport->get_max_outstanding();
+		}
+
+		void SofarSolar_Inverter::add_polling_profile(const std::string &name, uint8_t condition_register, float above, float below, uint32_t hold) {
+			SofarSolar_PollingProfile profile;
+			profile.name = name;
+			profile.condition_register = condition_register;
+			profile.above = above;
+			profile.below = below;
+			profile.hold = hold;
+			this->polling_profiles_.push_back(profile);
+		}
+
+		void SofarSolar_Inverter::update_polling_profile() {
+			uint32_t now = millis();
+			this->polling_profile_last_check_ = now;
+			int8_t selected = -1;
+			for (size_t i = 0; i < this->polling_profiles_.size(); i++) {
+				SofarSolar_PollingProfile &profile = this->polling_profiles_[i];
+				auto condition = G3_dynamic.find(profile.condition_register);
+				float value = condition != G3_dynamic.end() ? condition->second.last_value : NAN;
+				bool met = !std::isnan(value) && (std::isnan(profile.above) || value > profile.above) && (std::isnan(profile.below) || value < profile.below);
+				if (!met) {
+					profile.condition_since = 0; // The condition has to hold again for the whole time
+					continue;
+				}
+				if (profile.condition_since == 0) {
+					profile.condition_since = now;
+				}
+				if (selected < 0 && now - profile.condition_since >= profile.hold) {
+					selected = i; // The first profile in the configured order wins
+				}
+			}
+			if (selected != this->active_profile_) {
+				this->apply_polling_profile(selected);
+			}
+		}
+
+		void SofarSolar_Inverter::apply_polling_profile(int8_t index) {
+			const char *name = index < 0 ? "default" : this->polling_profiles_[index].name.c_str();
+			ESP_LOGI(TAG, "Switching to polling profile %s", name);
+			this->active_profile_ = index;
+			for (auto &dynamic_register : G3_dynamic) {
+				SofarSolar_RegisterDynamic &reg = dynamic_register.second;
+				reg.update_interval = reg.base_interval;
+				if (index >= 0) {
+					auto interval = this->polling_profiles_[index].intervals.find(dynamic_register.first);
+					if (interval != this->polling_profiles_[index].intervals.end()) {
+						reg.update_interval = interval->second;
+					}
+				}
+			}
+			this->check_admission(); // The new schedule may fit the bus better or worse
+			if (this->polling_profile_text_sensor_ != nullptr) {
+				this->polling_profile_text_sensor_->publish_state(name);
+			}
+		}
+
+		void SofarSolar_Inverter::check_admission() {
+			// Share of the bus time the configured schedule needs, split into protected and scalable registers
+			float protected_load = 0;
+			float scalable_load = 0;
+			for (auto &dynamic_register : G3_dynamic) {
+				SofarSolar_RegisterDynamic &reg = dynamic_register.second;
+				if (reg.update_interval == 0 || (reg.read_once && reg.read_complete)) {
+					continue;
+				}
+				float load = this->estimate_transaction_time(G3_registers.at(dynamic_register.first).register_count) / reg.update_interval;
+				if (register_priority(dynamic_register.first) >= ADMISSION_PROTECTED_PRIORITY) {
+					protected_load += load;
+				} else {
+					scalable_load += load;
+				}
+			}
+			if (this->power_snapshot_interval_ > 0) {
+				for (const SofarSolar_ReadBlock &block : this->power_snapshot_blocks_) {
+					protected_load += this->estimate_transaction_time(block.register_count) / this->power_snapshot_interval_;
+				}
+			}
+			float load = protected_load + scalable_load;
+			float scale_protected = 1.0f;
+			float scale = 1.0f;
+			if (this->target_utilisation_ > 0 && load > this->target_utilisation_) {
+				if (protected_load < this->target_utilisation_ * 0.9f) {
+					scale = scalable_load / (this->target_utilisation_ - protected_load); // Only the low priority registers slow down
+				} else {
+					scale = scale_protected = load / this->target_utilisation_; // Not even the protected registers fit, all slow down alike
+				}
+			}
+			if (std::fabs(scale - this->interval_scale_) > 0.05f) {
+				ESP_LOGD(TAG, "Poll schedule needs %.0f%% of the bus, scaling low priority intervals by %.2f", load * 100, scale);
+			}
+			this->interval_scale_ = scale;
+			for (auto &dynamic_register : G3_dynamic) {
+				SofarSolar_RegisterDynamic &reg = dynamic_register.second;
+				float factor = register_priority(dynamic_register.first) >= ADMISSION_PROTECTED_PRIORITY ? scale_protected : scale;
+				reg.effective_interval = reg.update_interval * factor;
+				if (reg.update_interval > 0 && !(reg.read_once && reg.read_complete)) {
+					ESP_LOGV(TAG, "Register %d: interval %u ms, effective %u ms, achieved %u ms", dynamic_register.first, reg.update_interval, reg.effective_interval, reg.achieved_interval);
+				}
+			}
+			if (this->bus_utilisation_sensor_ != nullptr) {
+				this->bus_utilisation_sensor_->publish_state(load * 100);
+			}
+			if (this->interval_scale_sensor_ != nullptr) {
+				this->interval_scale_sensor_->publish_state(scale);
+			}
+		}
+
+		uint32_t SofarSolar_Inverter::end_phase(uint8_t phase, uint32_t phase_start) {
+			uint32_t now = micros();
+			this->phase_stats_[phase].add(now - phase_start);
+			return now;
+		}
+
+		void SofarSolar_Inverter::publish_phase_stats() {
+			static const char *const phase_names[PHASE_COUNT] = {"scan", "control", "dispatch", "parse", "publish"};
+			this->phase_statistics_last_publish_ = millis();
+			for (uint8_t phase = 0; phase < PHASE_COUNT; phase++) {
+				SofarSolar_PhaseStats &stats = this->phase_stats_[phase];
+				ESP_LOGV(TAG, "Phase %s: %u runs, max %u us, avg %.1f us", phase_names[phase], stats.count, stats.max, stats.avg());
+				if (phase == PHASE_PUBLISH) {
+					ESP_LOGV(TAG, "%d values waiting to be published", this->publish_queue_.size());
+				}
+				if (stats.max_sensor != nullptr) {
+					stats.max_sensor->publish_state(stats.max);
+				}
+				if (stats.avg_sensor != nullptr) {
+					stats.avg_sensor->publish_state(stats.avg());
+				}
+				stats.reset();
+			}
+		}
+
+		void SofarSolar_Inverter::start_baud_negotiation() {
+			uint32_t original_baud_rate = 0;
+#ifdef USE_SOFARSOLAR_MODBUS
+			original_baud_rate = this->uart_->get_baud_rate();
+#endif
+			this->current_baud_rate_ = original_baud_rate;
+			ESP_LOGI(TAG, "Detecting the baud rate of the inverter, starting at %u baud", original_baud_rate);
+			this->probe_baud_rate(this->baud_negotiation_.start(original_baud_rate));
+		}
+
+		void SofarSolar_Inverter::apply_baud_rate(uint32_t baud_rate) {
+#ifdef USE_SOFARSOLAR_MODBUS
+			if (this->uart_->get_baud_rate() != baud_rate) {
+				ESP_LOGD(TAG, "Switching the UART to %u baud", baud_rate);
+				this->uart_->set_baud_rate(baud_rate);
+				this->uart_->load_settings(false);
+			}
+#endif
+			this->current_baud_rate_ = baud_rate;
+			this->poller_.restart_gap(); // Let the inverter see an idle line at the new rate before the next request
+		}
+
+		void SofarSolar_Inverter::probe_baud_rate(uint32_t baud_rate) {
+			this->apply_baud_rate(baud_rate);
+			register_read_task task(OPERATIONAL_STATUS);
+			task.probe = true;
+			this->queue_read(task);
+		}
+
+		void SofarSolar_Inverter::on_probe_response(const FrameView &frame) {
+			if (frame.size() != 2) {
+				ESP_LOGW(TAG, "Invalid probe response of %d bytes at %u baud", frame.size(), this->current_baud_rate_);
+				this->on_probe_failed();
+				return;
+			}
+			ESP_LOGI(TAG, "Inverter answered at %u baud", this->current_baud_rate_);
+			if (this->baud_negotiation_.on_probe_answered(this->current_baud_rate_) == BAUD_SWITCH) {
+				uint32_t target_baud_rate = this->baud_negotiation_.get_target_baud_rate();
+				uint16_t value = this->speed_setting_values_.at(target_baud_rate);
+				ESP_LOGI(TAG, "Switching the inverter to %u baud, writing %d to %04X", target_baud_rate, value, this->speed_setting_register_);
+				register_write_task task;
+				task.start_address = this->speed_setting_register_;
+				task.number_of_registers = 1;
+				task.data = {static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF)};
+				this->queue_write(task);
+				return;
+			}
+			if (this->link_baud_rate_sensor_ != nullptr) {
+				this->link_baud_rate_sensor_->publish_state(this->current_baud_rate_);
+			}
+			this->start_polling();
+		}
+
+		void SofarSolar_Inverter::on_probe_failed() {
+			if (this->baud_negotiation_.get_state() == BAUD_VERIFY) {
+				ESP_LOGW(TAG, "Inverter did not answer at %u baud, detecting again", this->current_baud_rate_);
+			}
+			uint32_t baud_rate = this->baud_negotiation_.on_probe_failed();
+			if (this->baud_negotiation_.get_state() == BAUD_DONE) {
+				ESP_LOGW(TAG, "Inverter did not answer at any baud rate, falling back to %u baud", baud_rate);
+				this->apply_baud_rate(baud_rate);
+				this->start_polling();
+				return;
+			}
+			this->probe_baud_rate(baud_rate);
+		}
+
+		void SofarSolar_Inverter::verify_target_baud_rate() {
+			this->probe_baud_rate(this->baud_negotiation_.on_switch_sent());
+		}
+
+		void SofarSolar_Inverter::publish_link_stats() {
+			uint32_t now = millis();
+			uint32_t elapsed = now - this->link_statistics_since_;
+			if (elapsed == 0) {
+				return;
+			}
+			float throughput = this->link_registers_ * 1000.0f / elapsed;
+			ESP_LOGV(TAG, "Link: %u baud, %.1f registers/s", this->current_baud_rate_, throughput);
+			if (this->link_baud_rate_sensor_ != nullptr && this->current_baud_rate_ > 0) {
+				this->link_baud_rate_sensor_->publish_state(this->current_baud_rate_);
+			}
+			if (this->link_throughput_sensor_ != nullptr) {
+				this->link_throughput_sensor_->publish_state(throughput);
+			}
+			this->link_registers_ = 0;
+			this->link_statistics_since_ = now;
+		}
 
-			ESP_LOGVV(TAG, "Current write queue size: %d", register_write_queue.size());
-			if(!current_reading && !current_writing && !register_write_queue.empty() && millis() - time_begin_modbus_operation > 150) {
-				// If there is a write task in the queue, process it
-				write_modbus_register(G3_registers.at(register_write_queue.top().first_register_key).start_address, register_write_queue.top().number_of_registers, register_write_queue.top().data); // Write the register
-				current_writing = true; // Set the flag to indicate that a write is in progress
-				time_begin_modbus_operation = millis(); // Record the start time of the Modbus operation
+		void SofarSolar_Inverter::queue_read(const register_read_task &task) {
+#ifdef USE_ESP32
+			if (this->io_task_ != nullptr) {
+				SofarSolar_IoRequest request;
+				request.read_task = task;
+				this->io_task_->queue(std::move(request));
+				return;
 			}
+#endif
+			this->poller_.queue_read(task);
+		}
 
-			if (!current_reading && !current_writing && !register_read_queue.empty() && millis() - time_begin_modbus_operation > 150) {
-				read_modbus_register(G3_registers.at(register_read_queue.top().register_key).start_address, G3_registers.at(register_read_queue.top().register_key).register_count);
-				current_reading = true; // Set the flag to indicate that a read is in progress
-				time_begin_modbus_operation = millis(); // Record the start time of the Modbus operation
+		void SofarSolar_Inverter::queue_write(const register_write_task &task) {
+			this->writes_outstanding_++;
+#ifdef USE_ESP32
+			if (this->io_task_ != nullptr) {
+				SofarSolar_IoRequest request;
+				request.is_write = true;
+				request.write_task = task;
+				this->io_task_->queue(std::move(request));
+				return;
 			}
+#endif
+			this->poller_.queue_write(task);
+		}
 
-			if (millis() - time_begin_modbus_operation > 500) { // Timeout for read operation
-				if (current_reading) {
-					G3_dynamic.at(register_read_queue.top().register_key).is_queued = false; // Mark the register as not queued
-					current_reading = false; // Reset the flag for read operation
-					register_read_queue.pop(); // Remove the top task from the read queue
-					ESP_LOGE(TAG, "Modbus read operation timed out");
-				} else if (current_writing) {
-					current_writing = false; // Reset the flag for write operation
-					register_write_queue.pop(); // Remove the top task from the write queue
-					ESP_LOGE(TAG, "Modbus write operation timed out");
+		void SofarSolar_Inverter::run_transactions() {
+#ifdef USE_ESP32
+			if (this->io_task_ != nullptr) {
+				// Hand over the results of the I/O task, they arrive in the order the poller produced them
+				SofarSolar_IoResult result;
+				while (this->io_task_->pop_result(result)) {
+					switch (result.kind) {
+					case IO_RESULT_READ: {
+						FrameView frame(result.data.data(), result.data.size());
+						this->response_received_ = result.received;
+						this->handle_read_response(result.request.read_task, frame, result.values.empty() ? nullptr : result.values.data());
+						this->response_received_ = 0;
+						break;
+					}
+					case IO_RESULT_WRITE:
+						this->response_received_ = result.received;
+						this->on_write_response(result.request.write_task, FrameView(result.data.data(), result.data.size()));
+						this->response_received_ = 0;
+						break;
+					case IO_RESULT_FAILED:
+						this->on_request_failed(result.request, result.code);
+						break;
+					case IO_RESULT_EXCEPTION:
+						this->on_exception(result.code, result.exception_code);
+						break;
+					case IO_RESULT_UNMATCHED:
+						this->on_unmatched_response(result.request.transaction_id);
+						break;
+					case IO_RESULT_FRAME:
+						this->record_frame(result.code, result.data.data(), result.data.size());
+						break;
+					}
 				}
+				this->io_task_->flush_backlog(); // Requests that did not fit into the ring move on as it drains
+				return;
 			}
+#endif
+			this->poller_.loop();
 		}
 
+#ifdef USE_SOFARSOLAR_MODBUS
 		void SofarSolar_Inverter::on_modbus_data(const std::vector<uint8_t> &data) {
 			ESP_LOGV(TAG, "Received Modbus data: %s", vector_to_string(data).c_str());
-			if(current_reading) {
-				parse_read_response(data);
-				time_begin_modbus_operation = millis(); // Reset the start time of the Modbus operation
-				G3_dynamic.at(register_read_queue.top().register_key).is_queued = false; // Mark the register as not queued
-				current_reading = false; // Reset the flag for read operation
-				register_read_queue.pop(); // Remove the top task from the read queue
-			} else if (current_writing) {
-				parse_write_response(data);
-				time_begin_modbus_operation = millis(); // Reset the start time of the Modbus operation
-				current_writing = false; // Reset the flag for read operation
-				register_write_queue.pop(); // Remove the top task from the read queue
+			this->modbus_transport_.on_data(0, data);
+		}
+
+		void SofarSolar_Inverter::on_modbus_error(uint8_t function_code, uint8_t exception_code) {
+			this->modbus_transport_.on_error(0, function_code, exception_code);
+		}
+#endif
+
+		void SofarSolar_Inverter::handle_combined_response(const register_write_task &task, const FrameView &frame) {
+			register_read_task read(task.read_register_key);
+			read.start_address = task.read_start_address;
+			read.register_count = task.read_register_count;
+			this->link_registers_ += read.register_count;
+			parse_read_response(frame, read);
+			auto dynamic_register = G3_dynamic.find(task.read_register_key);
+			if (dynamic_register != G3_dynamic.end()) {
+				dynamic_register->second.last_update = millis(); // The value is fresh, the next poll of the register can wait
+			}
+		}
+
+		void SofarSolar_Inverter::probe_combined(const register_write_task &task) {
+			// The write has just been acknowledged, writing the same values again changes nothing whether the inverter
+			// executes the probe or not, so a lost answer is harmless
+			register_write_task probe = task;
+			const SofarSolar_Register &reg = G3_registers.at(G3_write_feedback.at(task.first_register_key));
+			probe.read_register_key = G3_write_feedback.at(task.first_register_key);
+			probe.read_start_address = reg.start_address;
+			probe.read_register_count = reg.register_count;
+			probe.transaction = nullptr;
+			probe.probe = true;
+			this->combined_write_state_ = COMBINED_PROBING;
+			ESP_LOGD(TAG, "Probing function 0x17 with the values of group %d", task.first_register_key);
+			this->queue_write(probe);
+		}
+
+		void SofarSolar_Inverter::fail_combined_probe(const char *reason) {
+			if (this->combined_write_state_ != COMBINED_PROBING) {
+				return; // Rejected as illegal function already
+			}
+			if (++this->combined_probe_failures_ < COMBINED_PROBE_ATTEMPTS) {
+				ESP_LOGW(TAG, "Probe of function 0x17 failed (%s), probing again with a later write", reason);
+				this->combined_write_state_ = COMBINED_UNKNOWN;
+				return;
+			}
+			ESP_LOGW(TAG, "Probe of function 0x17 failed %d times (%s), writing and reading separately", this->combined_probe_failures_, reason);
+			this->combined_write_state_ = COMBINED_UNSUPPORTED;
+		}
+
+		bool SofarSolar_Inverter::fall_back_from_combined(const register_write_task &task, uint8_t reason) {
+			// Only an illegal function exception tells for sure that the write has not been executed. After a timeout or
+			// another exception the write may have been executed, it is not sent again.
+			if (this->combined_write_state_ != COMBINED_UNSUPPORTED || reason != REQUEST_EXCEPTION) {
+				return false;
+			}
+			register_write_task write = task;
+			write.read_register_key = 0;
+			write.read_start_address = 0;
+			write.read_register_count = 0;
+			this->queue_write(write);
+			auto dynamic_register = G3_dynamic.find(task.read_register_key);
+			if (dynamic_register != G3_dynamic.end() && !dynamic_register->second.is_queued) {
+				dynamic_register->second.is_queued = true;
+				dynamic_register->second.last_update = millis();
+				this->queue_read(register_read_task(task.read_register_key));
+			}
+			return true;
+		}
+
+		static const char *request_failure_text(uint8_t reason) {
+			switch (reason) {
+				case REQUEST_TIMEOUT: return "timeout";
+				case REQUEST_EXCEPTION: return "exception";
+				case REQUEST_DISCONNECTED: return "disconnected";
+				case REQUEST_ABORTED: return "aborted";
+				case REQUEST_INVALID: return "invalid response";
+				default: return "unknown";
+			}
+		}
+
+		void SofarSolar_Inverter::on_read_response(const register_read_task &task, const FrameView &frame) {
+			this->handle_read_response(task, frame, nullptr);
+		}
+
+		void SofarSolar_Inverter::handle_read_response(const register_read_task &task, const FrameView &frame, const float *values) {
+			if (task.probe) {
+				this->on_probe_response(frame);
+			} else if (task.scan) {
+				this->link_registers_ += task.register_count;
+				this->on_scan_response(task, frame);
+			} else if (task.capture) {
+				this->link_registers_ += task.register_count;
+				this->on_capture_response(task, frame, values);
 			} else {
-				ESP_LOGE(TAG, "Received Modbus data while not in a read or write operation");
+				this->link_registers_ += task.register_count;
+				this->write_cache_.check_read(task.start_address, frame);
+				parse_read_response(frame, task, values);
+				if (task.write_group) {
+					this->write_groups_fetching_.erase(task.register_key);
+					if (frame.size() != task.register_count * 2) {
+						ESP_LOGE(TAG, "Invalid response of %d bytes fetching write group %d, dropping the write", frame.size(), task.register_key);
+						this->fail_group_transactions(task.register_key, REQUEST_INVALID);
+					} else {
+						this->write_group(task.register_key, frame);
+					}
+				} else if (task.snapshot) {
+					if (this->is_pending_snapshot_block(task) && --this->power_snapshot_pending_blocks_ == 0) {
+						this->finish_power_snapshot();
+					}
+				} else {
+					auto dynamic_register = G3_dynamic.find(task.register_key);
+					if (dynamic_register != G3_dynamic.end()) {
+						dynamic_register->second.is_queued = false; // Mark the register as not queued
+					}
+				}
+			}
+			// The values are stored before the transaction completes, its callback sees them already
+			if (task.transaction != nullptr) {
+				task.transaction->complete(frame, millis());
 			}
 		}
 
-		void SofarSolar_Inverter::on_modbus_error(uint8_t function_code, uint8_t exception_code) {
+		void SofarSolar_Inverter::on_write_response(const register_write_task &task, const FrameView &frame) {
+			if (this->writes_outstanding_ > 0) {
+				this->writes_outstanding_--;
+			}
+			bool valid;
+			if (task.probe) {
+				if (frame.size() != task.read_register_count * 2u) {
+					this->fail_combined_probe("answer of the wrong size");
+					return;
+				}
+				ESP_LOGI(TAG, "Inverter supports function 0x17, group writes read their feedback register in the same request");
+				this->combined_write_state_ = COMBINED_SUPPORTED;
+				this->handle_combined_response(task, frame);
+				return; // The values were held already, nothing to report
+			}
+			if (task.read_register_count > 0) {
+				// A combined request answers with the registers read, the write has been executed before
+				valid = frame.size() == task.read_register_count * 2u;
+				if (valid) {
+					this->handle_combined_response(task, frame);
+				}
+			} else {
+				valid = parse_write_response(frame, task);
+			}
+			if (this->baud_negotiation_.get_state() == BAUD_SWITCH) {
+				this->verify_target_baud_rate();
+			}
+			if (valid) {
+				auto group = G3_write_groups.find(task.first_register_key);
+				if (group != G3_write_groups.end() && task.start_address == G3_registers.at(group->second.front()).start_address) {
+					this->write_cache_.store(task.first_register_key, millis(), task.data);
+					if (this->combined_write_state_ == COMBINED_UNKNOWN && this->combined_write_read_ && task.read_register_count == 0 && this->writes_outstanding_ == 0 &&
+							G3_write_feedback.count(task.first_register_key) > 0) {
+						this->probe_combined(task);
+					}
+				}
+				if (this->capture_.active) {
+					this->add_capture_sample(CAPTURE_CHANNEL_WRITE, task.start_address, this->get_response_time());
+				}
+				this->write_complete_callback_.call(task.start_address);
+			}
+			if (task.transaction != nullptr) {
+				if (valid) {
+					task.transaction->complete(frame, millis());
+				} else {
+					task.transaction->fail(REQUEST_INVALID, millis());
+				}
+			}
+		}
+
+		void SofarSolar_Inverter::on_request_failed(const in_flight_request &request, uint8_t reason) {
+			if (reason == REQUEST_TIMEOUT) {
+				ESP_LOGE(TAG, "Modbus %s operation timed out", request.is_write ? "write" : "read");
+			} else if (reason == REQUEST_DISCONNECTED) {
+				ESP_LOGW(TAG, "Modbus %s operation aborted, connection lost", request.is_write ? "write" : "read");
+			}
+			if (request.is_write) {
+				if (this->writes_outstanding_ > 0) {
+					this->writes_outstanding_--;
+				}
+				if (request.write_task.probe) {
+					this->fail_combined_probe(request_failure_text(reason)); // The values were held already, nothing to send again
+					return;
+				}
+				this->write_cache_.forget(request.write_task.first_register_key); // The inverter may hold the values or not, the next write goes out
+				if (this->baud_negotiation_.get_state() == BAUD_SWITCH) {
+					this->verify_target_baud_rate();
+				}
+				if (request.write_task.read_register_count > 0 && this->fall_back_from_combined(request.write_task, reason)) {
+					return; // Sent again as separate write and read, the transaction moved with the write
+				}
+				if (request.write_task.transaction != nullptr) {
+					request.write_task.transaction->fail(reason, millis());
+				}
+				return;
+			}
+			if (request.read_task.scan) {
+				this->on_scan_failed(request.read_task, reason);
+				return; // Failures are expected while scanning, they do not concern the polled registers
+			}
+			if (request.read_task.capture) {
+				this->capture_.failed++;
+				if (this->capture_.active) {
+					this->queue_read(request.read_task); // Keep sampling, the gap shows in the timestamps
+				}
+				return;
+			}
+			if (request.read_task.probe) {
+				this->on_probe_failed();
+			} else if (request.read_task.write_group) {
+				// Writing without the current values could overwrite settings with stale ones, the pending values wait for the next write
+				ESP_LOGW(TAG, "Current values of write group %d not available, write postponed", request.read_task.register_key);
+				this->write_groups_fetching_.erase(request.read_task.register_key);
+				this->fail_group_transactions(request.read_task.register_key, reason);
+			} else if (request.read_task.snapshot) {
+				if (this->is_pending_snapshot_block(request.read_task)) {
+					this->fail_power_snapshot("aborted");
+				}
+			} else {
+				auto dynamic_register = G3_dynamic.find(request.read_task.register_key);
+				if (dynamic_register != G3_dynamic.end()) {
+					dynamic_register->second.is_queued = false; // Mark the register as not queued
+				}
+			}
+			if (!request.read_task.probe) {
+				this->read_failed_callback_.call(request.read_task.start_address, request_failure_text(reason));
+			}
+			if (request.read_task.transaction != nullptr) {
+				request.read_task.transaction->fail(reason, millis());
+			}
+		}
+
+		void SofarSolar_Inverter::on_unmatched_response(uint16_t transaction_id) {
+			ESP_LOGE(TAG, "Received Modbus data while not in a read or write operation");
+		}
+
+		void SofarSolar_Inverter::on_exception(uint8_t function_code, uint8_t exception_code) {
+			this->last_exception_code_ = exception_code;
+			if (this->scan_.active && function_code == 0x83 && exception_code == 0x02) {
+				ESP_LOGV(TAG, "Illegal data address while scanning");
+				return;
+			}
 			ESP_LOGE(TAG, "Modbus error: Function code %02X, Exception code %02X", function_code, exception_code);
-			if (function_code == 0x03 || function_code == 0x10 || function_code == 0x90) {
+			if (function_code == 0x97 && exception_code == 0x01 && this->combined_write_state_ != COMBINED_UNSUPPORTED) {
+				// Other exceptions concern the registers of the request, not the function
+				ESP_LOGW(TAG, "Inverter rejected function 0x17 as illegal function, writing and reading separately");
+				this->combined_write_state_ = COMBINED_UNSUPPORTED; // A failed control write is sent again as separate write and read
+			}
+			if (function_code == 0x03 || function_code == 0x10 || function_code == 0x90 || function_code == 0x97) {
 				switch (exception_code) {
 				case 0x01:
 					ESP_LOGE(TAG, "Modbus error: Illegal function");
@@ -202,69 +920,603 @@ namespace esphome
 			}
 		}
 
-		void SofarSolar_Inverter::parse_read_response(const std::vector<uint8_t> &data) {
-			ESP_LOGVV(TAG, "Parsing read response: %s", vector_to_string(data).c_str());
-			switch (G3_registers.at(register_read_queue.top().register_key).type) {
-			case U_WORD: {
-					if (data.size() != 2) {
-						ESP_LOGE(TAG, "Invalid read response size for U_WORD: %d", data.size());
-						return;
-					}
-					uint16_t value = (data[0] << 8) | data[1];
-					float new_state = static_cast<float>(value) * get_power_of_ten(G3_registers.at(register_read_queue.top().register_key).scale);
-					G3_dynamic.at(register_read_queue.top().register_key).sensor->publish_state(new_state);
-					break;
+		void SofarSolar_Inverter::start_capture(const std::vector<uint8_t> &registers, uint32_t duration) {
+			if (this->capture_buffer_size_ == 0) {
+				ESP_LOGW(TAG, "No capture buffer configured, capture ignored");
+				return;
 			}
-			case S_WORD: {
-					if (data.size() != 2) {
-						ESP_LOGE(TAG, "Invalid read response size for S_WORD: %d", data.size());
-						return;
+			if (this->capture_.active) {
+				ESP_LOGW(TAG, "Capture already running, start ignored");
+				return;
+			}
+			this->capture_.active = true;
+			this->capture_.started = micros();
+			this->capture_.duration = duration;
+			this->capture_.registers = registers;
+			this->capture_.samples.clear(); // Keeps the capacity allocated at setup
+			this->capture_.failed = 0;
+			ESP_LOGI(TAG, "Capturing %d registers for %u ms, polling paused", registers.size(), duration);
+			// Every register is read again as soon as its response is in, so the reads follow each other back to back
+			for (uint8_t register_key : registers) {
+				register_read_task task(register_key);
+				task.capture = true;
+				this->queue_read(task);
+			}
+		}
+
+		void SofarSolar_Inverter::stop_capture() {
+			if (!this->capture_.active) {
+				return;
+			}
+			this->capture_.active = false; // Capture reads still in flight are not queued again
+			uint32_t now = millis();
+			for (auto &dynamic_register : G3_dynamic) {
+				dynamic_register.second.last_success = now; // The pause does not count as missed reads
+			}
+			this->freshness_last_check_ = now;
+			ESP_LOGI(TAG, "Capture done: %d samples in %u ms, %u failed reads, polling resumed", this->capture_.samples.size(), (micros() - this->capture_.started) / 1000, this->capture_.failed);
+			this->capture_complete_callback_.call();
+		}
+
+		void SofarSolar_Inverter::on_capture_response(const register_read_task &task, const FrameView &frame, const float *values) {
+			if (frame.size() == task.register_count * 2u) {
+				SofarSolar_DecodePlan &plan = this->get_decode_plan(task.start_address, task.register_count);
+				if (values == nullptr && decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data()) == plan.numeric.size()) {
+					values = plan.values.data();
+				}
+				auto channel = std::find(this->capture_.registers.begin(), this->capture_.registers.end(), task.register_key);
+				for (size_t i = 0; values != nullptr && i < plan.registers.size() && channel != this->capture_.registers.end(); i++) {
+					if (plan.registers[i].register_key == task.register_key) {
+						this->add_capture_sample(channel - this->capture_.registers.begin(), values[i], this->get_response_time());
 					}
-					int16_t value = (data[0] << 8) | data[1];
-					float new_state = static_cast<float>(value) * get_power_of_ten(G3_registers.at(register_read_queue.top().register_key).scale);
-					G3_dynamic.at(register_read_queue.top().register_key).sensor->publish_state(new_state);
-					break;
+				}
 			}
-			case U_DWORD: {
-					if (data.size() != 4) {
-						ESP_LOGE(TAG, "Invalid read response size for U_DWORD: %d", data.size());
-						return;
+			if (this->capture_.active) {
+				this->queue_read(task);
+			}
+		}
+
+		void SofarSolar_Inverter::add_capture_sample(uint8_t channel, float value, uint32_t time) {
+			if (this->capture_.samples.size() < this->capture_.samples.capacity()) {
+				this->capture_.samples.push_back(SofarSolar_CaptureSample{time - this->capture_.started, channel, value});
+			}
+		}
+
+		void SofarSolar_Inverter::dump_capture() {
+			if (this->capture_.active) {
+				ESP_LOGW(TAG, "Capture still running, dump ignored");
+				return;
+			}
+			char line[64];
+			this->capture_data_callback_.call("time_us,channel,value");
+			ESP_LOGI(TAG, "time_us,channel,value");
+			for (const SofarSolar_CaptureSample &sample : this->capture_.samples) {
+				if (sample.channel == CAPTURE_CHANNEL_WRITE) {
+					snprintf(line, sizeof(line), "%u,write,%04X", sample.time, static_cast<uint16_t>(sample.value));
+				} else if (sample.channel == CAPTURE_CHANNEL_POWER_METER) {
+					snprintf(line, sizeof(line), "%u,power_meter,%g", sample.time, sample.value);
+				} else {
+					snprintf(line, sizeof(line), "%u,%04X,%g", sample.time, G3_registers.at(this->capture_.registers[sample.channel]).start_address, sample.value);
+				}
+				ESP_LOGI(TAG, "%s", line);
+				this->capture_data_callback_.call(line);
+			}
+		}
+
+		uint32_t SofarSolar_Inverter::get_response_time() const {
+			return this->response_received_ != 0 ? this->response_received_ : micros();
+		}
+
+		void SofarSolar_Inverter::start_register_scan(uint16_t start_address, uint16_t end_address, uint8_t format, uint8_t resolution) {
+			if (this->scan_.active || this->scan_.outstanding) {
+				ESP_LOGW(TAG, "Register scan already running, start ignored");
+				return;
+			}
+			if (end_address < start_address) {
+				ESP_LOGW(TAG, "Invalid scan range %04X to %04X", start_address, end_address);
+				return;
+			}
+			this->scan_ = SofarSolar_RegisterScan{};
+			this->scan_.active = true;
+			this->scan_.format = format;
+			this->scan_.resolution = std::max<uint8_t>(resolution, 1);
+			this->scan_.next_address = start_address;
+			this->scan_.end_address = static_cast<uint32_t>(end_address) + 1;
+			this->scan_.started = millis();
+			ESP_LOGI(TAG, "Scanning registers %04X to %04X", start_address, end_address);
+			this->queue_scan_read();
+		}
+
+		void SofarSolar_Inverter::stop_register_scan() {
+			if (!this->scan_.active) {
+				return;
+			}
+			ESP_LOGI(TAG, "Register scan stopped at %04X", static_cast<uint16_t>(this->scan_.split.empty() ? this->scan_.next_address : this->scan_.split.back().first));
+			this->flush_scan_skip();
+			this->scan_.active = false; // The read still in flight is dropped when it returns
+		}
+
+		void SofarSolar_Inverter::queue_scan_read() {
+			register_read_task task;
+			task.scan = true;
+			if (!this->scan_.split.empty()) {
+				task.start_address = this->scan_.split.back().first;
+				task.register_count = this->scan_.split.back().second;
+				this->scan_.split.pop_back();
+			} else if (this->scan_.next_address < this->scan_.end_address) {
+				task.start_address = this->scan_.next_address;
+				task.register_count = std::min<uint32_t>(SCAN_MAX_REGISTERS, this->scan_.end_address - this->scan_.next_address);
+				this->scan_.next_address += task.register_count;
+			} else {
+				this->flush_scan_skip();
+				this->scan_.active = false;
+				ESP_LOGI(TAG, "Register scan done in %u s: %u registers read, %u skipped, %u requests", (millis() - this->scan_.started) / 1000, this->scan_.registers_read, this->scan_.registers_skipped, this->scan_.requests);
+				return;
+			}
+			this->scan_.outstanding = true;
+			this->scan_.requests++;
+			this->queue_read(task);
+		}
+
+		void SofarSolar_Inverter::on_scan_response(const register_read_task &task, const FrameView &frame) {
+			this->scan_.outstanding = false;
+			if (!this->scan_.active) {
+				return;
+			}
+			if (frame.size() != task.register_count * 2u) {
+				this->on_scan_failed(task, REQUEST_INVALID);
+				return;
+			}
+			this->flush_scan_skip();
+			this->scan_.retries = 0;
+			this->scan_.registers_read += task.register_count;
+			char buffer[16];
+			for (uint16_t line_start = 0; line_start < task.register_count; line_start += SCAN_LINE_REGISTERS) {
+				uint16_t address = task.start_address + line_start;
+				uint16_t line_end = std::min<uint16_t>(line_start + SCAN_LINE_REGISTERS, task.register_count);
+				std::string line;
+				if (this->scan_.format == SCAN_FORMAT_JSON) {
+					snprintf(buffer, sizeof(buffer), "%u", address);
+					line = std::string("{\"address\":") + buffer + ",\"values\":[";
+				} else {
+					snprintf(buffer, sizeof(buffer), "%04X:", address);
+					line = buffer;
+				}
+				for (uint16_t i = line_start; i < line_end; i++) {
+					uint16_t value = 0;
+					frame.read_uint16(i * 2, value); // The size of the frame has been checked
+					if (this->scan_.format == SCAN_FORMAT_JSON) {
+						snprintf(buffer, sizeof(buffer), i == line_start ? "%u" : ",%u", value);
+					} else {
+						snprintf(buffer, sizeof(buffer), " %04X", value);
 					}
-					uint32_t value = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
-					float new_state = static_cast<float>(value) * get_power_of_ten(G3_registers.at(register_read_queue.top().register_key).scale);
-					G3_dynamic.at(register_read_queue.top().register_key).sensor->publish_state(new_state);
-					break;
+					line += buffer;
+				}
+				if (this->scan_.format == SCAN_FORMAT_JSON) {
+					line += "]}";
+				}
+				this->emit_scan_line(address, line);
 			}
-			case S_DWORD: {
-					if (data.size() != 4) {
-						ESP_LOGE(TAG, "Invalid read response size for S_DWORD: %d", data.size());
-						return;
+			this->queue_scan_read();
+		}
+
+		void SofarSolar_Inverter::on_scan_failed(const register_read_task &task, uint8_t reason) {
+			this->scan_.outstanding = false;
+			if (!this->scan_.active) {
+				return;
+			}
+			if (reason == REQUEST_EXCEPTION && this->last_exception_code_ == 0x02) {
+				if (task.register_count > this->scan_.resolution) {
+					// Bisect the range, the lower half is read first so the output stays in address order
+					uint16_t half = task.register_count / 2;
+					this->scan_.split.emplace_back(task.start_address + half, task.register_count - half);
+					this->scan_.split.emplace_back(task.start_address, half);
+				} else {
+					this->skip_scan_range(task.start_address, task.register_count, "illegal data address");
+				}
+			} else if ((reason == REQUEST_TIMEOUT || reason == REQUEST_DISCONNECTED) && this->scan_.retries < SCAN_RETRIES) {
+				this->scan_.retries++;
+				this->scan_.split.emplace_back(task.start_address, task.register_count);
+			} else {
+				this->skip_scan_range(task.start_address, task.register_count, reason == REQUEST_EXCEPTION ? "exception" : request_failure_text(reason));
+			}
+			this->queue_scan_read();
+		}
+
+		void SofarSolar_Inverter::skip_scan_range(uint16_t start_address, uint16_t register_count, const char *reason) {
+			this->scan_.retries = 0;
+			this->scan_.registers_skipped += register_count;
+			// Neighbouring ranges skipped for the same reason are reported as one
+			if (this->scan_.skip_count > 0 && this->scan_.skip_reason == reason && this->scan_.skip_start + this->scan_.skip_count == start_address) {
+				this->scan_.skip_count += register_count;
+				return;
+			}
+			this->flush_scan_skip();
+			this->scan_.skip_start = start_address;
+			this->scan_.skip_count = register_count;
+			this->scan_.skip_reason = reason;
+		}
+
+		void SofarSolar_Inverter::flush_scan_skip() {
+			if (this->scan_.skip_count == 0) {
+				return;
+			}
+			char buffer[96];
+			if (this->scan_.format == SCAN_FORMAT_JSON) {
+				snprintf(buffer, sizeof(buffer), "{\"address\":%u,\"count\":%u,\"skipped\":\"%s\"}", this->scan_.skip_start, this->scan_.skip_count, this->scan_.skip_reason);
+			} else {
+				snprintf(buffer, sizeof(buffer), "%04X-%04X: skipped, %s", this->scan_.skip_start, this->scan_.skip_start + this->scan_.skip_count - 1, this->scan_.skip_reason);
+			}
+			this->emit_scan_line(this->scan_.skip_start, buffer);
+			this->scan_.skip_count = 0;
+		}
+
+		void SofarSolar_Inverter::emit_scan_line(uint16_t address, const std::string &line) {
+			ESP_LOGI(TAG, "%s", line.c_str());
+			this->scan_data_callback_.call(address, line);
+		}
+
+		SofarSolar_DecodePlan &SofarSolar_Inverter::get_decode_plan(uint16_t start_address, uint16_t register_count) {
+			uint32_t plan_key = (static_cast<uint32_t>(start_address) << 16) | register_count;
+			auto existing = this->decode_plans_.find(plan_key);
+			if (existing != this->decode_plans_.end()) {
+				return existing->second;
+			}
+			// Resolve the registers covered by the read once, later responses with the same layout only run the kernel
+			SofarSolar_DecodePlan &plan = this->decode_plans_[plan_key];
+			build_decode_plan(start_address, register_count, plan);
+			for (SofarSolar_DecodeEntry &entry : plan.registers) {
+				entry.tracked = G3_dynamic.find(entry.register_key) != G3_dynamic.end();
+			}
+			ESP_LOGV(TAG, "Built decode plan for %d registers at %04X: %d registers, %d numeric", register_count, start_address, plan.registers.size(), plan.numeric.size());
+			return plan;
+		}
+
+		void SofarSolar_Inverter::parse_read_response(const FrameView &frame, const register_read_task &task, const float *values) {
+			ESP_LOGVV(TAG, "Parsing read response of %d bytes for %d registers at %04X", frame.size(), task.register_count, task.start_address);
+			if (frame.size() != task.register_count * 2) {
+				ESP_LOGE(TAG, "Invalid read response size: expected %d, got %d", task.register_count * 2, frame.size());
+				return;
+			}
+			uint32_t phase_start = micros();
+			// Convert all numeric registers of the block in one pass, a single register read is a block of one
+			SofarSolar_DecodePlan &plan = this->get_decode_plan(task.start_address, task.register_count);
+			if (values == nullptr) {
+				if (decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data()) != plan.numeric.size()) {
+					ESP_LOGE(TAG, "Decode plan for %04X exceeds the read response", task.start_address);
+					return;
+				}
+				values = plan.values.data();
+			}
+			uint32_t now = millis();
+			for (size_t i = 0; i < plan.registers.size(); i++) {
+				const SofarSolar_DecodeEntry &entry = plan.registers[i];
+				bool requested = entry.register_key == task.register_key && !task.snapshot;
+				if (!requested && !task.snapshot && !entry.tracked) {
+					continue;
+				}
+				if (entry.tracked) {
+					SofarSolar_RegisterDynamic &dynamic_register = G3_dynamic.at(entry.register_key);
+					uint32_t interval = now - dynamic_register.last_success;
+					dynamic_register.achieved_interval = dynamic_register.achieved_interval == 0 ? interval : (dynamic_register.achieved_interval * 3 + interval) / 4;
+					dynamic_register.last_success = now;
+					if (dynamic_register.stale) {
+						dynamic_register.stale = false;
+						requested = true; // Replace the unavailable state right away
+					}
+				}
+				if (!this->bit_sensors_.empty()) {
+					this->publish_bit_sensors(entry.register_key, frame, entry.offset, entry.register_count);
+				}
+				switch (entry.type) {
+				case ASCII: {
+						std::string text(reinterpret_cast<const char *>(frame.data() + entry.offset), entry.register_count * 2);
+						text.erase(std::find(text.begin(), text.end(), '\0'), text.end());
+						text.erase(text.find_last_not_of(' ') + 1);
+						this->store_register_text(entry.register_key, text);
+						break;
+				}
+				case ENUM: {
+						uint16_t value;
+						frame.read_uint16(entry.offset, value);
+						const std::map<uint16_t, const char *> &texts = G3_enum_texts.at(entry.register_key);
+						auto text = texts.find(value);
+						this->store_register_text(entry.register_key, text != texts.end() ? text->second : "Unknown (" + esphome::to_string(value) + ")");
+						break;
+				}
+				case BITMAP:
+					break; // Only decoded into the binary sensors
+				default:
+					if (this->telemetry_ != nullptr) {
+						this->add_telemetry_sample(entry, frame, now);
+					}
+					if (this->is_pending_snapshot_block(task) && std::find(power_flow_snapshot_registers.begin(), power_flow_snapshot_registers.end(), entry.register_key) != power_flow_snapshot_registers.end()) {
+						// Only the block reads of the snapshot fill it, values of other reads are not part of the acquisition
+						this->power_snapshot_pending_.values[entry.register_key] = values[i];
+						this->power_snapshot_pending_.timestamps[entry.register_key] = now;
 					}
-					int32_t value = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
-					float new_state = static_cast<float>(value) * get_power_of_ten(G3_registers.at(register_read_queue.top().register_key).scale);
-					G3_dynamic.at(register_read_queue.top().register_key).sensor->publish_state(new_state);
+					this->store_register_value(entry.register_key, values[i], requested);
+				}
+			}
+			this->end_phase(PHASE_PARSE, phase_start);
+		}
+
+		void SofarSolar_Inverter::setup_telemetry() {
+			for (uint8_t register_key : this->telemetry_registers_) {
+				// Streamed registers are polled at the telemetry interval, a sensor of the register keeps publishing at its own
+				G3_dynamic.insert({register_key, SofarSolar_RegisterDynamic{}});
+				SofarSolar_RegisterDynamic &dynamic_register = G3_dynamic.at(register_key);
+				if (dynamic_register.update_interval == 0 || dynamic_register.update_interval > this->telemetry_interval_) {
+					dynamic_register.publish_interval = dynamic_register.update_interval;
+					dynamic_register.update_interval = this->telemetry_interval_;
+				}
+			}
+			if (this->telemetry_port_ > 0) {
+				this->telemetry_socket_ = socket::socket_ip(SOCK_DGRAM, IPPROTO_UDP);
+				this->telemetry_address_length_ = socket::set_sockaddr(reinterpret_cast<struct sockaddr *>(&this->telemetry_address_), sizeof(this->telemetry_address_), this->telemetry_host_, this->telemetry_port_);
+				if (this->telemetry_socket_ == nullptr || this->telemetry_address_length_ == 0) {
+					ESP_LOGE(TAG, "Could not create the telemetry socket to %s:%u", this->telemetry_host_.c_str(), this->telemetry_port_);
+					this->telemetry_socket_ = nullptr;
+				} else {
+					this->telemetry_socket_->setblocking(false);
+				}
+			}
+		}
+
+		void SofarSolar_Inverter::add_telemetry_sample(const SofarSolar_DecodeEntry &entry, const FrameView &frame, uint32_t now) {
+			auto channel = std::find(this->telemetry_registers_.begin(), this->telemetry_registers_.end(), entry.register_key);
+			if (channel == this->telemetry_registers_.end()) {
+				return;
+			}
+			// The raw register value is streamed, the receiver applies the scale
+			int32_t value;
+			if (entry.type == U_DWORD || entry.type == S_DWORD) {
+				uint32_t raw = 0;
+				frame.read_uint32(entry.offset, raw);
+				value = static_cast<int32_t>(raw);
+			} else {
+				uint16_t raw = 0;
+				frame.read_uint16(entry.offset, raw);
+				value = entry.type == S_WORD ? static_cast<int16_t>(raw) : raw;
+			}
+			uint8_t index = channel - this->telemetry_registers_.begin();
+			if (!this->telemetry_->add(index, now, value)) {
+				this->send_telemetry(); // The packet is full
+				this->telemetry_->add(index, now, value);
+			}
+		}
+
+		void SofarSolar_Inverter::send_telemetry() {
+			bool sent = false;
+			if (this->telemetry_socket_ != nullptr) {
+				sent = this->telemetry_socket_->sendto(this->telemetry_->data(), this->telemetry_->size(), 0, reinterpret_cast<struct sockaddr *>(&this->telemetry_address_), this->telemetry_address_length_) == static_cast<ssize_t>(this->telemetry_->size());
+			}
+#ifdef USE_MQTT
+			if (!this->telemetry_topic_.empty() && mqtt::global_mqtt_client != nullptr && mqtt::global_mqtt_client->is_connected()) {
+				sent = mqtt::global_mqtt_client->publish(this->telemetry_topic_, reinterpret_cast<const char *>(this->telemetry_->data()), this->telemetry_->size()) || sent;
+			}
+#endif
+			if (sent) {
+				this->telemetry_packets_++;
+			} else {
+				this->telemetry_dropped_++;
+			}
+			ESP_LOGVV(TAG, "Telemetry packet %u with %u samples in %d bytes %s", this->telemetry_->get_sequence(), this->telemetry_->get_count(), this->telemetry_->size(), sent ? "sent" : "dropped");
+			this->telemetry_->reset(); // The sequence number also counts dropped packets, the receiver sees the gap
+		}
+
+		void SofarSolar_Inverter::store_register_value(uint8_t register_key, float value, bool requested) {
+			auto it = G3_dynamic.find(register_key);
+			if (it == G3_dynamic.end()) {
+				return;
+			}
+			it->second.last_value = value;
+			if (it->second.number != nullptr && this->pending_writes_.count(register_key) == 0) {
+				it->second.number->publish_state(value); // A pending change is shown until it is written
+			}
+			if (it->second.sensor == nullptr) {
+				return;
+			}
+			if (it->second.aggregate != nullptr) {
+				// Every sample feeds the window, only the aggregates are published once per window
+				it->second.aggregate->add(value, millis());
+				if (it->second.aggregate->count > 0 && millis() - it->second.aggregate->window_start >= it->second.aggregate->window) {
+					this->publish_aggregate(it->second);
+				}
+				return;
+			}
+			if (!requested) {
+				// Publish values that arrive with another read only when the register is due anyway, saving its own read
+				if (it->second.is_queued || millis() - it->second.last_update < it->second.effective_interval) {
+					return;
+				}
+				it->second.last_update = millis();
+			}
+			if (it->second.publish_interval > 0) {
+				if (millis() - it->second.last_publish < it->second.publish_interval) {
+					return; // Read faster for the telemetry stream, the sensor keeps its own rate
+				}
+				it->second.last_publish = millis();
+			}
+			// Published from the loop, a value stored again before that replaces the queued one
+			this->publish_queue_.insert(std::make_pair(static_cast<uint8_t>(UINT8_MAX - register_priority(register_key)), register_key));
+		}
+
+		void SofarSolar_Inverter::publish_queued_values(uint32_t phase_start) {
+			// Highest priority first, at least one value per loop so the queue always drains
+			do {
+				auto next = this->publish_queue_.begin();
+				auto it = G3_dynamic.find(next->second);
+				this->publish_queue_.erase(next);
+				if (it != G3_dynamic.end() && it->second.sensor != nullptr && !it->second.stale) {
+					it->second.sensor->publish_state(it->second.last_value);
+				}
+			} while (!this->publish_queue_.empty() && micros() - phase_start < this->publish_budget_);
+			if (!this->publish_queue_.empty()) {
+				ESP_LOGVV(TAG, "Publish budget used up, %d values left for the next loop", this->publish_queue_.size());
+			}
+		}
+
+		void SofarSolar_Inverter::store_register_text(uint8_t register_key, const std::string &text) {
+			auto it = G3_dynamic.find(register_key);
+			if (it == G3_dynamic.end() || it->second.text_sensor == nullptr) {
+				return;
+			}
+			it->second.read_complete = true;
+			if (it->second.text_sensor->has_state() && it->second.text_sensor->state == text) {
+				return; // Only publish changes
+			}
+			it->second.text_sensor->publish_state(text);
+		}
+
+		void SofarSolar_Inverter::publish_bit_sensors(uint8_t register_key, const FrameView &frame, size_t offset, uint16_t register_count) {
+			for (const SofarSolar_BitSensor &bit_sensor : this->bit_sensors_) {
+				uint16_t word;
+				if (bit_sensor.register_key != register_key || bit_sensor.word >= register_count || !frame.read_uint16(offset + bit_sensor.word * 2, word)) {
+					continue;
+				}
+				bool state = (word & bit_sensor.mask) != 0;
+				if (bit_sensor.sensor->has_state() && bit_sensor.sensor->state == state) {
+					continue; // Only publish transitions
+				}
+				ESP_LOGD(TAG, "Bits %04X of word %d in register %d changed to %s", bit_sensor.mask, bit_sensor.word, register_key, ONOFF(state));
+				bit_sensor.sensor->publish_state(state);
+			}
+		}
+
+		void SofarSolar_Inverter::add_fault_binary_sensor(binary_sensor::BinarySensor *sensor, uint8_t word, uint16_t mask) {
+			if (G3_dynamic.insert({FAULT_WORDS, SofarSolar_RegisterDynamic{}}).second) {
+				G3_dynamic.at(FAULT_WORDS).update_interval = this->binary_sensor_update_interval_;
+			}
+			this->bit_sensors_.push_back(SofarSolar_BitSensor{FAULT_WORDS, word, mask, sensor});
+		}
+
+		void SofarSolar_Inverter::add_power_control_binary_sensor(binary_sensor::BinarySensor *sensor, uint16_t mask) {
+			if (G3_dynamic.insert({POWER_CONTROL, SofarSolar_RegisterDynamic{}}).second) {
+				G3_dynamic.at(POWER_CONTROL).update_interval = this->binary_sensor_update_interval_;
+			}
+			this->bit_sensors_.push_back(SofarSolar_BitSensor{POWER_CONTROL, 0, mask, sensor});
+		}
+
+		void SofarSolar_Inverter::publish_aggregate(SofarSolar_RegisterDynamic &dynamic_register) {
+			SofarSolar_Aggregate *aggregate = dynamic_register.aggregate;
+			ESP_LOGV(TAG, "Publishing aggregate of %d samples: min %f, max %f, mean %f, last %f", aggregate->count, aggregate->min, aggregate->max, aggregate->mean(), aggregate->last);
+			if (aggregate->count > 0) {
+				switch (aggregate->mode) {
+				case AGGREGATE_MIN:
+					dynamic_register.sensor->publish_state(aggregate->min);
 					break;
+				case AGGREGATE_MAX:
+					dynamic_register.sensor->publish_state(aggregate->max);
+					break;
+				case AGGREGATE_LAST:
+					dynamic_register.sensor->publish_state(aggregate->last);
+					break;
+				default:
+					dynamic_register.sensor->publish_state(aggregate->mean());
+				}
+				if (aggregate->min_sensor != nullptr) {
+					aggregate->min_sensor->publish_state(aggregate->min);
+				}
+				if (aggregate->max_sensor != nullptr) {
+					aggregate->max_sensor->publish_state(aggregate->max);
+				}
+			}
+			aggregate->reset();
+		}
+
+		void SofarSolar_Inverter::add_sensor_aggregation(sensor::Sensor *sensor, uint32_t window, uint8_t mode, sensor::Sensor *min_sensor, sensor::Sensor *max_sensor) {
+			for (auto &dynamic_register : G3_dynamic) {
+				if (dynamic_register.second.sensor != sensor) {
+					continue;
+				}
+				SofarSolar_Aggregate *aggregate = new SofarSolar_Aggregate();
+				aggregate->window = window;
+				aggregate->mode = mode;
+				aggregate->min_sensor = min_sensor;
+				aggregate->max_sensor = max_sensor;
+				dynamic_register.second.aggregate = aggregate;
+				return;
+			}
+			ESP_LOGE(TAG, "No register found for aggregated sensor %s", sensor->get_name().c_str());
+		}
+
+		void SofarSolar_Inverter::queue_power_snapshot() {
+			this->power_snapshot_last_request_ = millis();
+			this->power_snapshot_pending_ = SofarSolar_Snapshot{};
+			this->power_snapshot_pending_.acquisition_start = millis();
+			this->power_snapshot_generation_++; // Blocks of a failed snapshot may still be queued or in flight
+			for (const SofarSolar_ReadBlock &block : this->power_snapshot_blocks_) {
+				register_read_task task;
+				task.register_key = block.first_register_key;
+				task.start_address = block.start_address;
+				task.register_count = block.register_count;
+				task.snapshot = true;
+				task.snapshot_generation = this->power_snapshot_generation_;
+				this->queue_read(task);
 			}
-			default:
-				ESP_LOGE(TAG, "Unsupported register type for read response: %d", G3_registers.at(register_read_queue.top().register_key).type);
+			this->power_snapshot_pending_blocks_ = this->power_snapshot_blocks_.size();
+			ESP_LOGV(TAG, "Queued power flow snapshot with %d block reads", this->power_snapshot_pending_blocks_);
+		}
+
+		void SofarSolar_Inverter::finish_power_snapshot() {
+			this->power_snapshot_pending_.acquisition_end = millis();
+			this->power_snapshot_pending_.valid = this->power_snapshot_pending_.values.size() == power_flow_snapshot_registers.size();
+			if (!this->power_snapshot_pending_.valid) {
+				this->fail_power_snapshot("incomplete");
 				return;
 			}
+			this->power_snapshot_ = this->power_snapshot_pending_; // Replace the published snapshot as a whole
+			this->power_snapshot_failures_ = 0;
+			ESP_LOGV(TAG, "Power flow snapshot acquired in %d ms", this->power_snapshot_.acquisition_end - this->power_snapshot_.acquisition_start);
+			if (this->zero_export_ && !this->site_controlled_) {
+				this->update_zero_export();
+			}
 		}
 
-		void SofarSolar_Inverter::parse_write_response(const std::vector<uint8_t> &data) {
-			ESP_LOGVV(TAG, "Parsing write response: %s", vector_to_string(data).c_str());
-			if (data.size() != 4) {
-				ESP_LOGE(TAG, "Invalid write response size: %d", data.size());
+		void SofarSolar_Inverter::fail_power_snapshot(const char *reason) {
+			this->power_snapshot_pending_blocks_ = 0;
+			if (this->power_snapshot_failures_ < UINT8_MAX) {
+				this->power_snapshot_failures_++;
 			}
-			if (G3_registers.at(register_write_queue.top().first_register_key).start_address != ((data[0] << 8) | data[1])) {
-				ESP_LOGE(TAG, "Invalid response address: expected %04X, got %02X%02X", G3_registers.at(register_write_queue.top().first_register_key).start_address, data[2], data[3]);
-				return; // Invalid response address
+			if (this->power_snapshot_failures_ < POWER_SNAPSHOT_MAX_FAILURES) {
+				ESP_LOGW(TAG, "Power flow snapshot %s, keeping the previous snapshot", reason);
+				return;
 			}
-			if (register_write_queue.top().number_of_registers != ((data[2] << 8) | data[3])) {
-				ESP_LOGE(TAG, "Invalid response quantity: expected %d, got %02X", register_write_queue.top().number_of_registers, ((data[2] << 8) | data[3]));
-				return; // Invalid response quantity
+			// The zero export control only runs on new snapshots, the last limit would otherwise stay in force without control
+			ESP_LOGW(TAG, "Power flow snapshot %s, %d failed in a row, dropping the previous snapshot", reason, this->power_snapshot_failures_);
+			this->power_snapshot_.valid = false;
+			if (this->zero_export_ && !this->site_controlled_) {
+				ESP_LOGW(TAG, "Limiting the export to 0 until the power flow snapshots work again");
+				this->apply_export_limit(0);
 			}
-		};
+		}
+
+		uint32_t SofarSolar_Inverter::get_power_meter_age() const {
+			if (this->power_sensor_ == nullptr || this->power_meter_last_update_ == 0) {
+				return UINT32_MAX;
+			}
+			return millis() - this->power_meter_last_update_;
+		}
+
+		bool SofarSolar_Inverter::parse_write_response(const FrameView &frame, const register_write_task &task) {
+			ESP_LOGVV(TAG, "Parsing write response of %d bytes", frame.size());
+			uint16_t address;
+			uint16_t quantity;
+			if (frame.size() != 4 || !frame.read_uint16(0, address) || !frame.read_uint16(2, quantity)) {
+				ESP_LOGE(TAG, "Invalid write response size: %d", frame.size());
+				return false; // Invalid response size
+			}
+			if (task.start_address != address) {
+				ESP_LOGE(TAG, "Invalid response address: expected %04X, got %04X", task.start_address, address);
+				return false; // Invalid response address
+			}
+			if (task.number_of_registers != quantity) {
+				ESP_LOGE(TAG, "Invalid response quantity: expected %d, got %d", task.number_of_registers, quantity);
+				return false; // Invalid response quantity
+			}
+			return true;
+		}
 
 		//if (response.data()[2] != response.size() - 5 && response.data()[2] != register_info.quantity * 2) {
 		//    ESP_LOGE(TAG, "Invalid response size: expected %d, got %d", response.data()[2], response.size() - 5);
@@ -292,8 +1544,32 @@ namespace esphome
 			ESP_LOGCONFIG(TAG, "SofarSolar_Inverter");
 			ESP_LOGCONFIG(TAG, "  model = %s", this->model_.c_str());
 			ESP_LOGCONFIG(TAG, "  modbus_address = %i", this->modbus_address_);
-			ESP_LOGCONFIG(TAG, "  zero_export = %s", TRUEFALSE(this->zero_export_));
+			ESP_LOGCONFIG(TAG, "  zero_export = %s%s", TRUEFALSE(this->zero_export_), this->site_controlled_ ? " (controlled by the site)" : "");
 			ESP_LOGCONFIG(TAG, "  power_sensor = %s", this->power_sensor_ ? this->power_sensor_->get_name().c_str() : "None");
+			ESP_LOGCONFIG(TAG, "  power_meter_max_age = %u ms", this->power_meter_max_age_);
+			ESP_LOGCONFIG(TAG, "  loop_budget = %u us", this->loop_budget_);
+			ESP_LOGCONFIG(TAG, "  publish_budget = %u us", this->publish_budget_);
+			if (this->capture_buffer_size_ > 0) {
+				ESP_LOGCONFIG(TAG, "  capture_buffer_size = %u samples", this->capture_buffer_size_);
+			}
+			if (this->telemetry_ != nullptr) {
+				ESP_LOGCONFIG(TAG, "  telemetry = %d registers every %u ms, sent at least every %u ms", this->telemetry_registers_.size(), this->telemetry_interval_, this->telemetry_batch_interval_);
+				if (this->telemetry_port_ > 0) {
+					ESP_LOGCONFIG(TAG, "  telemetry_udp = %s:%u", this->telemetry_host_.c_str(), this->telemetry_port_);
+				}
+				if (!this->telemetry_topic_.empty()) {
+					ESP_LOGCONFIG(TAG, "  telemetry_mqtt_topic = %s", this->telemetry_topic_.c_str());
+				}
+				ESP_LOGCONFIG(TAG, "  telemetry packets = %u sent, %u dropped", this->telemetry_packets_, this->telemetry_dropped_);
+			}
+			if (this->tcp_transport_ != nullptr) {
+				ESP_LOGCONFIG(TAG, "  transport = %s to %s:%u, max_outstanding = %u, timeout = %u ms", this->tcp_transport_->get_protocol() == TCP_PROTOCOL_MODBUS_TCP ? "Modbus TCP" : "RTU over TCP", this->tcp_transport_->get_host().c_str(), this->tcp_transport_->get_port(), this->tcp_transport_->get_max_outstanding(), this->tcp_transport_->get_timeout());
+			}
+			if (this->uart_ != nullptr) {
+				ESP_LOGCONFIG(TAG, "  baud_rate = %u, target_baud_rate = %u", this->current_baud_rate_, this->baud_negotiation_.get_target_baud_rate());
+			}
+			ESP_LOGCONFIG(TAG, "  combined_write_read = %s", this->combined_write_read_ ? (this->combined_write_state_ == COMBINED_SUPPORTED ? "supported" : this->combined_write_state_ == COMBINED_UNSUPPORTED ? "not supported" : this->combined_write_state_ == COMBINED_PROBING ? "probing" : "not probed yet") : "off");
+			ESP_LOGCONFIG(TAG, "  target_utilisation = %.0f%%, interval_scale = %.2f", this->target_utilisation_ * 100, this->interval_scale_);
 			//std::string log_str;
 			//for (const auto &reg : G3_registers) {
 			//	log_str +=
@@ -307,377 +1583,233 @@ namespace esphome
 			//ESP_LOGCONFIG(TAG, "%s", log_str.c_str());
 		}
 
-		void SofarSolar_Inverter::read_modbus_register(uint16_t start_address, uint16_t register_count) {
-			// Create Modbus frame for reading registers
-			std::vector<uint8_t> frame = {static_cast<uint8_t>(this->modbus_address_), 0x03, static_cast<uint8_t>(start_address >> 8), static_cast<uint8_t>(start_address & 0xFF), static_cast<uint8_t>(register_count >> 8), static_cast<uint8_t>(register_count & 0xFF)};
-			ESP_LOGV(TAG, "Reading Modbus registers: %s", vector_to_string(frame).c_str());
-			this->send_raw(frame);
+		void SofarSolar_Inverter::record_frame(uint8_t direction, const uint8_t *data, size_t size) {
+			if (this->bus_recorder_.empty()) {
+				return;
+			}
+			SofarSolar_RecordedFrame &frame = this->bus_recorder_[this->bus_recorder_next_];
+			frame.timestamp = millis();
+			frame.direction = direction;
+			frame.size = size;
+			std::memcpy(frame.data, data, std::min<size_t>(size, RECORD_FRAME_SIZE));
+			this->bus_recorder_next_ = (this->bus_recorder_next_ + 1) % this->bus_recorder_.size();
+			this->bus_recorder_count_++;
 		}
 
-		void SofarSolar_Inverter::write_modbus_register(uint16_t start_address, uint16_t register_count, const std::vector<uint8_t> &data) {
-			// Create Modbus frame for writing registers
-			std::vector<uint8_t> frame = {static_cast<uint8_t>(this->modbus_address_), 0x10, static_cast<uint8_t>(start_address >> 8), static_cast<uint8_t>(start_address & 0xFF), static_cast<uint8_t>(register_count >> 8), static_cast<uint8_t>(register_count & 0xFF), static_cast<uint8_t>(data.size())};
-			frame.insert(frame.end(), data.begin(), data.end());
-			ESP_LOGV(TAG, "Writing Modbus registers: %s", vector_to_string(frame).c_str());
-			this->send_raw(frame);
+		void SofarSolar_Inverter::dump_bus_recorder() {
+			if (this->bus_recorder_.empty()) {
+				ESP_LOGW(TAG, "Bus recorder is disabled, set bus_recorder_size to enable it");
+				return;
+			}
+			size_t count = std::min<size_t>(this->bus_recorder_count_, this->bus_recorder_.size());
+			ESP_LOGI(TAG, "Bus recorder dump: %d of %d frames", count, this->bus_recorder_count_);
+			// Oldest frame first, one line per frame: timestamp, direction, original size, bytes
+			for (size_t i = 0; i < count; i++) {
+				const SofarSolar_RecordedFrame &frame = this->bus_recorder_[(this->bus_recorder_next_ + this->bus_recorder_.size() - count + i) % this->bus_recorder_.size()];
+				std::vector<uint8_t> bytes(frame.data, frame.data + std::min<size_t>(frame.size, RECORD_FRAME_SIZE));
+				const char *direction = frame.direction == RECORD_TX ? "TX" : (frame.direction == RECORD_RX ? "RX" : "ERR");
+				ESP_LOGI(TAG, "REC %u %s %d %s", frame.timestamp, direction, frame.size, vector_to_string(bytes).c_str());
+			}
 		}
 
 		void SofarSolar_Inverter::write_desired_grid_power() {
 			ESP_LOGD(TAG, "Writing desired grid power, minimum battery power, and maximum battery power");
-			// Write the desired grid power, minimum battery power, and maximum battery power
-			int32_t new_desired_grid_power;
-			if (G3_dynamic.at(DESIRED_GRID_POWER).enforce_default_value && G3_dynamic.at(DESIRED_GRID_POWER).default_value_set) {
-				new_desired_grid_power = G3_dynamic.at(DESIRED_GRID_POWER).default_value.int32_value;
-			} else if (G3_dynamic.at(DESIRED_GRID_POWER).write_set_value) {
-				new_desired_grid_power = G3_dynamic.at(DESIRED_GRID_POWER).write_value.int32_value;
-			} else {
-				new_desired_grid_power = G3_dynamic.at(DESIRED_GRID_POWER).sensor->state;
-			}
-			int32_t new_minimum_battery_power;
-			if (G3_dynamic.at(MINIMUM_BATTERY_POWER).enforce_default_value && G3_dynamic.at(MINIMUM_BATTERY_POWER).default_value_set) {
-				new_minimum_battery_power = G3_dynamic.at(MINIMUM_BATTERY_POWER).default_value.int32_value;
-			} else if (G3_dynamic.at(MINIMUM_BATTERY_POWER).write_set_value) {
-				new_minimum_battery_power = G3_dynamic.at(MINIMUM_BATTERY_POWER).write_value.int32_value;
-			} else {
-				new_minimum_battery_power = G3_dynamic.at(MINIMUM_BATTERY_POWER).sensor->state;
-			}
-			int32_t new_maximum_battery_power;
-			if (G3_dynamic.at(MAXIMUM_BATTERY_POWER).enforce_default_value && G3_dynamic.at(MAXIMUM_BATTERY_POWER).default_value_set) {
-				new_maximum_battery_power = G3_dynamic.at(MAXIMUM_BATTERY_POWER).default_value.int32_value;
-			} else if (G3_dynamic.at(MAXIMUM_BATTERY_POWER).write_set_value) {
-				new_maximum_battery_power = G3_dynamic.at(MAXIMUM_BATTERY_POWER).write_value.int32_value;
-			} else {
-				new_maximum_battery_power = G3_dynamic.at(MAXIMUM_BATTERY_POWER).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing desired grid power: %d W", new_desired_grid_power);
-			ESP_LOGV(TAG, "Writing minimum battery power: %d W", new_minimum_battery_power);
-			ESP_LOGV(TAG, "Writing maximum battery power: %d W", new_maximum_battery_power);
-			std::vector<uint8_t> data;
-			data.push_back(static_cast<uint8_t>(new_desired_grid_power >> 24));
-			data.push_back(static_cast<uint8_t>(new_desired_grid_power >> 16));
-			data.push_back(static_cast<uint8_t>(new_desired_grid_power >> 8));
-			data.push_back(static_cast<uint8_t>(new_desired_grid_power & 0xFF));
-			data.push_back(static_cast<uint8_t>(new_minimum_battery_power >> 24));
-			data.push_back(static_cast<uint8_t>(new_minimum_battery_power >> 16));
-			data.push_back(static_cast<uint8_t>(new_minimum_battery_power >> 8));
-			data.push_back(static_cast<uint8_t>(new_minimum_battery_power & 0xFF));
-			data.push_back(static_cast<uint8_t>(new_maximum_battery_power >> 24));
-			data.push_back(static_cast<uint8_t>(new_maximum_battery_power >> 16));
-			data.push_back(static_cast<uint8_t>(new_maximum_battery_power >> 8));
-			data.push_back(static_cast<uint8_t>(new_maximum_battery_power & 0xFF));
-			register_write_task task;
-			task.first_register_key = DESIRED_GRID_POWER; // Set the register key for the write task
-			task.number_of_registers = (data.size() >> 1); // Set the number of registers to write
-			ESP_LOGV(TAG, "Number of registers to write: %d", task.number_of_registers);
-			task.data = data; // Set the data to write
-			register_write_queue.push(task); // Add the write task to the queue
+			this->queue_group_write(DESIRED_GRID_POWER);
 		}
 
-		void SofarSolar_Inverter::write_battery_conf() {
-			// Write the battery configuration
-			std::vector<uint8_t> data;
+		void SofarSolar_Inverter::write_battery_conf(bool force) {
 			ESP_LOGD(TAG, "Writing battery configuration");
-			uint16_t new_battery_conf_id;
-			if (G3_dynamic.at(BATTERY_CONF_ID).enforce_default_value && G3_dynamic.at(BATTERY_CONF_ID).default_value_set) {
-				new_battery_conf_id = G3_dynamic.at(BATTERY_CONF_ID).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_ID).write_set_value) {
-				new_battery_conf_id = G3_dynamic.at(BATTERY_CONF_ID).write_value.uint16_value;
-			} else {
-				new_battery_conf_id = G3_dynamic.at(BATTERY_CONF_ID).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration ID: %d", new_battery_conf_id);
-			data.push_back(static_cast<uint8_t>(new_battery_conf_id >> 8));
-			data.push_back(static_cast<uint8_t>(new_battery_conf_id & 0xFF));
-			uint16_t new_battery_conf_address;
-			if (G3_dynamic.at(BATTERY_CONF_ADDRESS).enforce_default_value && G3_dynamic.at(BATTERY_CONF_ADDRESS).default_value_set) {
-				new_battery_conf_address = G3_dynamic.at(BATTERY_CONF_ADDRESS).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_ADDRESS).write_set_value) {
-				new_battery_conf_address = G3_dynamic.at(BATTERY_CONF_ADDRESS).write_value.uint16_value;
-			} else {
-				new_battery_conf_address = G3_dynamic.at(BATTERY_CONF_ADDRESS).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration address: %d", new_battery_conf_address);
-			data.push_back(static_cast<uint8_t>(new_battery_conf_address >> 8));
-			data.push_back(static_cast<uint8_t>(new_battery_conf_address & 0xFF));
-			uint16_t new_battery_conf_protocol;
-			if (G3_dynamic.at(BATTERY_CONF_PROTOCOL).enforce_default_value && G3_dynamic.at(BATTERY_CONF_PROTOCOL).default_value_set) {
-				new_battery_conf_protocol = G3_dynamic.at(BATTERY_CONF_PROTOCOL).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_PROTOCOL).write_set_value) {
-				new_battery_conf_protocol = G3_dynamic.at(BATTERY_CONF_PROTOCOL).write_value.uint16_value;
-			} else {
-				new_battery_conf_protocol = G3_dynamic.at(BATTERY_CONF_PROTOCOL).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration protocol: %d", new_battery_conf_protocol);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_protocol >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_protocol & 0xFF));
-			uint16_t new_battery_conf_voltage_over;
-			if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).enforce_default_value && G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).default_value_set) {
-				new_battery_conf_voltage_over = G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).write_set_value) {
-				new_battery_conf_voltage_over = G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).write_value.uint16_value;
-			} else {
-				new_battery_conf_voltage_over = G3_dynamic.at(BATTERY_CONF_VOLTAGE_OVER).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration voltage over: %d", new_battery_conf_voltage_over);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_over >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_over & 0xFF));
-			uint16_t new_battery_conf_voltage_charge;
-			if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).enforce_default_value && G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).default_value_set) {
-				new_battery_conf_voltage_charge = G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).write_set_value) {
-				new_battery_conf_voltage_charge = G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).write_value.uint16_value;
-			} else {
-				new_battery_conf_voltage_charge = G3_dynamic.at(BATTERY_CONF_VOLTAGE_CHARGE).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration voltage charge: %d", new_battery_conf_voltage_charge);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_charge >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_charge & 0xFF));
-			uint16_t new_battery_conf_voltage_lack;
-			if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).enforce_default_value && G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).default_value_set) {
-				new_battery_conf_voltage_lack = G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).write_set_value) {
-				new_battery_conf_voltage_lack = G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).write_value.uint16_value;
-			} else {
-				new_battery_conf_voltage_lack = G3_dynamic.at(BATTERY_CONF_VOLTAGE_LACK).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration voltage lack: %d", new_battery_conf_voltage_lack);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_lack >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_lack & 0xFF));
-			uint16_t new_battery_conf_voltage_discharge_stop;
-			if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).enforce_default_value && G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).default_value_set) {
-				new_battery_conf_voltage_discharge_stop = G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).write_set_value) {
-				new_battery_conf_voltage_discharge_stop = G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).write_value.uint16_value;
-			} else {
-				new_battery_conf_voltage_discharge_stop = G3_dynamic.at(BATTERY_CONF_VOLTAGE_DISCHARGE_STOP).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration voltage discharge stop: %d", new_battery_conf_voltage_discharge_stop);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_discharge_stop >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_discharge_stop & 0xFF));
-			uint16_t new_battery_conf_current_charge_limit;
-			if (G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).enforce_default_value && G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).default_value_set) {
-				new_battery_conf_current_charge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).write_set_value) {
-				new_battery_conf_current_charge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).write_value.uint16_value;
-			} else {
-				new_battery_conf_current_charge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_CHARGE_LIMIT).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration current charge limit: %d", new_battery_conf_current_charge_limit);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_current_charge_limit >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_current_charge_limit & 0xFF));
-			uint16_t new_battery_conf_current_discharge_limit;
-			if (G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).enforce_default_value && G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).default_value_set) {
-				new_battery_conf_current_discharge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).write_set_value) {
-				new_battery_conf_current_discharge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).write_value.uint16_value;
-			} else {
-				new_battery_conf_current_discharge_limit = G3_dynamic.at(BATTERY_CONF_CURRENT_DISCHARGE_LIMIT).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration current charge limit: %d", new_battery_conf_current_charge_limit);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_current_discharge_limit >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_current_discharge_limit & 0xFF));
-			uint16_t new_battery_conf_depth_of_discharge;
-			if (G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).enforce_default_value && G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).default_value_set) {
-				new_battery_conf_depth_of_discharge = G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).write_set_value) {
-				new_battery_conf_depth_of_discharge = G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).write_value.uint16_value;
-			} else {
-				new_battery_conf_depth_of_discharge = G3_dynamic.at(BATTERY_CONF_DEPTH_OF_DISCHARGE).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration depth of discharge: %d", new_battery_conf_depth_of_discharge);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_depth_of_discharge >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_depth_of_discharge & 0xFF));
-			uint16_t new_battery_conf_end_of_discharge;
-			if (G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).enforce_default_value && G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).default_value_set) {
-				new_battery_conf_end_of_discharge = G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).write_set_value) {
-				new_battery_conf_end_of_discharge = G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).write_value.uint16_value;
-			} else {
-				new_battery_conf_end_of_discharge = G3_dynamic.at(BATTERY_CONF_END_OF_DISCHARGE).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration end of discharge: %d", new_battery_conf_end_of_discharge);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_end_of_discharge >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_end_of_discharge & 0xFF));
-			uint16_t new_battery_conf_capacity;
-			if (G3_dynamic.at(BATTERY_CONF_CAPACITY).enforce_default_value && G3_dynamic.at(BATTERY_CONF_CAPACITY).default_value_set) {
-				new_battery_conf_capacity = G3_dynamic.at(BATTERY_CONF_CAPACITY).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_CAPACITY).write_set_value) {
-				new_battery_conf_capacity = G3_dynamic.at(BATTERY_CONF_CAPACITY).write_value.uint16_value;
-			} else {
-				new_battery_conf_capacity = G3_dynamic.at(BATTERY_CONF_CAPACITY).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration capacity: %d", new_battery_conf_capacity);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_capacity >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_capacity & 0xFF));
-			uint16_t new_battery_conf_voltage_nominal;
-			if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).enforce_default_value && G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).default_value_set) {
-				new_battery_conf_voltage_nominal = G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).write_set_value) {
-				new_battery_conf_voltage_nominal = G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).write_value.uint16_value;
-			} else {
-				new_battery_conf_voltage_nominal = G3_dynamic.at(BATTERY_CONF_VOLTAGE_NOMINAL).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration voltage nominal: %d", new_battery_conf_voltage_nominal);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_nominal >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_voltage_nominal & 0xFF));
-			uint16_t new_battery_conf_cell_type;
-			if (G3_dynamic.at(BATTERY_CONF_CELL_TYPE).enforce_default_value && G3_dynamic.at(BATTERY_CONF_CELL_TYPE).default_value_set) {
-				new_battery_conf_cell_type = G3_dynamic.at(BATTERY_CONF_CELL_TYPE).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_CELL_TYPE).write_set_value) {
-				new_battery_conf_cell_type = G3_dynamic.at(BATTERY_CONF_CELL_TYPE).write_value.uint16_value;
-			} else {
-				new_battery_conf_cell_type = G3_dynamic.at(BATTERY_CONF_CELL_TYPE).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration cell type: %d", new_battery_conf_cell_type);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_cell_type >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_cell_type & 0xFF));
-			uint16_t new_battery_conf_eps_buffer;
-			if (G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).enforce_default_value && G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).default_value_set) {
-				new_battery_conf_eps_buffer = G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).write_set_value) {
-				new_battery_conf_eps_buffer = G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).write_value.uint16_value;
-			} else {
-				new_battery_conf_eps_buffer = G3_dynamic.at(BATTERY_CONF_EPS_BUFFER).sensor->state;
-			}
-			ESP_LOGV(TAG, "Writing battery configuration EPS buffer: %d", new_battery_conf_eps_buffer);
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_eps_buffer >> 8));
-			//data.push_back(static_cast<uint8_t>(new_battery_conf_eps_buffer & 0xFF));
-			//data.push_back(static_cast<uint8_t>(0x01 >> 8));
-			//data.push_back(static_cast<uint8_t>(0x01 & 0xFF)); // Write the battery configuration
-			register_write_task task;
-			task.first_register_key = BATTERY_CONF_ID; // Set the register key for the write task
-			task.number_of_registers = (data.size() >> 1); // Set the number of registers to write
-			task.data = data; // Set the data to write
-			register_write_queue.push(task); // Add the write task to the queue
+			this->queue_group_write(BATTERY_CONF_ID, nullptr, false, force);
 		}
 
-		void SofarSolar_Inverter::write_battery_active() {
-			// Write the battery active state
+		void SofarSolar_Inverter::write_battery_active(SofarSolar_TransactionRef transaction) {
 			ESP_LOGD(TAG, "Writing battery active state");
-			std::vector<uint8_t> data;
-			uint16_t new_battery_active_control;
-			if (G3_dynamic.at(BATTERY_ACTIVE_CONTROL).enforce_default_value && G3_dynamic.at(BATTERY_ACTIVE_CONTROL).default_value_set) {
-				new_battery_active_control = G3_dynamic.at(BATTERY_ACTIVE_CONTROL).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_set_value) {
-				new_battery_active_control = G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_value.uint16_value;
-			} else {
-				new_battery_active_control = G3_dynamic.at(BATTERY_ACTIVE_CONTROL).sensor->state;
-			}
-			data.push_back(static_cast<uint8_t>(new_battery_active_control >> 8));
-			data.push_back(static_cast<uint8_t>(new_battery_active_control & 0xFF));
-			ESP_LOGV(TAG, "Writing battery active control: %d", new_battery_active_control);
-			uint16_t new_battery_active_oneshot;
-			if (G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).enforce_default_value && G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).default_value_set) {
-				new_battery_active_oneshot = G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).default_value.uint16_value;
-			} else if (G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_set_value) {
-				new_battery_active_oneshot = G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_value.uint16_value;
-			} else {
-				new_battery_active_oneshot = G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).sensor->state;
-			}
-			data.push_back(static_cast<uint8_t>(new_battery_active_oneshot >> 8));
-			data.push_back(static_cast<uint8_t>(new_battery_active_oneshot & 0xFF));
-			ESP_LOGV(TAG, "Writing battery active oneshot: %d", new_battery_active_oneshot);
-			register_write_task task;
-			task.first_register_key = BATTERY_ACTIVE_CONTROL; // Set the register key for the write task
-			task.number_of_registers = (data.size() >> 1); // Set the number of registers to write
-			task.data = data; // Set the data to write
-			register_write_queue.push(task); // Add the write task to the queue
+			this->queue_group_write(BATTERY_ACTIVE_CONTROL, transaction);
 		}
 
 		void SofarSolar_Inverter::write_power() {
 			ESP_LOGD(TAG, "Writing Power Percentage");
-			ESP_LOGV(TAG, "Power Control");
-			std::vector<uint8_t> data;
-			uint16_t new_power_control;
-			if (G3_dynamic.at(POWER_CONTROL).enforce_default_value && G3_dynamic.at(POWER_CONTROL).default_value_set) {
-				new_power_control = G3_dynamic.at(POWER_CONTROL).default_value.uint16_value;
-			} else if (G3_dynamic.at(POWER_CONTROL).write_set_value) {
-				new_power_control = G3_dynamic.at(POWER_CONTROL).write_value.uint16_value;
-			} else {
-				new_power_control = G3_dynamic.at(POWER_CONTROL).sensor->state;
-			}
-			data.push_back(static_cast<uint8_t>(new_power_control >> 8));
-			data.push_back(static_cast<uint8_t>(new_power_control & 0xFF));
+			this->queue_group_write(POWER_CONTROL);
+		}
 
-			ESP_LOGV(TAG, "Active Power Export Limit");
-			uint16_t new_active_power_export_limit;
-			if (G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).enforce_default_value && G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).default_value_set) {
-				new_active_power_export_limit = G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).default_value.uint16_value;
-			} else if (G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).write_set_value) {
-				new_active_power_export_limit = G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).write_value.uint16_value;
-			} else {
-				new_active_power_export_limit = G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).sensor->state;
+		void SofarSolar_Inverter::set_number_value(number::Number *number_var, float value) {
+			auto it = std::find_if(G3_dynamic.begin(), G3_dynamic.end(), [number_var](const std::pair<const uint8_t, SofarSolar_RegisterDynamic> &dynamic_register) { return dynamic_register.second.number == number_var; });
+			if (it == G3_dynamic.end()) {
+				ESP_LOGE(TAG, "Number %s is not assigned to a register", number_var->get_name().c_str());
+				return;
 			}
-			data.push_back(static_cast<uint8_t>(new_active_power_export_limit >> 8));
-			data.push_back(static_cast<uint8_t>(new_active_power_export_limit & 0xFF));
-
-			ESP_LOGV(TAG, "Active Power Import Limit");
-			uint16_t new_active_power_import_limit;
-			if (G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).enforce_default_value && G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).default_value_set) {
-				new_active_power_import_limit = G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).default_value.uint16_value;
-			} else if (G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).write_set_value) {
-				new_active_power_import_limit = G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).write_value.uint16_value;
-			} else {
-				new_active_power_import_limit = G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).sensor->state;
+			const SofarSolar_Register &reg = G3_registers.at(it->first);
+			int64_t raw = llroundf(value / get_power_of_ten(reg.scale));
+			SofarSolar_RegisterValue &pending = this->pending_write(it->first);
+			switch (reg.type) {
+				case S_WORD: pending.int16_value = raw; break;
+				case U_DWORD: pending.uint32_value = raw; break;
+				case S_DWORD: pending.int32_value = raw; break;
+				default: pending.uint16_value = raw; break;
 			}
-			data.push_back(static_cast<uint8_t>(new_active_power_import_limit >> 8));
-			data.push_back(static_cast<uint8_t>(new_active_power_import_limit & 0xFF));
-
-			ESP_LOGV(TAG, "Reactive Power Setting");
-			uint16_t new_reactive_power_setting;
-			if (G3_dynamic.at(REACTIVE_POWER_SETTING).enforce_default_value && G3_dynamic.at(REACTIVE_POWER_SETTING).default_value_set) {
-				new_reactive_power_setting = G3_dynamic.at(REACTIVE_POWER_SETTING).default_value.int16_value;
-			} else if (G3_dynamic.at(REACTIVE_POWER_SETTING).write_set_value) {
-				new_reactive_power_setting = G3_dynamic.at(REACTIVE_POWER_SETTING).write_value.int16_value;
+			// Only the latest value of each register is kept, one write per group once the changes settle
+			uint8_t group_key = write_group_of(it->first);
+			uint32_t now = millis();
+			auto debounced = this->debounced_writes_.find(group_key);
+			if (debounced == this->debounced_writes_.end()) {
+				this->debounced_writes_[group_key] = SofarSolar_DebouncedWrite{now, now};
 			} else {
-				new_reactive_power_setting = G3_dynamic.at(REACTIVE_POWER_SETTING).sensor->state;
+				debounced->second.last_change = now;
 			}
-			data.push_back(static_cast<uint8_t>(new_reactive_power_setting >> 8));
-			data.push_back(static_cast<uint8_t>(new_reactive_power_setting & 0xFF));
+			ESP_LOGV(TAG, "Register %d set to %lld, write of group %d pending", it->first, raw, group_key);
+		}
 
-			ESP_LOGV(TAG, "Power Factor Setting");
-			uint16_t new_pwoer_factor_setting;
-			if (G3_dynamic.at(POWER_FACTOR_SETTING).enforce_default_value && G3_dynamic.at(POWER_FACTOR_SETTING).default_value_set) {
-				new_pwoer_factor_setting = G3_dynamic.at(POWER_FACTOR_SETTING).default_value.int16_value;
-			} else if (G3_dynamic.at(POWER_FACTOR_SETTING).write_set_value) {
-				new_pwoer_factor_setting = G3_dynamic.at(POWER_FACTOR_SETTING).write_value.int16_value;
-			} else {
-				new_pwoer_factor_setting = G3_dynamic.at(POWER_FACTOR_SETTING).sensor->state;
+		void SofarSolar_Inverter::flush_debounced_writes() {
+			uint32_t now = millis();
+			for (auto it = this->debounced_writes_.begin(); it != this->debounced_writes_.end();) {
+				if (now - it->second.last_change >= this->write_debounce_ || now - it->second.first_change >= this->write_max_delay_) {
+					ESP_LOGD(TAG, "Writing group %d after %u ms of changes", it->first, now - it->second.first_change);
+					this->queue_group_write(it->first);
+					it = this->debounced_writes_.erase(it);
+				} else {
+					++it;
+				}
 			}
-			data.push_back(static_cast<uint8_t>(new_pwoer_factor_setting >> 8));
-			data.push_back(static_cast<uint8_t>(new_pwoer_factor_setting & 0xFF));
+		}
 
-			ESP_LOGV(TAG, "Active Power Limit Speed");
-			uint16_t new_active_power_limit_speed;
-			if (G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).enforce_default_value && G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).default_value_set) {
-				new_active_power_limit_speed = G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).default_value.uint16_value;
-			} else if (G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).write_set_value) {
-				new_active_power_limit_speed = G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).write_value.uint16_value;
-			} else {
-				new_active_power_limit_speed = G3_dynamic.at(ACTIVE_POWER_LIMIT_SPEED).sensor->state;
+		bool SofarSolar_Inverter::has_write_value(uint8_t register_key) const {
+			auto dynamic_register = G3_dynamic.find(register_key);
+			if (dynamic_register != G3_dynamic.end() && dynamic_register->second.enforce_default_value && dynamic_register->second.default_value_set) {
+				return true;
 			}
-			data.push_back(static_cast<uint8_t>(new_active_power_limit_speed >> 8));
-			data.push_back(static_cast<uint8_t>(new_active_power_limit_speed & 0xFF));
+			return this->pending_writes_.find(register_key) != this->pending_writes_.end();
+		}
 
-			ESP_LOGV(TAG, "Reactive Power Response Time");
-			uint16_t new_reactive_power_response_time;
-			if (G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).enforce_default_value && G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).default_value_set) {
-				new_reactive_power_response_time = G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).default_value.uint16_value;
-			} else if (G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).write_set_value) {
-				new_reactive_power_response_time = G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).write_value.uint16_value;
-			} else {
-				new_reactive_power_response_time = G3_dynamic.at(REACTIVE_POWER_RESPONSE_TIME).sensor->state;
+		bool SofarSolar_Inverter::has_register_value(uint8_t register_key) const {
+			auto dynamic_register = G3_dynamic.find(register_key);
+			return dynamic_register != G3_dynamic.end() && !std::isnan(dynamic_register->second.last_value);
+		}
+
+		float SofarSolar_Inverter::register_value(uint8_t register_key) const {
+			auto dynamic_register = G3_dynamic.find(register_key);
+			return dynamic_register != G3_dynamic.end() ? dynamic_register->second.last_value : NAN;
+		}
+
+		void SofarSolar_Inverter::queue_group_write(uint8_t group_key, SofarSolar_TransactionRef transaction, bool fetch_current, bool force) {
+			if (force) {
+				this->write_groups_forced_.insert(group_key); // Also applies if the values are merged into a fetching write
+			}
+			if (transaction != nullptr) {
+				this->group_transactions_[group_key].push_back(transaction); // Completed by the next write of the group
+			}
+			if (this->write_groups_fetching_.count(group_key) > 0) {
+				ESP_LOGV(TAG, "Write group %d is already fetching, the new values are merged into that write", group_key);
+				return;
 			}
-			data.push_back(static_cast<uint8_t>(new_reactive_power_response_time >> 8));
-			data.push_back(static_cast<uint8_t>(new_reactive_power_response_time & 0xFF));
+			const std::vector<uint8_t> &keys = G3_write_groups.at(group_key);
+			if ((!fetch_current || this->write_cache_.get(group_key, millis()) != nullptr) && std::all_of(keys.begin(), keys.end(), [this](uint8_t key) { return this->has_write_value(key); })) {
+				this->write_group(group_key, FrameView()); // Every register is written, nothing to fetch, the last write tells what the inverter holds
+				return;
+			}
+			// Fetch the current values of the whole group in one read, the registers not written keep them
+			const SofarSolar_Register &first = G3_registers.at(keys.front());
+			const SofarSolar_Register &last = G3_registers.at(keys.back());
+			register_read_task task(group_key);
+			task.register_count = last.start_address + last.register_count - first.start_address;
+			task.write_group = true;
+			this->write_groups_fetching_.insert(group_key);
+			this->queue_read(task);
+			ESP_LOGV(TAG, "Fetching %d registers at %04X before writing group %d", task.register_count, task.start_address, group_key);
+		}
 
-			register_write_task task;
-			task.first_register_key = POWER_CONTROL; // Set the register key for the write task
+		void SofarSolar_Inverter::write_group(uint8_t group_key, const FrameView &current) {
+			const std::vector<uint8_t> &keys = G3_write_groups.at(group_key);
+			const uint16_t group_start = G3_registers.at(keys.front()).start_address;
+			std::vector<uint8_t> data;
+			for (uint8_t key : keys) {
+				const SofarSolar_Register &reg = G3_registers.at(key);
+				auto dynamic_register = G3_dynamic.find(key);
+				auto pending = this->pending_writes_.find(key);
+				SofarSolar_RegisterValue value{};
+				if (dynamic_register != G3_dynamic.end() && dynamic_register->second.enforce_default_value && dynamic_register->second.default_value_set) {
+					value = dynamic_register->second.default_value;
+				} else if (pending != this->pending_writes_.end()) {
+					value = pending->second;
+				} else {
+					size_t offset = (reg.start_address - group_start) * 2;
+					if (!current.contains(offset, reg.register_count * 2)) {
+						ESP_LOGE(TAG, "Current value of register %d missing, dropping the write of group %d", key, group_key);
+						this->fail_group_transactions(group_key, REQUEST_INVALID);
+						return;
+					}
+					data.insert(data.end(), current.data() + offset, current.data() + offset + reg.register_count * 2);
+					ESP_LOGV(TAG, "Keeping the current value of register %d", key);
+					continue;
+				}
+				if (reg.register_count == 2) {
+					data.push_back(static_cast<uint8_t>(value.uint32_value >> 24));
+					data.push_back(static_cast<uint8_t>(value.uint32_value >> 16));
+					data.push_back(static_cast<uint8_t>(value.uint32_value >> 8));
+					data.push_back(static_cast<uint8_t>(value.uint32_value & 0xFF));
+					ESP_LOGV(TAG, "Writing register %d: %d", key, value.int32_value);
+				} else {
+					data.push_back(static_cast<uint8_t>(value.uint16_value >> 8));
+					data.push_back(static_cast<uint8_t>(value.uint16_value & 0xFF));
+					ESP_LOGV(TAG, "Writing register %d: %d", key, value.uint16_value);
+				}
+			}
+			for (uint8_t key : keys) {
+				this->pending_writes_.erase(key); // Later writes of the group start from the inverter values again
+			}
+			auto waiting = this->group_transactions_.find(group_key);
+			std::vector<SofarSolar_TransactionRef> transactions;
+			if (waiting != this->group_transactions_.end()) {
+				transactions.swap(waiting->second);
+				this->group_transactions_.erase(waiting);
+			}
+			// Compare against the fetched values, without them against the last write, so repeated control writes do not wear the
+			// EEPROM. Writes somebody waits for, forced writes and commands always go out.
+			bool forced = !transactions.empty() || this->write_groups_forced_.erase(group_key) > 0;
+			if (this->write_cache_.can_skip(group_key, data, current, forced, millis())) {
+				ESP_LOGV(TAG, "Group %d already holds the values, skipping the write", group_key);
+				for (auto &transaction : transactions) {
+					transaction->complete(FrameView(), millis()); // The inverter holds the requested values
+				}
+				return;
+			}
+			register_write_task task(group_key);
+			auto feedback = G3_write_feedback.find(group_key);
+			if (feedback != G3_write_feedback.end() && this->combined_write_read_ && this->combined_write_state_ == COMBINED_SUPPORTED &&
+					(this->zero_export_ || this->site_controlled_ || G3_dynamic.count(feedback->second) > 0)) {
+				const SofarSolar_Register &reg = G3_registers.at(feedback->second);
+				task.read_register_key = feedback->second;
+				task.read_start_address = reg.start_address;
+				task.read_register_count = reg.register_count;
+			}
+			if (!transactions.empty()) {
+				// All callers waiting for the group learn the result of the one write
+				task.transaction = std::make_shared<SofarSolar_Transaction>([transactions](const SofarSolar_Transaction &write, const FrameView &frame) {
+					for (auto &transaction : transactions) {
+						if (write.succeeded()) {
+							transaction->complete(frame, write.get_finished());
+						} else {
+							transaction->fail(write.get_failure_reason(), write.get_finished());
+						}
+					}
+				});
+			}
 			task.number_of_registers = (data.size() >> 1); // Set the number of registers to write
-			ESP_LOGVV(TAG, "Number of registers to write: %d", task.number_of_registers);
 			task.data = data; // Set the data to write
-			ESP_LOGVV(TAG, "Data of registers to write: %d", task.data);
-			register_write_queue.push(task); // Add the write task to the queue
+			this->queue_write(task); // Add the write task to the queue
+		}
+
+		void SofarSolar_Inverter::fail_group_transactions(uint8_t group_key, uint8_t reason) {
+			this->write_groups_forced_.erase(group_key); // The write is dropped, a later one is not forced by it
+			auto waiting = this->group_transactions_.find(group_key);
+			if (waiting == this->group_transactions_.end()) {
+				return;
+			}
+			std::vector<SofarSolar_TransactionRef> transactions;
+			transactions.swap(waiting->second);
+			this->group_transactions_.erase(waiting);
+			for (auto &transaction : transactions) {
+				transaction->fail(reason, millis());
+			}
 		}
 
 		void SofarSolar_Inverter::write_single_register() {
@@ -703,16 +1835,35 @@ namespace esphome
 		}
 
 		void SofarSolar_Inverter::battery_activation() {
-			G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_value.uint16_value = 1;
-			G3_dynamic.at(BATTERY_ACTIVE_CONTROL).write_set_value = true;
-			G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_value.uint16_value = 1;
-			G3_dynamic.at(BATTERY_ACTIVE_ONESHOT).write_set_value = true;
-			time_begin_modbus_operation = millis();
-			this->write_battery_active(); // Write the battery active control register
+			this->pending_write(BATTERY_ACTIVE_CONTROL).uint16_value = 1;
+			this->pending_write(BATTERY_ACTIVE_ONESHOT).uint16_value = 1;
+#ifdef USE_ESP32
+			if (this->io_task_ == nullptr)
+#endif
+			this->poller_.restart_gap(); // The I/O task keeps the gap of its own poller
+			// Read the control register back as soon as the write is acknowledged
+			this->write_battery_active(std::make_shared<SofarSolar_Transaction>([this](const SofarSolar_Transaction &write, const FrameView &) {
+				if (!write.succeeded()) {
+					ESP_LOGW(TAG, "Battery activation failed: %s", request_failure_text(write.get_failure_reason()));
+					return;
+				}
+				register_read_task task(BATTERY_ACTIVE_CONTROL);
+				task.transaction = std::make_shared<SofarSolar_Transaction>([](const SofarSolar_Transaction &read, const FrameView &frame) {
+					uint16_t value;
+					if (!read.succeeded() || !frame.read_uint16(0, value)) {
+						ESP_LOGW(TAG, "Battery activation written, read-back failed");
+					} else if (value == 1) {
+						ESP_LOGI(TAG, "Battery activation confirmed after %u ms", read.get_finished() - read.get_sent());
+					} else {
+						ESP_LOGW(TAG, "Battery activation written, control register reads %d", value);
+					}
+				});
+				this->queue_read(task);
+			})); // Write the battery active control register
 		}
 
 		void SofarSolar_Inverter::battery_config_write() {
-			this->write_battery_conf(); // Write the battery configuration registers
+			this->write_battery_conf(true); // Pressing the button writes the configuration even if the inverter holds it
 		}
 
 		void SofarSolar_Inverter::set_model_id(std::string model) {
@@ -722,6 +1873,27 @@ namespace esphome
 			ESP_LOGV(TAG, "Inverter model ID set to: %d", this->model_id_);
 		}
 
+		void SofarSolar_Inverter::set_desired_grid_power_number(number::Number *desired_grid_power_number) { G3_dynamic.insert({DESIRED_GRID_POWER, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(DESIRED_GRID_POWER).number = desired_grid_power_number; }
+		void SofarSolar_Inverter::set_minimum_battery_power_number(number::Number *minimum_battery_power_number) { G3_dynamic.insert({MINIMUM_BATTERY_POWER, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(MINIMUM_BATTERY_POWER).number = minimum_battery_power_number; }
+		void SofarSolar_Inverter::set_maximum_battery_power_number(number::Number *maximum_battery_power_number) { G3_dynamic.insert({MAXIMUM_BATTERY_POWER, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(MAXIMUM_BATTERY_POWER).number = maximum_battery_power_number; }
+		void SofarSolar_Inverter::set_active_power_export_limit_number(number::Number *active_power_export_limit_number) { G3_dynamic.insert({ACTIVE_POWER_EXPORT_LIMIT, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).number = active_power_export_limit_number; }
+		void SofarSolar_Inverter::set_active_power_import_limit_number(number::Number *active_power_import_limit_number) { G3_dynamic.insert({ACTIVE_POWER_IMPORT_LIMIT, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).number = active_power_import_limit_number; }
+		void SofarSolar_Inverter::set_battery_conf_id_number(number::Number *battery_conf_id_number) { G3_dynamic.insert({BATTERY_CONF_ID, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(BATTERY_CONF_ID).number = battery_conf_id_number; }
+		void SofarSolar_Inverter::set_battery_conf_address_number(number::Number *battery_conf_address_number) { G3_dynamic.insert({BATTERY_CONF_ADDRESS, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(BATTERY_CONF_ADDRESS).number = battery_conf_address_number; }
+		void SofarSolar_Inverter::set_desired_grid_power_number_update_interval(uint16_t desired_grid_power_number_update_interval) { G3_dynamic.at(DESIRED_GRID_POWER).update_interval = desired_grid_power_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_minimum_battery_power_number_update_interval(uint16_t minimum_battery_power_number_update_interval) { G3_dynamic.at(MINIMUM_BATTERY_POWER).update_interval = minimum_battery_power_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_maximum_battery_power_number_update_interval(uint16_t maximum_battery_power_number_update_interval) { G3_dynamic.at(MAXIMUM_BATTERY_POWER).update_interval = maximum_battery_power_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_active_power_export_limit_number_update_interval(uint16_t active_power_export_limit_number_update_interval) { G3_dynamic.at(ACTIVE_POWER_EXPORT_LIMIT).update_interval = active_power_export_limit_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_active_power_import_limit_number_update_interval(uint16_t active_power_import_limit_number_update_interval) { G3_dynamic.at(ACTIVE_POWER_IMPORT_LIMIT).update_interval = active_power_import_limit_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_battery_conf_id_number_update_interval(uint16_t battery_conf_id_number_update_interval) { G3_dynamic.at(BATTERY_CONF_ID).update_interval = battery_conf_id_number_update_interval * 1000; }
+		void SofarSolar_Inverter::set_battery_conf_address_number_update_interval(uint16_t battery_conf_address_number_update_interval) { G3_dynamic.at(BATTERY_CONF_ADDRESS).update_interval = battery_conf_address_number_update_interval * 1000; }
+
+		void SofarSolar_Inverter::set_operational_status(text_sensor::TextSensor *operational_status_text_sensor) { G3_dynamic.insert({OPERATIONAL_STATUS, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(OPERATIONAL_STATUS).text_sensor = operational_status_text_sensor; }
+		void SofarSolar_Inverter::set_serial_number(text_sensor::TextSensor *serial_number_text_sensor) { G3_dynamic.insert({SERIAL_NUMBER, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(SERIAL_NUMBER).text_sensor = serial_number_text_sensor; G3_dynamic.at(SERIAL_NUMBER).read_once = true; G3_dynamic.at(SERIAL_NUMBER).update_interval = 60000; }
+		void SofarSolar_Inverter::set_hardware_version(text_sensor::TextSensor *hardware_version_text_sensor) { G3_dynamic.insert({HARDWARE_VERSION, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(HARDWARE_VERSION).text_sensor = hardware_version_text_sensor; G3_dynamic.at(HARDWARE_VERSION).read_once = true; G3_dynamic.at(HARDWARE_VERSION).update_interval = 60000; }
+		void SofarSolar_Inverter::set_firmware_version(text_sensor::TextSensor *firmware_version_text_sensor) { G3_dynamic.insert({FIRMWARE_VERSION, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(FIRMWARE_VERSION).text_sensor = firmware_version_text_sensor; G3_dynamic.at(FIRMWARE_VERSION).read_once = true; G3_dynamic.at(FIRMWARE_VERSION).update_interval = 60000; }
+		void SofarSolar_Inverter::set_operational_status_update_interval(uint16_t operational_status_update_interval) { G3_dynamic.at(OPERATIONAL_STATUS).update_interval = operational_status_update_interval * 1000; }
+
 		void SofarSolar_Inverter::set_pv_generation_today_sensor(sensor::Sensor *pv_generation_today_sensor) { G3_dynamic.insert({PV_GENERATION_TODAY, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(PV_GENERATION_TODAY).sensor = pv_generation_today_sensor; }
 		void SofarSolar_Inverter::set_pv_generation_total_sensor(sensor::Sensor *pv_generation_total_sensor) { G3_dynamic.insert({PV_GENERATION_TOTAL, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(PV_GENERATION_TOTAL).sensor = pv_generation_total_sensor; }
 		void SofarSolar_Inverter::set_load_consumption_today_sensor(sensor::Sensor *load_consumption_today_sensor) { G3_dynamic.insert({LOAD_CONSUMPTION_TODAY, SofarSolar_RegisterDynamic{}}); G3_dynamic.at(LOAD_CONSUMPTION_TODAY).sensor = load_consumption_today_sensor; }
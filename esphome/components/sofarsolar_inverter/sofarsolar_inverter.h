@@ -2,159 +2,65 @@
 #include "queue"
 #include "vector"
 #include "map"
+#include "set"
+#include "cmath"
+#include "algorithm"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/switch/switch.h"
 #include "esphome/components/button/button.h"
 #include "esphome/components/text_sensor/text_sensor.h"
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#include "esphome/components/number/number.h"
+#ifdef USE_SOFARSOLAR_MODBUS
 #include "esphome/components/modbus/modbus.h"
+#include "esphome/components/uart/uart.h"
+#endif
 #include "esphome/core/component.h"
-
-#define PV_GENERATION_TODAY 1
-#define PV_GENERATION_TOTAL 2
-#define LOAD_CONSUMPTION_TODAY 3
-#define LOAD_CONSUMPTION_TOTAL 4
-#define BATTERY_CHARGE_TODAY 5
-#define BATTERY_CHARGE_TOTAL 6
-#define BATTERY_DISCHARGE_TODAY 7
-#define BATTERY_DISCHARGE_TOTAL 8
-#define TOTAL_ACTIVE_POWER_INVERTER 9
-#define PV_VOLTAGE_1 10
-#define PV_CURRENT_1 11
-#define PV_POWER_1 12
-#define PV_VOLTAGE_2 13
-#define PV_CURRENT_2 14
-#define PV_POWER_2 15
-#define PV_POWER_TOTAL 16
-
-#define BATTERY_VOLTAGE_1 17
-#define BATTERY_CURRENT_1 18
-#define BATTERY_POWER_1 19
-#define BATTERY_TEMPERATUR_ENV_1 20
-#define BATTERY_STATE_OF_CHARGE_1 21
-#define BATTERY_STATE_OF_HEALTH_1 22
-#define BATTERY_CHARGE_CYCLE_1 23
-
-#define BATTERY_VOLTAGE_2 24
-#define BATTERY_CURRENT_2 25
-#define BATTERY_POWER_2 26
-#define BATTERY_TEMPERATUR_ENV_2 27
-#define BATTERY_STATE_OF_CHARGE_2 28
-#define BATTERY_STATE_OF_HEALTH_2 29
-#define BATTERY_CHARGE_CYCLE_2 30
-
-#define BATTERY_VOLTAGE_3 31
-#define BATTERY_CURRENT_3 32
-#define BATTERY_POWER_3 33
-#define BATTERY_TEMPERATUR_ENV_3 34
-#define BATTERY_STATE_OF_CHARGE_3 35
-#define BATTERY_STATE_OF_HEALTH_3 36
-#define BATTERY_CHARGE_CYCLE_3 37
-
-#define BATTERY_VOLTAGE_4 38
-#define BATTERY_CURRENT_4 39
-#define BATTERY_POWER_4 40
-#define BATTERY_TEMPERATUR_ENV_4 41
-#define BATTERY_STATE_OF_CHARGE_4 42
-#define BATTERY_STATE_OF_HEALTH_4 43
-#define BATTERY_CHARGE_CYCLE_4 44
-
-#define BATTERY_VOLTAGE_5 45
-#define BATTERY_CURRENT_5 46
-#define BATTERY_POWER_5 47
-#define BATTERY_TEMPERATUR_ENV_5 48
-#define BATTERY_STATE_OF_CHARGE_5 49
-#define BATTERY_STATE_OF_HEALTH_5 50
-#define BATTERY_CHARGE_CYCLE_5 51
-
-#define BATTERY_VOLTAGE_6 52
-#define BATTERY_CURRENT_6 53
-#define BATTERY_POWER_6 54
-#define BATTERY_TEMPERATUR_ENV_6 55
-#define BATTERY_STATE_OF_CHARGE_6 56
-#define BATTERY_STATE_OF_HEALTH_6 57
-#define BATTERY_CHARGE_CYCLE_6 58
-
-#define BATTERY_VOLTAGE_7 59
-#define BATTERY_CURRENT_7 60
-#define BATTERY_POWER_7 61
-#define BATTERY_TEMPERATUR_ENV_7 62
-#define BATTERY_STATE_OF_CHARGE_7 63
-#define BATTERY_STATE_OF_HEALTH_7 64
-#define BATTERY_CHARGE_CYCLE_7 65
-
-#define BATTERY_VOLTAGE_8 66
-#define BATTERY_CURRENT_8 67
-#define BATTERY_POWER_8 68
-#define BATTERY_TEMPERATUR_ENV_8 69
-#define BATTERY_STATE_OF_CHARGE_8 70
-#define BATTERY_STATE_OF_HEALTH_8 71
-#define BATTERY_CHARGE_CYCLE_8 72
-
-#define BATTERY_POWER_TOTAL 117
-#define BATTERY_STATE_OF_CHARGE_TOTAL 118
-#define DESIRED_GRID_POWER 119
-#define MINIMUM_BATTERY_POWER 120
-#define MAXIMUM_BATTERY_POWER 121
-#define ENERGY_STORAGE_MODE 122
-#define BATTERY_CONF_ID 123
-#define BATTERY_CONF_ADDRESS 124
-#define BATTERY_CONF_PROTOCOL 125
-#define BATTERY_CONF_VOLTAGE_NOMINAL 126
-#define BATTERY_CONF_VOLTAGE_OVER 127
-#define BATTERY_CONF_VOLTAGE_CHARGE 128
-#define BATTERY_CONF_VOLTAGE_LACK 129
-#define BATTERY_CONF_VOLTAGE_DISCHARGE_STOP 130
-#define BATTERY_CONF_CURRENT_CHARGE_LIMIT 131
-#define BATTERY_CONF_CURRENT_DISCHARGE_LIMIT 132
-#define BATTERY_CONF_DEPTH_OF_DISCHARGE 133
-#define BATTERY_CONF_END_OF_DISCHARGE 134
-#define BATTERY_CONF_CAPACITY 135
-#define BATTERY_CONF_CELL_TYPE 136
-#define BATTERY_CONF_EPS_BUFFER 137
-#define BATTERY_CONF_CONTROL 138
-#define GRID_FREQUENCY 139
-#define GRID_VOLTAGE_PHASE_R 140
-#define GRID_CURRENT_PHASE_R 141
-#define GRID_POWER_PHASE_R 142
-#define GRID_VOLTAGE_PHASE_S 143
-#define GRID_CURRENT_PHASE_S 144
-#define GRID_POWER_PHASE_S 145
-#define GRID_VOLTAGE_PHASE_T 146
-#define GRID_CURRENT_PHASE_T 147
-#define GRID_POWER_PHASE_T 148
-#define OFF_GRID_POWER_TOTAL 149
-#define OFF_GRID_FREQUENCY 150
-#define OFF_GRID_VOLTAGE_PHASE_R 151
-#define OFF_GRID_CURRENT_PHASE_R 152
-#define OFF_GRID_POWER_PHASE_R 153
-#define OFF_GRID_VOLTAGE_PHASE_S 154
-#define OFF_GRID_CURRENT_PHASE_S 155
-#define OFF_GRID_POWER_PHASE_S 156
-#define OFF_GRID_VOLTAGE_PHASE_T 157
-#define OFF_GRID_CURRENT_PHASE_T 158
-#define OFF_GRID_POWER_PHASE_T 159
-#define BATTERY_ACTIVE_CONTROL 160
-#define BATTERY_ACTIVE_ONESHOT 161
-#define POWER_CONTROL 162
-#define ACTIVE_POWER_EXPORT_LIMIT 163
-#define ACTIVE_POWER_IMPORT_LIMIT 164
-#define REACTIVE_POWER_SETTING 165
-#define POWER_FACTOR_SETTING 166
-#define ACTIVE_POWER_LIMIT_SPEED 167
-#define REACTIVE_POWER_RESPONSE_TIME 168
-#define SVG_FIXED_REACTIVE_POWER_SETTING 169
-
-#define NONE 0
-#define SINGLE_REGISTER_WRITE 1
-#define DESIRED_GRID_POWER_WRITE 2
-#define BATTERY_CONF_WRITE 3
-#define BATTERY_ACTIVE_WRITE 4
-#define POWER_WRITE 4
-
-#define U_WORD 0x01
-#define U_DWORD 0x02
-#define S_WORD 0x03
-#define S_DWORD 0x04
+#include "esphome/core/automation.h"
+#include "sofarsolar_registers.h"
+#include "sofarsolar_poller.h"
+#include "sofarsolar_tcp.h"
+#include "sofarsolar_telemetry.h"
+#include "sofarsolar_zero_export.h"
+#include "sofarsolar_baud.h"
+#include "sofarsolar_write_cache.h"
+#include "sofarsolar_io_task.h"
+
+#define AGGREGATE_MEAN 0
+#define AGGREGATE_MIN 1
+#define AGGREGATE_MAX 2
+#define AGGREGATE_LAST 3
+
+#define RECORD_FRAME_SIZE 64
+
+#define PHASE_SCAN 0
+#define PHASE_CONTROL 1
+#define PHASE_DISPATCH 2
+#define PHASE_PARSE 3
+#define PHASE_PUBLISH 4
+#define PHASE_COUNT 5
+
+#define FRESHNESS_CLASSES 4
+#define FRESHNESS_BUCKETS 4
+
+#define COMBINED_UNKNOWN 0
+#define COMBINED_SUPPORTED 1
+#define COMBINED_UNSUPPORTED 2
+#define COMBINED_PROBING 3
+#define COMBINED_PROBE_ATTEMPTS 3 // Probes of function 0x17 without a valid answer after which the function is not used
+
+#define SCAN_FORMAT_HEX 0
+#define SCAN_FORMAT_JSON 1
+#define SCAN_MAX_REGISTERS 125 // Maximum number of registers of one read with function 0x03
+#define SCAN_LINE_REGISTERS 16 // Registers per line of the scan output
+#define SCAN_RETRIES 2 // Times a block is read again after a timeout or lost connection before it is skipped
+
+#define CAPTURE_CHANNEL_POWER_METER 0xFE // Channel of the power meter samples in a capture
+#define CAPTURE_CHANNEL_WRITE 0xFF // Channel of the acknowledged writes in a capture, the value is the start address
+
+#define POWER_SNAPSHOT_MAX_FAILURES 3 // Failed snapshots in a row after which the snapshot is dropped and the export limited to 0
+
+#define ADMISSION_PROTECTED_PRIORITY 3 // Registers of this priority keep their interval when the bus is oversubscribed
 
 #define HYD6000EP 1
 
@@ -172,18 +78,6 @@ namespace esphome {
             double double_value;
 		};
 
-    	struct SofarSolar_Register {
-    		uint16_t start_address; // Start address of the register
-    		uint16_t register_count; // Number of registers to read
-    		uint8_t type; // Type of the register (e.g., uint16, int16, etc.)
-    		uint8_t priority; // Priority of the register for reading
-    		int8_t scale; // Scale factor for the register value
-    		uint8_t write_function; // Function code for writing to the register
-    		SofarSolar_Register() : start_address(0), register_count(0), type(0), priority(0), scale(0), write_function(0) {}
-    		SofarSolar_Register(uint16_t start_address, uint16_t register_count, uint8_t type, uint8_t priority, int8_t scale, uint8_t write_function) :
-				start_address(start_address), register_count(register_count), type(type), priority(priority), scale(scale), write_function(write_function) {}
-    	};
-
 		struct Model_Parameters {
 			uint8_t phase_count; // Number of phases (1 or 3)
 			uint16_t max_output_power_w; // Maximum output power in watts
@@ -192,157 +86,169 @@ namespace esphome {
                 phase_count(phase_count), max_output_power_w(max_output_power_w) {}
 		};
 
+		struct SofarSolar_ReadBlock {
+			uint8_t first_register_key; // Key of the first register in the block
+			uint16_t start_address; // Start address of the block
+			uint16_t register_count; // Number of registers covered by the block
+			SofarSolar_ReadBlock() : first_register_key(0), start_address(0), register_count(0) {}
+			SofarSolar_ReadBlock(uint8_t first_register_key, uint16_t start_address, uint16_t register_count) :
+				first_register_key(first_register_key), start_address(start_address), register_count(register_count) {}
+		};
+
+		// Set of update intervals used while the value of one register stays within limits for some time
+		struct SofarSolar_PollingProfile {
+			std::string name;
+			uint8_t condition_register; // Key of the register the condition checks
+			float above; // Value the register has to exceed, NAN if not checked
+			float below; // Value the register has to stay under, NAN if not checked
+			uint32_t hold; // Time in milliseconds the condition has to hold before the profile is used
+			uint32_t condition_since = 0; // Time in milliseconds the condition is met since, 0 if it is not met
+			std::map<uint8_t, uint32_t> intervals; // Update intervals in milliseconds by register key, the others keep their configured one
+		};
+
+		struct SofarSolar_RegisterScan {
+			bool active = false;
+			bool outstanding = false; // Flag to indicate that a read of the scan is queued or in flight
+			uint8_t format = SCAN_FORMAT_HEX;
+			uint8_t resolution = 1; // Size of the smallest range split off after an illegal data address
+			uint32_t next_address = 0; // First address not read yet, apart from the split ranges
+			uint32_t end_address = 0; // Address after the last one to scan
+			std::vector<std::pair<uint16_t, uint16_t>> split; // Start and count of the ranges left to read after a split, the next one last
+			uint8_t retries = 0; // Retries of the current block
+			uint16_t skip_start = 0; // Start of the skipped range not reported yet
+			uint16_t skip_count = 0; // Number of registers in the skipped range not reported yet, 0 if there is none
+			const char *skip_reason = nullptr;
+			uint32_t started = 0; // Time in milliseconds the scan started
+			uint32_t requests = 0;
+			uint32_t registers_read = 0;
+			uint32_t registers_skipped = 0;
+		};
+
+		struct SofarSolar_CaptureSample {
+			uint32_t time; // Time in microseconds since the start of the capture the response was received
+			uint8_t channel; // Index of the register in the capture, or a CAPTURE_CHANNEL_* channel
+			float value;
+		};
+
+		struct SofarSolar_Capture {
+			bool active = false;
+			uint32_t started = 0; // Time in microseconds the capture started
+			uint32_t duration = 0; // Length of the capture in milliseconds
+			std::vector<uint8_t> registers; // Keys of the sampled registers, the index is the channel
+			std::vector<SofarSolar_CaptureSample> samples; // Preallocated at setup, never grows beyond its capacity
+			uint32_t failed = 0; // Reads of the capture that failed
+		};
+
+		struct SofarSolar_DebouncedWrite {
+			uint32_t first_change; // Time in milliseconds of the first change since the last write
+			uint32_t last_change; // Time in milliseconds of the latest change
+		};
+
+		struct SofarSolar_Aggregate {
+			uint32_t window; // Length of the aggregation window in milliseconds
+			uint32_t window_start; // Time in milliseconds of the first sample of the current window
+			uint8_t mode; // Aggregate published on the register sensor (mean, min, max or last)
+			float min; // Minimum of the samples in the current window
+			float max; // Maximum of the samples in the current window
+			float sum; // Sum of the samples in the current window
+			float last; // Last sample in the current window
+			uint16_t count; // Number of samples in the current window
+			sensor::Sensor *min_sensor; // Optional sensor for the window minimum
+			sensor::Sensor *max_sensor; // Optional sensor for the window maximum
+			SofarSolar_Aggregate() : window(0), window_start(0), mode(AGGREGATE_MEAN), min(NAN), max(NAN), sum(0), last(NAN), count(0), min_sensor(nullptr), max_sensor(nullptr) {}
+			void add(float value, uint32_t now) {
+				if (std::isnan(value)) {
+					return;
+				}
+				if (this->count == 0) {
+					this->window_start = now; // A window starts with its first sample, not at boot or at the previous publish
+				}
+				this->min = this->count == 0 ? value : std::min(this->min, value);
+				this->max = this->count == 0 ? value : std::max(this->max, value);
+				this->sum += value;
+				this->last = value;
+				this->count++;
+			}
+			float mean() const { return this->count > 0 ? this->sum / this->count : NAN; }
+			void reset() { this->min = NAN; this->max = NAN; this->sum = 0; this->last = NAN; this->count = 0; }
+		};
+
+		struct SofarSolar_PhaseStats {
+			uint32_t max = 0; // Longest run of the phase in microseconds
+			uint64_t total = 0; // Sum of all runs in microseconds
+			uint32_t count = 0; // Number of runs
+			sensor::Sensor *max_sensor = nullptr; // Diagnostic sensor for the longest run
+			sensor::Sensor *avg_sensor = nullptr; // Diagnostic sensor for the average run
+			void add(uint32_t duration) {
+				this->max = std::max(this->max, duration);
+				this->total += duration;
+				this->count++;
+			}
+			float avg() const { return this->count > 0 ? static_cast<float>(this->total) / this->count : 0.0f; }
+			void reset() { this->max = 0; this->total = 0; this->count = 0; }
+		};
+
+		struct SofarSolar_RecordedFrame {
+			uint32_t timestamp; // Time in milliseconds when the frame was sent or received
+			uint8_t direction; // Direction of the frame (sent, received or error)
+			uint16_t size; // Original size of the frame, only the first RECORD_FRAME_SIZE bytes are kept
+			uint8_t data[RECORD_FRAME_SIZE]; // Raw frame bytes
+			SofarSolar_RecordedFrame() : timestamp(0), direction(0), size(0), data{} {}
+		};
+
+		struct SofarSolar_BitSensor {
+			uint8_t register_key; // Key of the register containing the bits
+			uint8_t word; // Index of the word within the register
+			uint16_t mask; // Bits of the word, the sensor is on if any of them is set
+			binary_sensor::BinarySensor *sensor; // Binary sensor publishing the bits
+		};
+
+		struct SofarSolar_Snapshot {
+			uint32_t acquisition_start; // Time in milliseconds when the first request of the snapshot was sent
+			uint32_t acquisition_end; // Time in milliseconds when the last response of the snapshot was received
+			std::map<uint8_t, float> values; // Decoded values of the registers in the snapshot
+			std::map<uint8_t, uint32_t> timestamps; // Time in milliseconds when each value was received
+			bool valid; // Flag to indicate if every register of the group was received
+			SofarSolar_Snapshot() : acquisition_start(0), acquisition_end(0), valid(false) {}
+			float value(uint8_t register_key) const; // Value of a register, NAN if it is not part of the snapshot
+			uint32_t age(uint8_t register_key) const; // Age of a value in milliseconds, UINT32_MAX if it is not part of the snapshot
+		};
+
     	struct SofarSolar_RegisterDynamic;
 
-		struct register_read_task;
-
-        struct register_write_task;
-
-		static const std::map<uint8_t, SofarSolar_Register> G3_registers = {
-			// Define the SofarSolar registers with their properties
-			// Address, number of registers, type, priority, scale, write function
-			{PV_GENERATION_TODAY, SofarSolar_Register{0x0684, 2, U_DWORD, 1, -2, NONE}}, // PV Generation Today
-            {PV_GENERATION_TOTAL, SofarSolar_Register{0x0686, 2, U_DWORD, 0, -1, NONE}}, // PV Generation Total
-            {LOAD_CONSUMPTION_TODAY, SofarSolar_Register{0x0688, 2, U_DWORD, 1, -2, NONE}}, // Load Consumption Today
-    		{LOAD_CONSUMPTION_TOTAL, SofarSolar_Register{0x068A, 2, U_DWORD, 0, -1, NONE}}, // Load Consumption Total
-            {BATTERY_CHARGE_TODAY, SofarSolar_Register{0x0694, 2, U_DWORD, 1, -2, NONE}}, // Battery Charge Today
-            {BATTERY_CHARGE_TOTAL, SofarSolar_Register{0x0696, 2, U_DWORD, 0, -1, NONE}}, // Battery Charge Total
-            {BATTERY_DISCHARGE_TODAY, SofarSolar_Register{0x0698, 2, U_DWORD, 1, -2, NONE}}, // Battery Discharge Today
-            {BATTERY_DISCHARGE_TOTAL, SofarSolar_Register{0x069A, 2, U_DWORD, 0, -1, NONE}}, // Battery Discharge Total
-            {TOTAL_ACTIVE_POWER_INVERTER, SofarSolar_Register{0x0485, 1, S_WORD, 3, 1, NONE}}, // Total Active Power Inverter
-            {PV_VOLTAGE_1 ,SofarSolar_Register{0x0584, 1, U_WORD, 2, -1, NONE}}, // PV Voltage 1
-            {PV_CURRENT_1 ,SofarSolar_Register{0x0585, 1, U_WORD, 2, -2, NONE}}, // PV Current 1
-            {PV_POWER_1 ,SofarSolar_Register{0x0586, 1, U_WORD, 2, 1, NONE}}, // PV Power 1
-            {PV_VOLTAGE_2 ,SofarSolar_Register{0x0587, 1, U_WORD, 2, -1, NONE}}, // PV Voltage 2
-            {PV_CURRENT_2 ,SofarSolar_Register{0x0588, 1, U_WORD, 2, -2, NONE}}, // PV Current 2
-            {PV_POWER_2, SofarSolar_Register{0x0589, 1, U_WORD, 2, 1, NONE}}, // PV Power 2
-            {PV_POWER_TOTAL, SofarSolar_Register{0x05C4, 1, U_WORD, 3, 2, NONE}}, // PV Power Total
-
-			{BATTERY_VOLTAGE_1, SofarSolar_Register{0x0604, 1, U_WORD, 2, -1, NONE}}, // Battery Voltage 1
-			{BATTERY_CURRENT_1, SofarSolar_Register{0x0605, 1, S_WORD, 2, -2, NONE}}, // Battery Current 1
-			{BATTERY_POWER_1, SofarSolar_Register{0x0606, 1, S_WORD, 2, 3, NONE}}, // Battery Power 1
-			{BATTERY_TEMPERATUR_ENV_1, SofarSolar_Register{0x0607, 1, S_WORD, 2, 0, NONE}}, // Battery Temperature Environment 1
-			{BATTERY_STATE_OF_CHARGE_1, SofarSolar_Register{0x0608, 1, U_WORD, 2, 0, NONE}}, // Battery State of Charge 1
-			{BATTERY_STATE_OF_HEALTH_1, SofarSolar_Register{0x0609, 1, U_WORD, 2, 0, NONE}}, // Battery State of Health 1
-			{BATTERY_CHARGE_CYCLE_1, SofarSolar_Register{0x060A, 1, U_WORD, 2, 0, NONE}}, // Battery Charge Cycle 1
-
-			{BATTERY_VOLTAGE_2, SofarSolar_Register{0x060B, 1, U_WORD, 2, -1, NONE}}, // Battery Voltage 2
-			{BATTERY_CURRENT_2, SofarSolar_Register{0x060C, 1, S_WORD, 2, -2, NONE}}, // Battery Current 2
-			{BATTERY_POWER_2, SofarSolar_Register{0x060D, 1, S_WORD, 2, 3, NONE}}, // Battery Power 2
-			{BATTERY_TEMPERATUR_ENV_2, SofarSolar_Register{0x060E, 1, S_WORD, 2, 0, NONE}}, // Battery Temperature Environment 2
-			{BATTERY_STATE_OF_CHARGE_2, SofarSolar_Register{0x060F, 1, U_WORD, 2, 0, NONE}}, // Battery State of Charge 2
-			{BATTERY_STATE_OF_HEALTH_2, SofarSolar_Register{0x0610, 1, U_WORD, 2, 0, NONE}}, // Battery State of Health 2
-			{BATTERY_CHARGE_CYCLE_2, SofarSolar_Register{0x0611, 1, U_WORD, 2, 0, NONE}}, // Battery Charge Cycle 2
-
-			{BATTERY_VOLTAGE_3 ,SofarSolar_Register{0x0612, 1 ,U_WORD ,2 ,-1 ,NONE}}, // Battery Voltage 3
-			{BATTERY_CURRENT_3 ,SofarSolar_Register{0x0613 ,1 ,S_WORD ,2 ,-2 ,NONE}}, // Battery Current 3
-			{BATTERY_POWER_3 ,SofarSolar_Register{0x0614 ,1 ,S_WORD ,2 ,3 ,NONE}}, // Battery Power 3
-			{BATTERY_TEMPERATUR_ENV_3 ,SofarSolar_Register{0x0615 ,1 ,S_WORD ,2 ,0 ,NONE}}, // Battery Temperature Environment 3
-			{BATTERY_STATE_OF_CHARGE_3 ,SofarSolar_Register{0x0616 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Charge 3
-			{BATTERY_STATE_OF_HEALTH_3 ,SofarSolar_Register{0x0617 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Health 3
-			{BATTERY_CHARGE_CYCLE_3,SofarSolar_Register{0x0618 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 3
-
-			{BATTERY_VOLTAGE_4, SofarSolar_Register{0x0619, 1, U_WORD, 2, -1, NONE}}, // Battery Voltage 4
-			{BATTERY_CURRENT_4, SofarSolar_Register{0x061A, 1, S_WORD, 2, -2, NONE}}, // Battery Current 4
-			{BATTERY_POWER_4, SofarSolar_Register{0x061B, 1, S_WORD, 2, 3, NONE}}, // Battery Power 4
-			{BATTERY_TEMPERATUR_ENV_4, SofarSolar_Register{0x061C, 1, S_WORD, 2, 0, NONE}}, // Battery Temperature Environment 4
-			{BATTERY_STATE_OF_CHARGE_4, SofarSolar_Register{0x061D, 1, U_WORD, 2, 0, NONE}}, // Battery State of Charge 4
-			{BATTERY_STATE_OF_HEALTH_4, SofarSolar_Register{0x061E, 1, U_WORD, 2, 0, NONE}}, // Battery State of Health 4
-			{BATTERY_CHARGE_CYCLE_4,SofarSolar_Register{0x061F ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 4
-
-			{BATTERY_VOLTAGE_5 ,SofarSolar_Register{0x0620 ,1 ,U_WORD ,2 ,-1 ,NONE}}, // Battery Voltage 5
-			{BATTERY_CURRENT_5 ,SofarSolar_Register{0x0621 ,1 ,S_WORD ,2 ,-2 ,NONE}}, // Battery Current 5
-			{BATTERY_POWER_5 ,SofarSolar_Register{0x0622 ,1 ,S_WORD ,2 ,3 ,NONE}}, // Battery Power 5
-			{BATTERY_TEMPERATUR_ENV_5,SofarSolar_Register{0x0623 ,1 ,S_WORD ,2 ,0 ,NONE}}, // Battery Temperature Environment 5
-			{BATTERY_STATE_OF_CHARGE_5,SofarSolar_Register{0x0624 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Charge 5
-			{BATTERY_STATE_OF_HEALTH_5 ,SofarSolar_Register{0x0625 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Health 5
-			{BATTERY_CHARGE_CYCLE_5,SofarSolar_Register{0x0626 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 5
-
-			{BATTERY_VOLTAGE_6, SofarSolar_Register{0x0627, 1, U_WORD, 2, -1, NONE}}, // Battery Voltage 6
-			{BATTERY_CURRENT_6, SofarSolar_Register{0x0628, 1, S_WORD, 2, -2, NONE}}, // Battery Current 6
-			{BATTERY_POWER_6, SofarSolar_Register{0x0629, 1, S_WORD, 2, 3, NONE}}, // Battery Power 6
-			{BATTERY_TEMPERATUR_ENV_6, SofarSolar_Register{0x062A, 1, S_WORD, 2, 0, NONE}}, // Battery Temperature Environment 6
-			{BATTERY_STATE_OF_CHARGE_6, SofarSolar_Register{0x062B, 1, U_WORD, 2, 0, NONE}}, // Battery State of Charge 6
-			{BATTERY_STATE_OF_HEALTH_6, SofarSolar_Register{0x062C, 1, U_WORD, 2, 0, NONE}}, // Battery State of Health 6
-			{BATTERY_CHARGE_CYCLE_6,SofarSolar_Register{0x062D ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 6
-
-			{BATTERY_VOLTAGE_7,SofarSolar_Register{0x062E ,1 ,U_WORD ,2 ,-1 ,NONE}}, // Battery Voltage 7
-			{BATTERY_CURRENT_7,SofarSolar_Register{0x062F ,1 ,S_WORD ,2 ,-2 ,NONE}}, // Battery Current 7
-			{BATTERY_POWER_7,SofarSolar_Register{0x0630 ,1 ,S_WORD ,2 ,3 ,NONE}}, // Battery Power 7
-			{BATTERY_TEMPERATUR_ENV_7,SofarSolar_Register{0x0631 ,1 ,S_WORD ,2 ,0 ,NONE}}, // Battery Temperature Environment 7
-			{BATTERY_STATE_OF_CHARGE_7,SofarSolar_Register{0x0632 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Charge 7
-			{BATTERY_STATE_OF_HEALTH_7,SofarSolar_Register{0x0633 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery State of Health 7
-			{BATTERY_CHARGE_CYCLE_7,SofarSolar_Register{0x0634 ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 7
-
-			{BATTERY_VOLTAGE_8, SofarSolar_Register{0x0635, 1, U_WORD, 2, -1, NONE}}, // Battery Voltage 8
-			{BATTERY_CURRENT_8, SofarSolar_Register{0x0636, 1, S_WORD, 2, -2, NONE}}, // Battery Current 8
-			{BATTERY_POWER_8, SofarSolar_Register{0x0637, 1, S_WORD, 2, 3, NONE}}, // Battery Power 8
-			{BATTERY_TEMPERATUR_ENV_8, SofarSolar_Register{0x0638, 1, S_WORD, 2, 0, NONE}}, // Battery Temperature Environment 8
-			{BATTERY_STATE_OF_CHARGE_8, SofarSolar_Register{0x0639, 1, U_WORD, 2, 0, NONE}}, // Battery State of Charge 8
-			{BATTERY_STATE_OF_HEALTH_8, SofarSolar_Register{0x063A, 1, U_WORD, 2, 0, NONE}}, // Battery State of Health 8
-			{BATTERY_CHARGE_CYCLE_8,SofarSolar_Register{0x063B ,1 ,U_WORD ,2 ,0 ,NONE}}, // Battery Charge Cycle 8
-
-			{BATTERY_POWER_TOTAL, SofarSolar_Register{0x0667, 1, S_WORD, 3, 2, NONE}}, // Battery Power Total
-            {BATTERY_STATE_OF_CHARGE_TOTAL, SofarSolar_Register{0x0668, 1, U_WORD, 1, 0, NONE}}, // Battery State of Charge Total
-            {DESIRED_GRID_POWER, SofarSolar_Register{0x1187, 2, S_DWORD, 3, 0, DESIRED_GRID_POWER_WRITE}}, // Desired Grid Power
-			{MINIMUM_BATTERY_POWER, SofarSolar_Register{0x1189, 2, S_DWORD, 3, 0, DESIRED_GRID_POWER_WRITE}}, // Minimum Battery Power
-			{MAXIMUM_BATTERY_POWER, SofarSolar_Register{0x118B, 2, S_DWORD, 3, 0, DESIRED_GRID_POWER_WRITE}}, // Maximum Battery Power
-			{ENERGY_STORAGE_MODE, SofarSolar_Register{0x1110, 1, U_WORD, 0, 0, SINGLE_REGISTER_WRITE}}, // Energy Storage Mode
-			{BATTERY_CONF_ID, SofarSolar_Register{0x1044, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf ID
-			{BATTERY_CONF_ADDRESS, SofarSolar_Register{0x1045, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf Address
-			{BATTERY_CONF_PROTOCOL, SofarSolar_Register{0x1046, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf Protocol
-			{BATTERY_CONF_VOLTAGE_NOMINAL, SofarSolar_Register{0x1050, 1, U_WORD, 0, -1, BATTERY_CONF_WRITE}}, // Battery Conf Voltage Nominal
-			{BATTERY_CONF_VOLTAGE_OVER, SofarSolar_Register{0x1047, 1, U_WORD, 0, -1, BATTERY_CONF_WRITE}}, // Battery Conf Voltage Over
-			{BATTERY_CONF_VOLTAGE_CHARGE, SofarSolar_Register{0x1048, 1, U_WORD, 0, -1, BATTERY_CONF_WRITE}}, // Battery Conf Voltage Charge
-			{BATTERY_CONF_VOLTAGE_LACK,SofarSolar_Register{0x1049, 1, U_WORD, 0, -1, BATTERY_CONF_WRITE}}, // Battery Conf Voltage Lack
-			{BATTERY_CONF_VOLTAGE_DISCHARGE_STOP,SofarSolar_Register{0x104A, 1, U_WORD, 0, -1, BATTERY_CONF_WRITE}}, // Battery Conf Voltage Discharge Stop
-			{BATTERY_CONF_CURRENT_CHARGE_LIMIT, SofarSolar_Register{0x104B, 1, U_WORD, 0, -2, BATTERY_CONF_WRITE}}, // Battery Conf Current Charge Limit
-			{BATTERY_CONF_CURRENT_DISCHARGE_LIMIT, SofarSolar_Register{0x104C, 1, U_WORD, 0, -2, BATTERY_CONF_WRITE}}, // Battery Conf Current Discharge Limit
-			{BATTERY_CONF_DEPTH_OF_DISCHARGE, SofarSolar_Register{0x104D, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf Depth of Discharge
-			{BATTERY_CONF_END_OF_DISCHARGE, SofarSolar_Register{0x104E, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf End of Discharge
-			{BATTERY_CONF_CAPACITY, SofarSolar_Register{0x104F, 1, U_WORD, 0, 1, BATTERY_CONF_WRITE}}, // Battery Conf Capacity
-			{BATTERY_CONF_CELL_TYPE, SofarSolar_Register{0x1051, 1, U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf Cell Type
-			{BATTERY_CONF_EPS_BUFFER, SofarSolar_Register{0x1052, 1, U_WORD, 0, 1, BATTERY_CONF_WRITE}}, // Battery Conf EPS Buffer
-			{BATTERY_CONF_CONTROL, SofarSolar_Register{0x1053, 1 , U_WORD, 0, 0, BATTERY_CONF_WRITE}}, // Battery Conf Control
-			{GRID_FREQUENCY, SofarSolar_Register{0x0484, 1, U_WORD, 2, -2, NONE}}, // Grid Frequency
-			{GRID_VOLTAGE_PHASE_R, SofarSolar_Register{0x0580, 1, U_WORD, 2, -1, NONE}}, // Grid Voltage Phase R
-			{GRID_CURRENT_PHASE_R, SofarSolar_Register{0x0581, 1 ,U_WORD, 2, -2, NONE}}, // Grid Current Phase R
-			{GRID_POWER_PHASE_R, SofarSolar_Register{0x0582, 1, U_WORD, 2, 1, NONE}}, // Grid Power Phase R
-			{GRID_VOLTAGE_PHASE_S, SofarSolar_Register{0x058C, 1, U_WORD, 2, -1, NONE}}, // Grid Voltage Phase S
-			{GRID_CURRENT_PHASE_S, SofarSolar_Register{0x058D, 1, U_WORD, 2, -2, NONE}}, // Grid Current Phase S
-			{GRID_POWER_PHASE_S, SofarSolar_Register{0x058E, 1, U_WORD, 2, 1, NONE}}, // Grid Power Phase S
-			{GRID_VOLTAGE_PHASE_T, SofarSolar_Register{0x0598, 1, U_WORD, 2, -1, NONE}}, // Grid Voltage Phase T
-			{GRID_CURRENT_PHASE_T, SofarSolar_Register{0x0599, 1, U_WORD, 2, -2, NONE}}, // Grid Current Phase T
-			{GRID_POWER_PHASE_T, SofarSolar_Register{0x059A, 1, U_WORD, 2, 1, NONE}}, // Grid Power Phase T
-			{OFF_GRID_POWER_TOTAL, SofarSolar_Register{0x05A4, 1, U_WORD, 3, 2, NONE}}, // Off Grid Power Total
-			{OFF_GRID_FREQUENCY, SofarSolar_Register{0x05A5, 1, U_WORD, 2, -2, NONE}}, // Off Grid Frequency
-			{OFF_GRID_VOLTAGE_PHASE_R, SofarSolar_Register{0x05A6, 1, U_WORD, 2, -1, NONE}}, // Off Grid Voltage Phase R
-			{OFF_GRID_CURRENT_PHASE_R, SofarSolar_Register{0x05A7, 1, U_WORD, 2, -2, NONE}}, // Off Grid Current Phase R
-			{OFF_GRID_POWER_PHASE_R, SofarSolar_Register{0x05A8, 1, U_WORD, 2, 1, NONE}}, // Off Grid Power Phase R
-			{OFF_GRID_VOLTAGE_PHASE_S, SofarSolar_Register{0x05AC, 1, U_WORD, 2, -1, NONE}}, // Off Grid Voltage Phase S
-			{OFF_GRID_CURRENT_PHASE_S, SofarSolar_Register{0x05AD, 1, U_WORD, 2, -2, NONE}}, // Off Grid Current Phase S
-			{OFF_GRID_POWER_PHASE_S, SofarSolar_Register{0x05AE, 1, U_WORD, 2, 1, NONE}}, // Off Grid Power Phase S
-			{OFF_GRID_VOLTAGE_PHASE_T, SofarSolar_Register{0x05B8, 1, U_WORD, 2, -1, NONE}}, // Off Grid Voltage Phase T
-			{OFF_GRID_CURRENT_PHASE_T, SofarSolar_Register{0x05B9, 1, U_WORD, 2, -2, NONE}}, // Off Grid Current Phase T
-			{OFF_GRID_POWER_PHASE_T, SofarSolar_Register{0x05BA, 1, U_WORD, 2, 1, NONE}}, // Off Grid Power Phase T
-			{BATTERY_ACTIVE_CONTROL, SofarSolar_Register{0x102B, 1, U_WORD, 0, 0, BATTERY_ACTIVE_WRITE}}, // Battery Active Control
-			{BATTERY_ACTIVE_ONESHOT, SofarSolar_Register{0x102C, 1, U_WORD, 0, 0, BATTERY_ACTIVE_WRITE}}, // Battery Active Oneshot
-			{POWER_CONTROL, SofarSolar_Register{0x1105, 1, U_WORD, 0, 0, POWER_WRITE}}, // Battery Active Oneshot
-			{ACTIVE_POWER_EXPORT_LIMIT, SofarSolar_Register{0x1106, 1, U_WORD, 3, -1, POWER_WRITE}}, // Active Power Export Limit
-			{ACTIVE_POWER_IMPORT_LIMIT, SofarSolar_Register{0x1107, 1, U_WORD, 3, -1, POWER_WRITE}}, // Active Power Import Limit
-            {REACTIVE_POWER_SETTING, SofarSolar_Register{0x1108, 1, S_WORD, 0, -1, POWER_WRITE}}, // Reactive Power Setting
-            {POWER_FACTOR_SETTING, SofarSolar_Register{0x1109, 1, S_WORD, 0, 0, POWER_WRITE}}, // Power Factor Setting
-            {ACTIVE_POWER_LIMIT_SPEED, SofarSolar_Register{0x110A, 1, U_WORD, 0, 0, POWER_WRITE}}, // Active Power Limit Speed
-            {REACTIVE_POWER_RESPONSE_TIME, SofarSolar_Register{0x110B, 1, U_WORD, 0, -1, POWER_WRITE}}, // Reactive Power Response Time
-            {SVG_FIXED_REACTIVE_POWER_SETTING, SofarSolar_Register{0x110C, 1, S_WORD, 0, 0, NONE}} // SVG Fixed Reactive Power Setting
-        };
+
 
 		static const std::map<uint8_t, Model_Parameters> model_parameters = {
 			//Model, Phase Count, Max Output Power (W)
             {HYD6000EP, Model_Parameters{1, 6000}} // HYD6000EP, 1 phase, 5000W
         };
 
-        class SofarSolar_Inverter : public modbus::ModbusDevice, public Component {
+#ifdef USE_SOFARSOLAR_MODBUS
+		// Transport through the modbus component, the inverter is the device on the bus and forwards its responses
+		class SofarSolar_ModbusTransport : public SofarSolar_Transport {
+		public:
+			explicit SofarSolar_ModbusTransport(modbus::ModbusDevice *device) : device_(device) {}
+			bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override {
+				transaction_id = 0;
+				this->device_->send_raw(frame);
+				return true;
+			}
+			uint32_t get_request_gap() const override { return 150; }
+
+		protected:
+			modbus::ModbusDevice *device_;
+		};
+#else
+		namespace uart {
+			class UARTComponent; // Only used with the modbus component, setups with a TCP gateway have no UART
+		}
+#endif
+
+        class SofarSolar_Inverter : public Component, public SofarSolar_Sink
+#ifdef USE_SOFARSOLAR_MODBUS
+			, public modbus::ModbusDevice
+#endif
+		{
         public:
 
             std::map<uint8_t, SofarSolar_RegisterDynamic> G3_dynamic;
@@ -353,14 +259,49 @@ namespace esphome {
             void loop() override;
             void dump_config() override;
 
+#ifdef USE_SOFARSOLAR_MODBUS
 			void on_modbus_data(const std::vector<uint8_t> &data) override;
 			void on_modbus_error(uint8_t function_code, uint8_t exception_code) override;
+#endif
+
+			void on_read_response(const register_read_task &task, const FrameView &frame) override;
+			void on_write_response(const register_write_task &task, const FrameView &frame) override;
+			void on_request_failed(const in_flight_request &request, uint8_t reason) override;
+			void on_frame(uint8_t direction, const uint8_t *data, size_t size) override { this->record_frame(direction, data, size); }
+			void on_exception(uint8_t function_code, uint8_t exception_code) override;
+			void on_unmatched_response(uint16_t transaction_id) override;
+
+			void handle_read_response(const register_read_task &task, const FrameView &frame, const float *values);
+			void parse_read_response(const FrameView &frame, const register_read_task &task, const float *values = nullptr);
+			void queue_read(const register_read_task &task);
+			void queue_write(const register_write_task &task);
+			void run_transactions();
+			bool parse_write_response(const FrameView &frame, const register_write_task &task);
+			SofarSolar_DecodePlan &get_decode_plan(uint16_t start_address, uint16_t register_count);
+			void store_register_value(uint8_t register_key, float value, bool requested);
+			void store_register_text(uint8_t register_key, const std::string &text);
+			void publish_bit_sensors(uint8_t register_key, const FrameView &frame, size_t offset, uint16_t register_count);
+			void publish_aggregate(SofarSolar_RegisterDynamic &dynamic_register);
+			void add_sensor_aggregation(sensor::Sensor *sensor, uint32_t window, uint8_t mode, sensor::Sensor *min_sensor, sensor::Sensor *max_sensor);
+
+			void update_zero_export();
+			void apply_export_limit(int percentage);
+			float get_inverter_power() const;
+			uint16_t get_max_output_power() const { return model_parameters.at(this->model_id_).max_output_power_w; }
+			void set_site_controlled(bool site_controlled) { this->site_controlled_ = site_controlled; }
+			void queue_power_snapshot();
+			void finish_power_snapshot();
+			void fail_power_snapshot(const char *reason);
+			// The read is a block of the snapshot being acquired, not one left over from a failed snapshot
+			bool is_pending_snapshot_block(const register_read_task &task) const { return task.snapshot && this->power_snapshot_pending_blocks_ > 0 && task.snapshot_generation == this->power_snapshot_generation_; }
+			const SofarSolar_Snapshot &get_power_snapshot() const { return this->power_snapshot_; }
+			uint32_t get_power_snapshot_interval() const { return this->power_snapshot_interval_; }
+			float get_power_meter_value() const { return this->power_sensor_ != nullptr ? this->power_sensor_->state : NAN; }
+			uint32_t get_power_meter_age() const;
+
+			void record_frame(uint8_t direction, const uint8_t *data, size_t size);
+			void dump_bus_recorder();
 
-			void parse_read_response(const std::vector<uint8_t> &data);
-			void parse_write_response(const std::vector<uint8_t> &data);
-
-        	void read_modbus_register(uint16_t start_address, uint16_t register_count);
-			void write_modbus_register(uint16_t start_address, uint16_t register_count, const std::vector<uint8_t> &data);
 
             std::string vector_to_string(const std::vector<uint8_t> &data) {
                 std::string result;
@@ -372,30 +313,130 @@ namespace esphome {
                 return result;
             }
 
-			static float get_power_of_ten(int exponent) {
-                switch (exponent) {
-					case -3: return 0.001f;  // 10^-4
-                    case -2: return 0.01f;     // 10^-2
-                    case -1: return 0.1f;      // 10^-1
-                    case 0: return 1.0f;       // 10^0
-                    case 1: return 10.0f;      // 10^1
-                    case 2: return 100.0f;     // 10^2
-					case 3: return 1000.0f;    // 10^3
-                    default: return 1.0f;       // Default to no scaling for other cases
-                }
-            }
-
 			void write_desired_grid_power();
-			void write_battery_conf();
-			void write_battery_active();
+			void write_battery_conf(bool force = false);
+			void write_battery_active(SofarSolar_TransactionRef transaction = nullptr);
 			void write_single_register();
 			void write_power();
+			// With fetch_current the group is read first even if every register is written, the write is skipped if nothing changes.
+			// A forced write or one with a transaction is always sent.
+			void queue_group_write(uint8_t group_key, SofarSolar_TransactionRef transaction = nullptr, bool fetch_current = false, bool force = false);
+			void fail_group_transactions(uint8_t group_key, uint8_t reason);
+			void write_group(uint8_t group_key, const FrameView &current);
+			bool has_write_value(uint8_t register_key) const;
+			bool has_register_value(uint8_t register_key) const; // A value of the register has been read
+			float register_value(uint8_t register_key) const; // Last value read of the register, NAN if none
+			SofarSolar_RegisterValue &pending_write(uint8_t register_key) { return this->pending_writes_[register_key]; }
+			void set_number_value(number::Number *number_var, float value);
+			void flush_debounced_writes();
+			void set_write_debounce(uint32_t write_debounce, uint32_t write_max_delay) { this->write_debounce_ = write_debounce; this->write_max_delay_ = write_max_delay; }
+
+			void set_desired_grid_power_number(number::Number *desired_grid_power_number);
+			void set_minimum_battery_power_number(number::Number *minimum_battery_power_number);
+			void set_maximum_battery_power_number(number::Number *maximum_battery_power_number);
+			void set_active_power_export_limit_number(number::Number *active_power_export_limit_number);
+			void set_active_power_import_limit_number(number::Number *active_power_import_limit_number);
+			void set_battery_conf_id_number(number::Number *battery_conf_id_number);
+			void set_battery_conf_address_number(number::Number *battery_conf_address_number);
+			void set_desired_grid_power_number_update_interval(uint16_t desired_grid_power_number_update_interval);
+			void set_minimum_battery_power_number_update_interval(uint16_t minimum_battery_power_number_update_interval);
+			void set_maximum_battery_power_number_update_interval(uint16_t maximum_battery_power_number_update_interval);
+			void set_active_power_export_limit_number_update_interval(uint16_t active_power_export_limit_number_update_interval);
+			void set_active_power_import_limit_number_update_interval(uint16_t active_power_import_limit_number_update_interval);
+			void set_battery_conf_id_number_update_interval(uint16_t battery_conf_id_number_update_interval);
+			void set_battery_conf_address_number_update_interval(uint16_t battery_conf_address_number_update_interval);
 
             void set_model(std::string model) { this->model_ = model; this->set_model_id(model); }
             void set_model_id(std::string model);
             void set_modbus_address(int modbus_address) { this->modbus_address_ = modbus_address;}
             void set_zero_export(bool zero_export) { this->zero_export_ = zero_export;}
             void set_power_id(sensor::Sensor *power_id) { this->power_sensor_ = power_id;}
+            void set_power_snapshot_interval(uint32_t power_snapshot_interval) { this->power_snapshot_interval_ = power_snapshot_interval;}
+			void set_power_meter_max_age(uint32_t power_meter_max_age) { this->power_meter_max_age_ = power_meter_max_age; }
+            void set_bus_recorder_size(uint16_t bus_recorder_size) { this->bus_recorder_.resize(bus_recorder_size);}
+			void set_tcp_transport(const std::string &host, uint16_t port, uint8_t protocol, uint8_t max_outstanding, uint32_t timeout) { this->tcp_transport_ = new SofarSolar_TcpTransport(host, port, protocol, max_outstanding, timeout); }
+#ifdef USE_ESP32
+			void set_io_task(uint8_t core, uint8_t priority) { this->io_task_ = new SofarSolar_IoTask(); this->io_task_core_ = core; this->io_task_priority_ = priority; }
+#endif
+			void set_capture_buffer_size(uint16_t capture_buffer_size) { this->capture_buffer_size_ = capture_buffer_size; }
+			void add_on_capture_complete_callback(std::function<void()> &&callback) { this->capture_complete_callback_.add(std::move(callback)); }
+			void add_on_capture_data_callback(std::function<void(const std::string &)> &&callback) { this->capture_data_callback_.add(std::move(callback)); }
+			void start_capture(const std::vector<uint8_t> &registers, uint32_t duration);
+			void stop_capture();
+			void dump_capture();
+			bool is_capturing() const { return this->capture_.active; }
+			const std::vector<SofarSolar_CaptureSample> &get_capture_samples() const { return this->capture_.samples; }
+			void on_capture_response(const register_read_task &task, const FrameView &frame, const float *values);
+			void add_capture_sample(uint8_t channel, float value, uint32_t time);
+			uint32_t get_response_time() const;
+			void add_on_write_complete_callback(std::function<void(uint16_t)> &&callback) { this->write_complete_callback_.add(std::move(callback)); }
+			void add_on_read_failed_callback(std::function<void(uint16_t, const char *)> &&callback) { this->read_failed_callback_.add(std::move(callback)); }
+			void add_on_scan_data_callback(std::function<void(uint16_t, const std::string &)> &&callback) { this->scan_data_callback_.add(std::move(callback)); }
+			void start_register_scan(uint16_t start_address, uint16_t end_address, uint8_t format, uint8_t resolution);
+			void stop_register_scan();
+			bool is_scanning() const { return this->scan_.active; }
+			void queue_scan_read();
+			void on_scan_response(const register_read_task &task, const FrameView &frame);
+			void on_scan_failed(const register_read_task &task, uint8_t reason);
+			void skip_scan_range(uint16_t start_address, uint16_t register_count, const char *reason);
+			void flush_scan_skip();
+			void emit_scan_line(uint16_t address, const std::string &line);
+			void set_loop_budget(uint32_t loop_budget) { this->loop_budget_ = loop_budget; }
+			void set_publish_budget(uint32_t publish_budget) { this->publish_budget_ = publish_budget; }
+			void publish_queued_values(uint32_t phase_start);
+			void set_phase_statistics_interval(uint32_t phase_statistics_interval) { this->phase_statistics_interval_ = phase_statistics_interval; }
+			void set_phase_time_sensor(uint8_t phase, sensor::Sensor *max_sensor, sensor::Sensor *avg_sensor) { this->phase_stats_[phase].max_sensor = max_sensor; this->phase_stats_[phase].avg_sensor = avg_sensor; }
+			const SofarSolar_PhaseStats &get_phase_stats(uint8_t phase) const { return this->phase_stats_[phase]; }
+			uint32_t end_phase(uint8_t phase, uint32_t phase_start);
+			void publish_phase_stats();
+
+			void set_uart(uart::UARTComponent *uart) { this->uart_ = uart; }
+			void add_baud_rate(uint32_t baud_rate) { this->baud_negotiation_.add_baud_rate(baud_rate); }
+			void set_target_baud_rate(uint32_t target_baud_rate, uint16_t speed_setting_register) { this->baud_negotiation_.set_target_baud_rate(target_baud_rate); this->speed_setting_register_ = speed_setting_register; }
+			void add_speed_setting_value(uint32_t baud_rate, uint16_t value) { this->speed_setting_values_[baud_rate] = value; }
+			void set_link_baud_rate_sensor(sensor::Sensor *link_baud_rate_sensor) { this->link_baud_rate_sensor_ = link_baud_rate_sensor; }
+			void set_link_throughput_sensor(sensor::Sensor *link_throughput_sensor) { this->link_throughput_sensor_ = link_throughput_sensor; }
+			uint32_t get_baud_rate() const { return this->current_baud_rate_; }
+			void start_baud_negotiation();
+			void apply_baud_rate(uint32_t baud_rate);
+			void probe_baud_rate(uint32_t baud_rate);
+			void on_probe_response(const FrameView &frame);
+			void on_probe_failed();
+			void verify_target_baud_rate();
+			void start_polling();
+
+			void set_freshness(uint32_t freshness_interval, float freshness_target, uint8_t stale_after) { this->freshness_interval_ = freshness_interval; this->freshness_target_ = freshness_target; this->stale_after_ = stale_after; }
+			void set_stale_registers_sensor(sensor::Sensor *stale_registers_sensor) { this->stale_registers_sensor_ = stale_registers_sensor; }
+			void set_max_age_ratio_sensor(sensor::Sensor *max_age_ratio_sensor) { this->max_age_ratio_sensor_ = max_age_ratio_sensor; }
+			void check_freshness();
+			// Registers per priority class and age bucket (below 1, 2, 4 and from 4 update intervals) of the last check
+			uint16_t get_freshness_histogram(uint8_t priority, uint8_t bucket) const { return this->freshness_histogram_[priority][bucket]; }
+
+			void add_polling_profile(const std::string &name, uint8_t condition_register, float above, float below, uint32_t hold);
+			void add_polling_profile_interval(uint8_t profile, uint8_t register_key, uint16_t interval) { this->polling_profiles_[profile].intervals[register_key] = interval * 1000; }
+			void set_polling_profile_text_sensor(text_sensor::TextSensor *polling_profile_text_sensor) { this->polling_profile_text_sensor_ = polling_profile_text_sensor; }
+			void update_polling_profile();
+			void apply_polling_profile(int8_t index);
+			void set_combined_write_read(bool combined_write_read) { this->combined_write_read_ = combined_write_read; }
+
+			void set_telemetry(uint32_t interval, uint32_t batch_interval) { this->telemetry_ = new SofarSolar_TelemetryEncoder(); this->telemetry_interval_ = interval; this->telemetry_batch_interval_ = batch_interval; }
+			void add_telemetry_register(uint8_t register_key) { this->telemetry_registers_.push_back(register_key); }
+			void set_telemetry_udp(const std::string &host, uint16_t port) { this->telemetry_host_ = host; this->telemetry_port_ = port; }
+			void set_telemetry_mqtt_topic(const std::string &topic) { this->telemetry_topic_ = topic; }
+			void setup_telemetry();
+			void add_telemetry_sample(const SofarSolar_DecodeEntry &entry, const FrameView &frame, uint32_t now);
+			void send_telemetry();
+			void handle_combined_response(const register_write_task &task, const FrameView &frame);
+			void probe_combined(const register_write_task &task);
+			void fail_combined_probe(const char *reason);
+			bool fall_back_from_combined(const register_write_task &task, uint8_t reason);
+			void set_target_utilisation(float target_utilisation) { this->target_utilisation_ = target_utilisation; }
+			void set_bus_utilisation_sensor(sensor::Sensor *bus_utilisation_sensor) { this->bus_utilisation_sensor_ = bus_utilisation_sensor; }
+			void set_interval_scale_sensor(sensor::Sensor *interval_scale_sensor) { this->interval_scale_sensor_ = interval_scale_sensor; }
+			void check_admission();
+			float estimate_transaction_time(uint16_t register_count) const;
+			uint32_t get_average_round_trip() const;
+			void publish_link_stats();
 
 
             void set_pv_generation_today_sensor(sensor::Sensor *pv_generation_today_sensor);
@@ -638,6 +679,12 @@ namespace esphome {
             void set_battery_conf_cell_type_sensor_update_interval(uint16_t battery_conf_cell_type_sensor_update_interval);
             void set_battery_conf_eps_buffer_sensor_update_interval(uint16_t battery_conf_eps_buffer_sensor_update_interval);
             void set_battery_conf_control_sensor_update_interval(uint16_t battery_conf_control_sensor_update_interval);
+			void set_operational_status(text_sensor::TextSensor *operational_status_text_sensor);
+			void set_serial_number(text_sensor::TextSensor *serial_number_text_sensor);
+			void set_hardware_version(text_sensor::TextSensor *hardware_version_text_sensor);
+			void set_firmware_version(text_sensor::TextSensor *firmware_version_text_sensor);
+			void set_operational_status_update_interval(uint16_t operational_status_update_interval);
+
 			void set_grid_frequency_sensor_update_interval(uint16_t grid_frequency_sensor_update_interval);
 			void set_grid_voltage_phase_r_sensor_update_interval(uint16_t grid_voltage_phase_r_sensor_update_interval);
 			void set_grid_current_phase_r_sensor_update_interval(uint16_t grid_current_phase_r_sensor_update_interval);
@@ -717,6 +764,14 @@ namespace esphome {
 
 			void switch_command(const std::string &command);
 
+			void add_fault_binary_sensor(binary_sensor::BinarySensor *sensor, uint8_t word, uint16_t mask);
+			void add_power_control_binary_sensor(binary_sensor::BinarySensor *sensor, uint16_t mask);
+			void set_binary_sensor_update_interval(uint16_t binary_sensor_update_interval) { this->binary_sensor_update_interval_ = binary_sensor_update_interval * 1000; }
+
+			std::vector<SofarSolar_BitSensor> bit_sensors_;
+			std::map<uint32_t, SofarSolar_DecodePlan> decode_plans_; // Decode plans by start address and register count, built on first use
+			uint32_t binary_sensor_update_interval_ = 5000;
+
 
 
 			void set_battery_charge_only_switch(switch_::Switch *battery_charge_only_switch) { this->battery_charge_only_switch_ = battery_charge_only_switch; }
@@ -730,9 +785,11 @@ namespace esphome {
 
 			void set_battery_activation_button(button::Button *battery_activation_button) { this->battery_activation_button_ = battery_activation_button; }
 			void set_battery_config_write_button(button::Button *battery_config_write_button) { this->battery_config_write_button_ = battery_config_write_button; }
+			void set_bus_recorder_dump_button(button::Button *bus_recorder_dump_button) { this->bus_recorder_dump_button_ = bus_recorder_dump_button; }
 
 			button::Button *battery_activation_button_ = nullptr;
 			button::Button *battery_config_write_button_ = nullptr;
+			button::Button *bus_recorder_dump_button_ = nullptr;
 
 			void battery_activation();
 			void battery_config_write();
@@ -741,7 +798,202 @@ namespace esphome {
 			int model_id_;
             int modbus_address_;
             bool zero_export_;
-            sensor::Sensor *power_sensor_;
+			bool site_controlled_ = false; // The export limit is set by a site controller instead of the own zero export loop
+			uint32_t zero_export_last_update_ = 0;
+            sensor::Sensor *power_sensor_ = nullptr;
+			uint32_t power_meter_last_update_ = 0;
+			uint32_t power_meter_max_age_ = ZERO_EXPORT_METER_MAX_AGE; // Time in milliseconds after which the zero export control no longer trusts the meter
+
+			uint32_t power_snapshot_interval_ = 0;
+			uint32_t power_snapshot_last_request_ = 0;
+			uint8_t power_snapshot_pending_blocks_ = 0;
+			uint16_t power_snapshot_generation_ = 0; // Generation of the snapshot being acquired, increased with every snapshot queued
+			uint8_t power_snapshot_failures_ = 0; // Snapshots failed in a row since the last complete one
+			std::vector<SofarSolar_ReadBlock> power_snapshot_blocks_;
+			SofarSolar_Snapshot power_snapshot_; // Last complete snapshot, replaced as a whole when a new one is complete
+			SofarSolar_Snapshot power_snapshot_pending_; // Snapshot currently being acquired
+
+			std::vector<SofarSolar_RecordedFrame> bus_recorder_; // Ring buffer of recorded frames, empty if recording is disabled
+			size_t bus_recorder_next_ = 0; // Index of the slot that is overwritten next
+			uint32_t bus_recorder_count_ = 0; // Number of frames recorded since startup
+
+			SofarSolar_PhaseStats phase_stats_[PHASE_COUNT]; // Run time statistics of the loop phases
+			uint32_t phase_statistics_interval_ = 60000; // Interval in milliseconds to publish and reset the statistics
+			uint32_t phase_statistics_last_publish_ = 0;
+			uint32_t loop_budget_ = 0; // Time budget of one loop() in microseconds, 0 for no limit
+			uint32_t publish_budget_ = 2000; // Time budget in microseconds for publishing queued values in one loop()
+			std::set<std::pair<uint8_t, uint8_t>> publish_queue_; // Registers with a value to publish, ordered by descending priority and key
+			uint8_t scan_next_key_ = 0; // Register key the schedule scan resumes at after running out of budget
+
+			uart::UARTComponent *uart_ = nullptr; // UART of the modbus bus, only set if the baud rate is negotiated
+			SofarSolar_BaudNegotiation baud_negotiation_; // Baud rates probed at startup and the target rate
+			std::map<uint32_t, uint16_t> speed_setting_values_; // Value of the speed setting register by baud rate
+			uint16_t speed_setting_register_ = 0; // Address of the communication speed setting of the inverter
+			uint32_t current_baud_rate_ = 0;
+			uint32_t link_registers_ = 0; // Registers read since the last link statistics
+			uint32_t link_statistics_since_ = 0;
+			sensor::Sensor *link_baud_rate_sensor_ = nullptr;
+			sensor::Sensor *link_throughput_sensor_ = nullptr;
+
+			std::map<uint8_t, SofarSolar_RegisterValue> pending_writes_; // Values to write by register key, merged into the next write of their group
+			std::set<uint8_t> write_groups_fetching_; // Write groups waiting for their current values
+			std::set<uint8_t> write_groups_forced_; // Write groups whose next write is sent even if the inverter holds the values
+			std::map<uint8_t, std::vector<SofarSolar_TransactionRef>> group_transactions_; // Transactions waiting for the next write of their group
+			CallbackManager<void(uint16_t)> write_complete_callback_; // Called with the start address of every acknowledged write
+			CallbackManager<void(uint16_t, const char *)> read_failed_callback_; // Called with the start address and reason of every failed read
+			CallbackManager<void(uint16_t, const std::string &)> scan_data_callback_; // Called with the address and text of every line of a register scan
+			SofarSolar_RegisterScan scan_; // State of the running register scan
+			SofarSolar_Capture capture_; // State and samples of the last burst capture
+			uint16_t capture_buffer_size_ = 0; // Samples preallocated for captures, 0 if captures are not configured
+			CallbackManager<void()> capture_complete_callback_; // Called when a capture ended
+			CallbackManager<void(const std::string &)> capture_data_callback_; // Called with every line of a capture dump
+			uint32_t response_received_ = 0; // Time in microseconds the response handed over by the I/O task was received, 0 to use the current time
+			uint8_t last_exception_code_ = 0; // Exception code of the last exception response, the failed request is handled after it
+			std::map<uint8_t, SofarSolar_DebouncedWrite> debounced_writes_; // Write groups changed through numbers, by group key
+			SofarSolar_WriteCache write_cache_; // Last acknowledged write of each group
+			uint32_t write_debounce_ = 1000; // Time in milliseconds without changes before a group is written
+			uint32_t write_max_delay_ = 10000; // Time in milliseconds a group is written at the latest while it keeps changing
+
+			uint32_t freshness_interval_ = 10000; // Interval in milliseconds to check the age of the register values
+			uint32_t freshness_last_check_ = 0;
+			float freshness_target_ = 2.0f; // Age in update intervals a register value may reach before it misses its target
+			uint8_t stale_after_ = 0; // Age in update intervals after which a value is published as unavailable, 0 to keep it
+			uint16_t freshness_histogram_[FRESHNESS_CLASSES][FRESHNESS_BUCKETS] = {};
+			sensor::Sensor *stale_registers_sensor_ = nullptr;
+			sensor::Sensor *max_age_ratio_sensor_ = nullptr;
+
+			std::vector<SofarSolar_PollingProfile> polling_profiles_; // Polling profiles in the order they are checked
+			int8_t active_profile_ = -1; // Index of the polling profile in use, -1 for the configured intervals
+			uint32_t polling_profile_last_check_ = 0;
+			text_sensor::TextSensor *polling_profile_text_sensor_ = nullptr;
+
+			bool combined_write_read_ = true; // Read the feedback register of a group write in the same request with function 0x17
+
+			SofarSolar_TelemetryEncoder *telemetry_ = nullptr; // Packet of raw samples being filled, only allocated when streaming is configured
+			std::vector<uint8_t> telemetry_registers_; // Keys of the streamed registers, the index is the channel in the packets
+			uint32_t telemetry_interval_ = 250; // Update interval in milliseconds of the streamed registers
+			uint32_t telemetry_batch_interval_ = 1000; // Time in milliseconds a packet is sent at the latest after its first sample
+			std::string telemetry_host_;
+			uint16_t telemetry_port_ = 0;
+			std::unique_ptr<socket::Socket> telemetry_socket_;
+			struct sockaddr_storage telemetry_address_;
+			socklen_t telemetry_address_length_ = 0;
+			std::string telemetry_topic_;
+			uint32_t telemetry_packets_ = 0; // Packets sent since boot
+			uint32_t telemetry_dropped_ = 0; // Packets that could not be sent since boot
+			uint8_t combined_write_state_ = COMBINED_UNKNOWN; // Whether the inverter supports function 0x17, learned from a probe
+			uint8_t combined_probe_failures_ = 0; // Probes of function 0x17 that got no valid answer
+			uint16_t writes_outstanding_ = 0; // Writes queued or in flight, the probe must not overtake one of them
+
+			float target_utilisation_ = 0.8f; // Share of the bus time the poll schedule may use, 0 to never scale intervals
+			float interval_scale_ = 1.0f; // Factor applied to the intervals of the registers below the protected priority
+			sensor::Sensor *bus_utilisation_sensor_ = nullptr;
+			sensor::Sensor *interval_scale_sensor_ = nullptr;
+
+			SofarSolar_Poller poller_; // Request queues and in-flight requests
+#ifdef USE_SOFARSOLAR_MODBUS
+			SofarSolar_ModbusTransport modbus_transport_{this}; // Transport through the modbus component
+#endif
+			SofarSolar_TcpTransport *tcp_transport_ = nullptr; // Transport to a TCP gateway, the modbus component is used if not set
+#ifdef USE_ESP32
+			SofarSolar_IoTask *io_task_ = nullptr; // Task running the TCP transport on its own core, the main loop polls if not set
+			uint8_t io_task_core_ = 0;
+			uint8_t io_task_priority_ = 5;
+#endif
+		};
+
+		class SofarSolar_WriteCompleteTrigger : public Trigger<uint16_t> {
+		public:
+			explicit SofarSolar_WriteCompleteTrigger(SofarSolar_Inverter *parent) {
+				parent->add_on_write_complete_callback([this](uint16_t address) { this->trigger(address); });
+			}
+		};
+
+		class SofarSolar_ReadFailedTrigger : public Trigger<uint16_t, std::string> {
+		public:
+			explicit SofarSolar_ReadFailedTrigger(SofarSolar_Inverter *parent) {
+				parent->add_on_read_failed_callback([this](uint16_t address, const char *reason) { this->trigger(address, reason); });
+			}
+		};
+
+		class SofarSolar_ScanDataTrigger : public Trigger<uint16_t, std::string> {
+		public:
+			explicit SofarSolar_ScanDataTrigger(SofarSolar_Inverter *parent) {
+				parent->add_on_scan_data_callback([this](uint16_t address, const std::string &data) { this->trigger(address, data); });
+			}
+		};
+
+		class SofarSolar_CaptureCompleteTrigger : public Trigger<> {
+		public:
+			explicit SofarSolar_CaptureCompleteTrigger(SofarSolar_Inverter *parent) {
+				parent->add_on_capture_complete_callback([this]() { this->trigger(); });
+			}
+		};
+
+		class SofarSolar_CaptureDataTrigger : public Trigger<std::string> {
+		public:
+			explicit SofarSolar_CaptureDataTrigger(SofarSolar_Inverter *parent) {
+				parent->add_on_capture_data_callback([this](const std::string &line) { this->trigger(line); });
+			}
+		};
+
+		template<typename... Ts> class SofarSolar_StartCaptureAction : public Action<Ts...> {
+		public:
+			explicit SofarSolar_StartCaptureAction(SofarSolar_Inverter *parent) : parent_(parent) {}
+			TEMPLATABLE_VALUE(uint32_t, duration)
+			void add_register(uint8_t register_key) { this->registers_.push_back(register_key); }
+
+			void play(Ts... x) override { this->parent_->start_capture(this->registers_, this->duration_.value(x...)); }
+
+		protected:
+			SofarSolar_Inverter *parent_;
+			std::vector<uint8_t> registers_;
+		};
+
+		template<typename... Ts> class SofarSolar_StopCaptureAction : public Action<Ts...> {
+		public:
+			explicit SofarSolar_StopCaptureAction(SofarSolar_Inverter *parent) : parent_(parent) {}
+
+			void play(Ts... x) override { this->parent_->stop_capture(); }
+
+		protected:
+			SofarSolar_Inverter *parent_;
+		};
+
+		template<typename... Ts> class SofarSolar_DumpCaptureAction : public Action<Ts...> {
+		public:
+			explicit SofarSolar_DumpCaptureAction(SofarSolar_Inverter *parent) : parent_(parent) {}
+
+			void play(Ts... x) override { this->parent_->dump_capture(); }
+
+		protected:
+			SofarSolar_Inverter *parent_;
+		};
+
+		template<typename... Ts> class SofarSolar_ScanRegistersAction : public Action<Ts...> {
+		public:
+			explicit SofarSolar_ScanRegistersAction(SofarSolar_Inverter *parent) : parent_(parent) {}
+			TEMPLATABLE_VALUE(uint16_t, start_address)
+			TEMPLATABLE_VALUE(uint16_t, end_address)
+			void set_format(uint8_t format) { this->format_ = format; }
+			void set_resolution(uint8_t resolution) { this->resolution_ = resolution; }
+
+			void play(Ts... x) override { this->parent_->start_register_scan(this->start_address_.value(x...), this->end_address_.value(x...), this->format_, this->resolution_); }
+
+		protected:
+			SofarSolar_Inverter *parent_;
+			uint8_t format_ = SCAN_FORMAT_HEX;
+			uint8_t resolution_ = 1;
+		};
+
+		template<typename... Ts> class SofarSolar_StopScanAction : public Action<Ts...> {
+		public:
+			explicit SofarSolar_StopScanAction(SofarSolar_Inverter *parent) : parent_(parent) {}
+
+			void play(Ts... x) override { this->parent_->stop_register_scan(); }
+
+		protected:
+			SofarSolar_Inverter *parent_;
 		};
     }
 }
\ No newline at end of file
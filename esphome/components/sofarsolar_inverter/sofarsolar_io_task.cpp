@@ -0,0 +1,124 @@
+#ifdef USE_ESP32
+#include "sofarsolar_io_task.h"
+#include "esphome/core/hal.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		bool SofarSolar_IoTask::start(SofarSolar_Transport *transport, uint8_t modbus_address, uint32_t (*clock)(), uint8_t core, uint8_t priority) {
+			this->poller_.set_clock(clock);
+			this->poller_.set_sink(this);
+			this->poller_.set_modbus_address(modbus_address);
+			this->poller_.set_transport(transport);
+			return xTaskCreatePinnedToCore(&SofarSolar_IoTask::task_main, "sofarsolar_io", 4096, this, priority, &this->handle_, core) == pdPASS;
+		}
+
+		void SofarSolar_IoTask::queue(SofarSolar_IoRequest &&request) {
+			// Keep the order of the requests, nothing passes the backlog
+			this->flush_backlog();
+			if (!this->request_backlog_.empty() || !this->requests_.push(std::move(request))) {
+				this->request_backlog_.push_back(std::move(request));
+			}
+		}
+
+		void SofarSolar_IoTask::flush_backlog() {
+			while (!this->request_backlog_.empty() && this->requests_.push(std::move(this->request_backlog_.front()))) {
+				this->request_backlog_.pop_front();
+			}
+		}
+
+		void SofarSolar_IoTask::task_main(void *arg) {
+			static_cast<SofarSolar_IoTask *>(arg)->run();
+		}
+
+		void SofarSolar_IoTask::run() {
+			while (true) {
+				SofarSolar_IoRequest request;
+				while (this->requests_.pop(request)) {
+					if (request.is_write) {
+						this->poller_.queue_write(request.write_task);
+					} else {
+						this->poller_.queue_read(request.read_task);
+					}
+				}
+				this->poller_.loop();
+				while (!this->result_backlog_.empty() && this->results_.push(std::move(this->result_backlog_.front()))) {
+					this->result_backlog_.pop_front();
+				}
+				vTaskDelay(1);
+			}
+		}
+
+		void SofarSolar_IoTask::push_result(SofarSolar_IoResult &&result) {
+			if (!this->result_backlog_.empty() || !this->results_.push(std::move(result))) {
+				this->result_backlog_.push_back(std::move(result)); // The main loop is behind, hand it over later
+			}
+		}
+
+		void SofarSolar_IoTask::on_read_response(const register_read_task &task, const FrameView &frame) {
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_READ;
+			result.received = micros();
+			result.request.read_task = task;
+			result.data.assign(frame.data(), frame.data() + frame.size());
+			if (!task.scan && frame.size() == task.register_count * 2u) {
+				uint32_t plan_key = (static_cast<uint32_t>(task.start_address) << 16) | task.register_count;
+				auto plan = this->decode_plans_.find(plan_key);
+				if (plan == this->decode_plans_.end()) {
+					plan = this->decode_plans_.emplace(plan_key, SofarSolar_DecodePlan{}).first;
+					build_decode_plan(task.start_address, task.register_count, plan->second);
+				}
+				if (decode_block(frame, plan->second.numeric.data(), plan->second.numeric.size(), plan->second.values.data()) == plan->second.numeric.size()) {
+					result.values = plan->second.values;
+				}
+			}
+			this->push_result(std::move(result));
+		}
+
+		void SofarSolar_IoTask::on_write_response(const register_write_task &task, const FrameView &frame) {
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_WRITE;
+			result.received = micros();
+			result.request.is_write = true;
+			result.request.write_task = task;
+			result.data.assign(frame.data(), frame.data() + frame.size());
+			this->push_result(std::move(result));
+		}
+
+		void SofarSolar_IoTask::on_request_failed(const in_flight_request &request, uint8_t reason) {
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_FAILED;
+			result.request = request;
+			result.code = reason;
+			this->push_result(std::move(result));
+		}
+
+		void SofarSolar_IoTask::on_frame(uint8_t direction, const uint8_t *data, size_t size) {
+			if (!this->record_frames_) {
+				return;
+			}
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_FRAME;
+			result.code = direction;
+			result.data.assign(data, data + size);
+			this->push_result(std::move(result));
+		}
+
+		void SofarSolar_IoTask::on_exception(uint8_t function_code, uint8_t exception_code) {
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_EXCEPTION;
+			result.code = function_code;
+			result.exception_code = exception_code;
+			this->push_result(std::move(result));
+		}
+
+		void SofarSolar_IoTask::on_unmatched_response(uint16_t transaction_id) {
+			SofarSolar_IoResult result;
+			result.kind = IO_RESULT_UNMATCHED;
+			result.request.transaction_id = transaction_id;
+			this->push_result(std::move(result));
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+#ifdef USE_ESP32
+#include "deque"
+#include "map"
+#include "vector"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sofarsolar_poller.h"
+#include "sofarsolar_ring.h"
+
+#define IO_RESULT_READ 1
+#define IO_RESULT_WRITE 2
+#define IO_RESULT_FAILED 3
+#define IO_RESULT_EXCEPTION 4
+#define IO_RESULT_UNMATCHED 5
+#define IO_RESULT_FRAME 6
+
+#define IO_RING_SIZE 32
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		struct SofarSolar_IoRequest {
+			bool is_write = false; // Flag to indicate a write request
+			register_read_task read_task; // Task of a read request
+			register_write_task write_task; // Task of a write request
+		};
+
+		struct SofarSolar_IoResult {
+			uint8_t kind = 0; // IO_RESULT_* kind of the result
+			in_flight_request request; // Request the result belongs to, for reads, writes and failures
+			uint8_t code = 0; // Failure reason, function code of an exception or direction of a recorded frame
+			uint8_t exception_code = 0; // Exception code of an exception
+			std::vector<uint8_t> data; // Payload of the response or the recorded frame
+			std::vector<float> values; // Numeric registers of a read response, decoded on the I/O task
+			uint32_t received = 0; // Time in microseconds a read or write response was received
+		};
+
+		// Runs the poller and its transport on a FreeRTOS task pinned to one core. Requests come in from the main
+		// loop and results go back to it over single-producer/single-consumer rings, read responses are decoded
+		// on the I/O task already. Only the methods marked as main task may be called from the main loop.
+		class SofarSolar_IoTask : public SofarSolar_Sink {
+		public:
+			// Main task, before start()
+			void set_record_frames(bool record_frames) { this->record_frames_ = record_frames; }
+			bool start(SofarSolar_Transport *transport, uint8_t modbus_address, uint32_t (*clock)(), uint8_t core, uint8_t priority);
+
+			// Main task
+			void queue(SofarSolar_IoRequest &&request);
+			void flush_backlog();
+			bool pop_result(SofarSolar_IoResult &result) { return this->results_.pop(result); }
+			size_t get_backlog_size() const { return this->request_backlog_.size(); }
+			uint32_t get_average_round_trip() const { return this->poller_.get_average_round_trip(); }
+
+			// I/O task
+			void on_read_response(const register_read_task &task, const FrameView &frame) override;
+			void on_write_response(const register_write_task &task, const FrameView &frame) override;
+			void on_request_failed(const in_flight_request &request, uint8_t reason) override;
+			void on_frame(uint8_t direction, const uint8_t *data, size_t size) override;
+			void on_exception(uint8_t function_code, uint8_t exception_code) override;
+			void on_unmatched_response(uint16_t transaction_id) override;
+
+		protected:
+			static void task_main(void *arg);
+			void run();
+			void push_result(SofarSolar_IoResult &&result);
+
+			SofarSolar_Poller poller_; // I/O task only after start()
+			SofarSolar_SpscRing<SofarSolar_IoRequest, IO_RING_SIZE> requests_; // Main task to I/O task
+			SofarSolar_SpscRing<SofarSolar_IoResult, IO_RING_SIZE> results_; // I/O task to main task
+			std::deque<SofarSolar_IoRequest> request_backlog_; // Requests not fitting into the ring, main task only
+			std::deque<SofarSolar_IoResult> result_backlog_; // Results not fitting into the ring, I/O task only
+			std::map<uint32_t, SofarSolar_DecodePlan> decode_plans_; // Decode plans of the I/O task by start address and register count
+			bool record_frames_ = false;
+			TaskHandle_t handle_ = nullptr;
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
+#endif
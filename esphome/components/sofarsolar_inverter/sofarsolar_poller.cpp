@@ -0,0 +1,175 @@
+#include "sofarsolar_poller.h"
+#include "algorithm"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		void SofarSolar_Transaction::mark_sent(uint32_t now) {
+			this->sent_ = now;
+			this->state_.store(TRANSACTION_SENT, std::memory_order_release);
+		}
+
+		void SofarSolar_Transaction::complete(const FrameView &frame, uint32_t now) {
+			if (this->is_done()) {
+				return;
+			}
+			this->finished_ = now;
+			this->state_.store(TRANSACTION_COMPLETED, std::memory_order_release);
+			if (this->on_done_) {
+				this->on_done_(*this, frame);
+			}
+		}
+
+		void SofarSolar_Transaction::fail(uint8_t reason, uint32_t now) {
+			if (this->is_done()) {
+				return;
+			}
+			this->failure_reason_ = reason;
+			this->finished_ = now;
+			this->state_.store(reason == REQUEST_TIMEOUT ? TRANSACTION_TIMED_OUT : TRANSACTION_FAILED, std::memory_order_release);
+			if (this->on_done_) {
+				this->on_done_(*this, FrameView());
+			}
+		}
+
+		void SofarSolar_Poller::set_transport(SofarSolar_Transport *transport) {
+			this->transport_ = transport;
+			transport->on_data = [this](uint16_t transaction_id, const std::vector<uint8_t> &data) { this->handle_response(transaction_id, data); };
+			transport->on_error = [this](uint16_t transaction_id, uint8_t function_code, uint8_t exception_code) { this->handle_error(transaction_id, function_code, exception_code); };
+			transport->on_disconnect = [this]() { this->fail_all(REQUEST_DISCONNECTED); };
+		}
+
+		void SofarSolar_Poller::loop() {
+			this->transport_->loop();
+			uint32_t now = this->clock_();
+			while (this->in_flight_.size() < this->transport_->get_max_outstanding() && (!this->write_queue_.empty() || !this->read_queue_.empty())) {
+				if (!this->transport_->is_connected()) {
+					break;
+				}
+				if (this->transport_->get_request_gap() > 0 && now - this->last_operation_ <= this->transport_->get_request_gap()) {
+					break; // Keep the gap between two operations on the bus
+				}
+				in_flight_request request;
+				if (!this->write_queue_.empty()) {
+					// Write tasks are dispatched before read tasks
+					request.is_write = true;
+					request.write_task = this->write_queue_.top();
+					this->write_queue_.pop();
+					const register_write_task &task = request.write_task;
+					if (task.read_register_count > 0) {
+						request.transaction_id = this->write_read_registers(task.read_start_address, task.read_register_count, task.start_address, task.number_of_registers, task.data);
+					} else {
+						request.transaction_id = this->write_registers(task.start_address, task.number_of_registers, task.data);
+					}
+				} else {
+					request.read_task = this->read_queue_.top();
+					this->read_queue_.pop();
+					request.transaction_id = this->read_registers(request.read_task.start_address, request.read_task.register_count);
+				}
+				request.sent = now;
+				this->last_operation_ = now;
+				SofarSolar_TransactionRef &transaction = request.is_write ? request.write_task.transaction : request.read_task.transaction;
+				if (transaction != nullptr) {
+					transaction->mark_sent(now);
+				}
+				if (!this->transport_->is_connected()) {
+					this->sink_->on_request_failed(request, REQUEST_DISCONNECTED); // The connection was lost while sending
+					break;
+				}
+				this->in_flight_.push_back(request);
+			}
+
+			while (!this->in_flight_.empty() && now - this->in_flight_.front().sent > this->transport_->get_timeout()) {
+				in_flight_request request = this->in_flight_.front();
+				this->in_flight_.pop_front();
+				this->last_operation_ = now; // A late response arrives in the request gap instead of during the next request
+				this->sink_->on_request_failed(request, REQUEST_TIMEOUT);
+			}
+		}
+
+		std::deque<in_flight_request>::iterator SofarSolar_Poller::find_request(uint16_t transaction_id) {
+			if (!this->transport_->has_transaction_ids()) {
+				return this->in_flight_.begin(); // Without transaction ids responses arrive in the order of the requests
+			}
+			return std::find_if(this->in_flight_.begin(), this->in_flight_.end(), [transaction_id](const in_flight_request &request) { return request.transaction_id == transaction_id; });
+		}
+
+		void SofarSolar_Poller::handle_response(uint16_t transaction_id, const std::vector<uint8_t> &data) {
+			this->sink_->on_frame(RECORD_RX, data.data(), data.size());
+			auto it = this->find_request(transaction_id);
+			if (it == this->in_flight_.end()) {
+				this->sink_->on_unmatched_response(transaction_id);
+				return;
+			}
+			// Remove the request before handing it out, the sink may queue new tasks
+			in_flight_request request = *it;
+			this->in_flight_.erase(it);
+			this->last_operation_ = this->clock_();
+			this->add_round_trip(this->last_operation_ - request.sent);
+			FrameView frame(data.data(), data.size());
+			if (request.is_write) {
+				this->sink_->on_write_response(request.write_task, frame);
+			} else {
+				this->sink_->on_read_response(request.read_task, frame);
+			}
+		}
+
+		void SofarSolar_Poller::handle_error(uint16_t transaction_id, uint8_t function_code, uint8_t exception_code) {
+			uint8_t error[2] = {function_code, exception_code};
+			this->sink_->on_frame(RECORD_ERROR, error, sizeof(error));
+			this->sink_->on_exception(function_code, exception_code);
+			auto it = this->find_request(transaction_id);
+			if (it == this->in_flight_.end()) {
+				return;
+			}
+			// The request has been answered, it does not need to run into the timeout
+			in_flight_request request = *it;
+			this->in_flight_.erase(it);
+			this->last_operation_ = this->clock_();
+			this->add_round_trip(this->last_operation_ - request.sent);
+			this->sink_->on_request_failed(request, REQUEST_EXCEPTION);
+		}
+
+		void SofarSolar_Poller::add_round_trip(uint32_t round_trip) {
+			uint32_t average = this->average_round_trip_.load(std::memory_order_relaxed);
+			this->average_round_trip_.store(average == 0 ? round_trip : (average * 7 + round_trip) / 8, std::memory_order_relaxed);
+		}
+
+		void SofarSolar_Poller::fail_all(uint8_t reason) {
+			while (!this->in_flight_.empty()) {
+				in_flight_request request = this->in_flight_.front();
+				this->in_flight_.pop_front();
+				this->sink_->on_request_failed(request, reason);
+			}
+		}
+
+		uint16_t SofarSolar_Poller::read_registers(uint16_t start_address, uint16_t register_count) {
+			// Create Modbus frame for reading registers
+			std::vector<uint8_t> frame = {this->modbus_address_, 0x03, static_cast<uint8_t>(start_address >> 8), static_cast<uint8_t>(start_address & 0xFF), static_cast<uint8_t>(register_count >> 8), static_cast<uint8_t>(register_count & 0xFF)};
+			return this->send_frame(frame);
+		}
+
+		uint16_t SofarSolar_Poller::write_registers(uint16_t start_address, uint16_t register_count, const std::vector<uint8_t> &data) {
+			// Create Modbus frame for writing registers
+			std::vector<uint8_t> frame = {this->modbus_address_, 0x10, static_cast<uint8_t>(start_address >> 8), static_cast<uint8_t>(start_address & 0xFF), static_cast<uint8_t>(register_count >> 8), static_cast<uint8_t>(register_count & 0xFF), static_cast<uint8_t>(data.size())};
+			frame.insert(frame.end(), data.begin(), data.end());
+			return this->send_frame(frame);
+		}
+
+		uint16_t SofarSolar_Poller::write_read_registers(uint16_t read_start_address, uint16_t read_register_count, uint16_t write_start_address, uint16_t write_register_count, const std::vector<uint8_t> &data) {
+			// Create Modbus frame for writing and reading registers in one request, the write is executed first
+			std::vector<uint8_t> frame = {this->modbus_address_, 0x17, static_cast<uint8_t>(read_start_address >> 8), static_cast<uint8_t>(read_start_address & 0xFF), static_cast<uint8_t>(read_register_count >> 8), static_cast<uint8_t>(read_register_count & 0xFF),
+				static_cast<uint8_t>(write_start_address >> 8), static_cast<uint8_t>(write_start_address & 0xFF), static_cast<uint8_t>(write_register_count >> 8), static_cast<uint8_t>(write_register_count & 0xFF), static_cast<uint8_t>(data.size())};
+			frame.insert(frame.end(), data.begin(), data.end());
+			return this->send_frame(frame);
+		}
+
+		uint16_t SofarSolar_Poller::send_frame(const std::vector<uint8_t> &frame) {
+			this->sink_->on_frame(RECORD_TX, frame.data(), frame.size());
+			uint16_t transaction_id = 0;
+			this->transport_->send(frame, transaction_id);
+			return transaction_id;
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,177 @@
+#pragma once
+#include "queue"
+#include "deque"
+#include "vector"
+#include "atomic"
+#include "memory"
+#include "functional"
+#include "cstdint"
+#include "sofarsolar_registers.h"
+#include "sofarsolar_transport.h"
+
+#define RECORD_TX 0x01
+#define RECORD_RX 0x02
+#define RECORD_ERROR 0x03
+
+#define REQUEST_TIMEOUT 1
+#define REQUEST_EXCEPTION 2
+#define REQUEST_DISCONNECTED 3
+#define REQUEST_ABORTED 4
+#define REQUEST_INVALID 5
+
+#define TRANSACTION_QUEUED 0
+#define TRANSACTION_SENT 1
+#define TRANSACTION_COMPLETED 2
+#define TRANSACTION_FAILED 3
+#define TRANSACTION_TIMED_OUT 4
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// One read or write from queueing to its result. The poller marks it sent, the owner of the poller completes or
+		// fails it where the results are handled and runs the callback there, so the callback may queue the next
+		// operation of a chain and it is dispatched without waiting for the next poll.
+		class SofarSolar_Transaction {
+		public:
+			using Callback = std::function<void(const SofarSolar_Transaction &transaction, const FrameView &frame)>;
+			explicit SofarSolar_Transaction(Callback on_done = nullptr) : on_done_(std::move(on_done)) {}
+
+			uint8_t get_state() const { return this->state_.load(std::memory_order_acquire); }
+			bool is_done() const { return this->get_state() >= TRANSACTION_COMPLETED; }
+			bool succeeded() const { return this->get_state() == TRANSACTION_COMPLETED; }
+			uint8_t get_failure_reason() const { return this->failure_reason_; }
+			uint32_t get_sent() const { return this->sent_; }
+			uint32_t get_finished() const { return this->finished_; }
+
+			void mark_sent(uint32_t now);
+			void complete(const FrameView &frame, uint32_t now);
+			void fail(uint8_t reason, uint32_t now);
+
+		protected:
+			std::atomic<uint8_t> state_{TRANSACTION_QUEUED};
+			uint8_t failure_reason_ = 0; // REQUEST_* reason of a failed transaction
+			uint32_t sent_ = 0; // Time in milliseconds the request was sent
+			uint32_t finished_ = 0; // Time in milliseconds the transaction completed or failed
+			Callback on_done_; // Called once when the transaction completes or fails
+		};
+		using SofarSolar_TransactionRef = std::shared_ptr<SofarSolar_Transaction>;
+
+		struct register_read_task {
+			uint8_t register_key; // Key of the first register to read
+			uint16_t start_address; // Start address of the read
+			uint16_t register_count; // Number of registers to read
+			bool snapshot = false; // Flag to indicate that the read belongs to the power flow snapshot
+			bool probe = false; // Flag to indicate that the read only checks the link to the inverter
+			bool write_group = false; // Flag to indicate that the read fetches the current values of a write group
+			bool scan = false; // Flag to indicate that the read belongs to a register scan, the start address is not a known register
+			bool capture = false; // Flag to indicate that the read samples a register of a burst capture
+			uint16_t snapshot_generation = 0; // Snapshot the read belongs to, blocks of an abandoned snapshot are not counted toward the next
+			SofarSolar_TransactionRef transaction; // Transaction to complete with the result, nullptr for plain polling
+			register_read_task() : register_key(0), start_address(0), register_count(0) {}
+			explicit register_read_task(uint8_t register_key) : register_key(register_key), start_address(G3_registers.at(register_key).start_address), register_count(G3_registers.at(register_key).register_count) {}
+			bool operator<(const register_read_task &other) const {
+				if (this->scan != other.scan) {
+					return this->scan; // Scan reads only use the bus when nothing else is waiting
+				}
+				if (this->write_group != other.write_group) {
+					return other.write_group; // Fetches for pending writes are dispatched first
+				}
+				if (this->snapshot != other.snapshot) {
+					return other.snapshot; // Snapshot reads go before all other reads, the zero export control keeps running during a capture
+				}
+				if (this->capture != other.capture) {
+					return other.capture; // Capture reads go before the reads queued before the capture started
+				}
+				return register_priority(this->register_key) > register_priority(other.register_key);
+			}
+		};
+
+		struct register_write_task {
+			uint8_t first_register_key; // Pointer to the register to write
+			uint16_t start_address; // Start address of the write
+			uint8_t number_of_registers; // Number of registers to write
+			std::vector<uint8_t> data; // Data to write to the register
+			SofarSolar_TransactionRef transaction; // Transaction to complete with the result, nullptr if nobody waits for it
+			uint8_t read_register_key = 0; // Key of the register read back in the same request with function 0x17
+			uint16_t read_start_address = 0; // Start address of the registers read back
+			uint16_t read_register_count = 0; // Number of registers read back, 0 for a plain write
+			bool probe = false; // Flag to indicate that the write checks function 0x17 by writing back values the inverter holds
+			register_write_task() : first_register_key(0), start_address(0), number_of_registers(0) {}
+			explicit register_write_task(uint8_t first_register_key) : first_register_key(first_register_key), start_address(G3_registers.at(first_register_key).start_address), number_of_registers(0) {}
+			bool operator<(const register_write_task &other) const {
+				if (this->probe != other.probe) {
+					return other.probe; // A later write must not be overwritten by the values the probe writes back
+				}
+				return register_priority(this->first_register_key) > register_priority(other.first_register_key);
+			}
+		};
+
+		struct in_flight_request {
+			bool is_write = false; // Flag to indicate a write request
+			register_read_task read_task; // Task of a read request
+			register_write_task write_task; // Task of a write request
+			uint16_t transaction_id = 0; // Transaction id of the request, 0 if the transport has none
+			uint32_t sent = 0; // Time in milliseconds the request was sent
+		};
+
+		// Receiver of the results of the poller, implemented by the adapter that owns it
+		class SofarSolar_Sink {
+		public:
+			virtual ~SofarSolar_Sink() = default;
+			virtual void on_read_response(const register_read_task &task, const FrameView &frame) = 0;
+			virtual void on_write_response(const register_write_task &task, const FrameView &frame) = 0;
+			virtual void on_request_failed(const in_flight_request &request, uint8_t reason) = 0;
+			virtual void on_frame(uint8_t /*direction*/, const uint8_t * /*data*/, size_t /*size*/) {}
+			virtual void on_exception(uint8_t /*function_code*/, uint8_t /*exception_code*/) {}
+			virtual void on_unmatched_response(uint16_t /*transaction_id*/) {}
+		};
+
+		// Queues read and write tasks by priority, sends them through a transport and matches the responses. It keeps
+		// as many requests in flight as the transport allows and fails them on timeout, exception or disconnect. The
+		// adapter provides the clock, the transport and the sink.
+		class SofarSolar_Poller {
+		public:
+			void set_transport(SofarSolar_Transport *transport);
+			void set_sink(SofarSolar_Sink *sink) { this->sink_ = sink; }
+			void set_clock(uint32_t (*clock)()) { this->clock_ = clock; }
+			void set_modbus_address(uint8_t modbus_address) { this->modbus_address_ = modbus_address; }
+			SofarSolar_Transport *get_transport() const { return this->transport_; }
+
+			void queue_read(const register_read_task &task) { this->read_queue_.push(task); }
+			void queue_write(const register_write_task &task) { this->write_queue_.push(task); }
+			size_t get_read_queue_size() const { return this->read_queue_.size(); }
+			size_t get_write_queue_size() const { return this->write_queue_.size(); }
+			size_t get_in_flight_count() const { return this->in_flight_.size(); }
+			// Smoothed time in milliseconds from request to response, 0 before the first response. Safe to read from another thread.
+			uint32_t get_average_round_trip() const { return this->average_round_trip_.load(std::memory_order_relaxed); }
+
+			// Delays the next request by the request gap of the transport
+			void restart_gap() { this->last_operation_ = this->clock_(); }
+
+			void loop();
+			void handle_response(uint16_t transaction_id, const std::vector<uint8_t> &data);
+			void handle_error(uint16_t transaction_id, uint8_t function_code, uint8_t exception_code);
+			void fail_all(uint8_t reason);
+
+			uint16_t read_registers(uint16_t start_address, uint16_t register_count);
+			uint16_t write_registers(uint16_t start_address, uint16_t register_count, const std::vector<uint8_t> &data);
+			uint16_t write_read_registers(uint16_t read_start_address, uint16_t read_register_count, uint16_t write_start_address, uint16_t write_register_count, const std::vector<uint8_t> &data);
+
+		protected:
+			uint16_t send_frame(const std::vector<uint8_t> &frame);
+			std::deque<in_flight_request>::iterator find_request(uint16_t transaction_id);
+			void add_round_trip(uint32_t round_trip);
+
+			SofarSolar_Transport *transport_ = nullptr;
+			SofarSolar_Sink *sink_ = nullptr;
+			uint32_t (*clock_)() = nullptr;
+			uint8_t modbus_address_ = 1;
+			uint32_t last_operation_ = 0; // Time in milliseconds of the last request or response
+			std::priority_queue<register_read_task> read_queue_; // Priority queue for register read tasks
+			std::priority_queue<register_write_task> write_queue_; // Priority queue for register write tasks
+			std::deque<in_flight_request> in_flight_; // Requests sent and not answered yet, oldest first
+			std::atomic<uint32_t> average_round_trip_{0}; // Smoothed round trip time in milliseconds
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,49 @@
+#include "sofarsolar_registers.h"
+#include "cmath"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		const std::map<uint16_t, uint8_t> &G3_address_index() {
+			// Register keys ordered by start address, built once on first use. The initialization of a local static is
+			// thread safe, the I/O task and the main loop may both build decode plans first.
+			static const std::map<uint16_t, uint8_t> index = [] {
+				std::map<uint16_t, uint8_t> by_address;
+				for (const auto &reg : G3_registers) {
+					by_address[reg.second.start_address] = reg.first;
+				}
+				return by_address;
+			}();
+			return index;
+		}
+
+		void build_decode_plan(uint16_t start_address, uint16_t register_count, SofarSolar_DecodePlan &plan) {
+			const std::map<uint16_t, uint8_t> &address_index = G3_address_index();
+			uint32_t end_address = start_address + register_count;
+			for (auto it = address_index.lower_bound(start_address); it != address_index.end() && it->first < end_address; ++it) {
+				const SofarSolar_Register &reg = G3_registers.at(it->second);
+				if (reg.start_address + reg.register_count > end_address) {
+					continue; // Register only partially covered by the read
+				}
+				uint16_t offset = (reg.start_address - start_address) * 2;
+				switch (reg.type) {
+				case U_WORD:
+				case S_WORD:
+				case U_DWORD:
+				case S_DWORD:
+					plan.numeric.push_back(DecodeDescriptor{offset, static_cast<uint8_t>(reg.type == U_DWORD || reg.type == S_DWORD ? 2 : 1), reg.type == S_WORD || reg.type == S_DWORD, get_power_of_ten(reg.scale), static_cast<uint8_t>(plan.registers.size())});
+					break;
+				case ASCII:
+				case ENUM:
+				case BITMAP:
+					break;
+				default:
+					continue; // Unsupported register type
+				}
+				plan.registers.push_back(SofarSolar_DecodeEntry{it->second, offset, reg.register_count, reg.type, false});
+			}
+			plan.values.resize(plan.registers.size(), NAN);
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
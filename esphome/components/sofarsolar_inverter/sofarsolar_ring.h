@@ -0,0 +1,45 @@
+#pragma once
+#include "atomic"
+#include "cstddef"
+#include "utility"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Lock-free ring buffer for exactly one producer and one consumer thread. One slot stays empty to tell a
+		// full ring from an empty one, so the ring holds Size - 1 elements.
+		template<typename T, size_t Size> class SofarSolar_SpscRing {
+		public:
+			// Producer only, returns false and leaves the value untouched if the ring is full
+			bool push(T &&value) {
+				size_t head = this->head_.load(std::memory_order_relaxed);
+				size_t next = (head + 1) % Size;
+				if (next == this->tail_.load(std::memory_order_acquire)) {
+					return false;
+				}
+				this->slots_[head] = std::move(value);
+				this->head_.store(next, std::memory_order_release); // Publish the slot after it is written
+				return true;
+			}
+
+			// Consumer only, returns false if the ring is empty
+			bool pop(T &value) {
+				size_t tail = this->tail_.load(std::memory_order_relaxed);
+				if (tail == this->head_.load(std::memory_order_acquire)) {
+					return false;
+				}
+				value = std::move(this->slots_[tail]);
+				this->tail_.store((tail + 1) % Size, std::memory_order_release); // Hand the slot back after it is read
+				return true;
+			}
+
+			bool empty() const { return this->tail_.load(std::memory_order_acquire) == this->head_.load(std::memory_order_acquire); }
+
+		protected:
+			T slots_[Size];
+			std::atomic<size_t> head_{0}; // Next slot written by the producer
+			std::atomic<size_t> tail_{0}; // Next slot read by the consumer
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
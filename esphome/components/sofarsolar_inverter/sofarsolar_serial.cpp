@@ -0,0 +1,90 @@
+#ifdef __linux__
+#include "sofarsolar_serial.h"
+#include "fcntl.h"
+#include "termios.h"
+#include "unistd.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		static speed_t baud_rate_to_speed(uint32_t baud_rate) {
+			switch (baud_rate) {
+				case 1200: return B1200;
+				case 2400: return B2400;
+				case 4800: return B4800;
+				case 19200: return B19200;
+				case 38400: return B38400;
+				case 57600: return B57600;
+				case 115200: return B115200;
+				default: return B9600;
+			}
+		}
+
+		SofarSolar_SerialTransport::~SofarSolar_SerialTransport() {
+			this->close();
+		}
+
+		bool SofarSolar_SerialTransport::open() {
+			this->close();
+			this->fd_ = ::open(this->device_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+			if (this->fd_ < 0) {
+				return false;
+			}
+			struct termios options;
+			if (tcgetattr(this->fd_, &options) != 0) {
+				this->close();
+				return false;
+			}
+			cfmakeraw(&options);
+			options.c_cflag |= CLOCAL | CREAD;
+			options.c_cflag &= ~(PARENB | CSTOPB | CSIZE);
+			options.c_cflag |= CS8;
+			cfsetispeed(&options, baud_rate_to_speed(this->baud_rate_));
+			cfsetospeed(&options, baud_rate_to_speed(this->baud_rate_));
+			if (tcsetattr(this->fd_, TCSANOW, &options) != 0) {
+				this->close();
+				return false;
+			}
+			tcflush(this->fd_, TCIOFLUSH);
+			return true;
+		}
+
+		void SofarSolar_SerialTransport::close() {
+			if (this->fd_ >= 0) {
+				::close(this->fd_);
+				this->fd_ = -1;
+				if (this->on_disconnect) {
+					this->on_disconnect();
+				}
+			}
+			this->rx_buffer_.clear();
+		}
+
+		void SofarSolar_SerialTransport::loop() {
+			if (this->fd_ < 0) {
+				return;
+			}
+			uint8_t buffer[128];
+			ssize_t received;
+			while ((received = ::read(this->fd_, buffer, sizeof(buffer))) > 0) {
+				this->rx_buffer_.insert(this->rx_buffer_.end(), buffer, buffer + received);
+			}
+			parse_rtu_frames(*this, this->rx_buffer_);
+		}
+
+		bool SofarSolar_SerialTransport::send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) {
+			transaction_id = 0;
+			if (this->fd_ < 0) {
+				return false;
+			}
+			std::vector<uint8_t> packet = frame;
+			uint16_t crc = rtu_crc16(frame.data(), frame.size());
+			packet.push_back(crc & 0xFF);
+			packet.push_back(crc >> 8);
+			this->rx_buffer_.clear(); // Drop anything left over from a previous, timed out request
+			return ::write(this->fd_, packet.data(), packet.size()) == static_cast<ssize_t>(packet.size());
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
+#endif
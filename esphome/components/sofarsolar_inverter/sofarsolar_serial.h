@@ -0,0 +1,37 @@
+#pragma once
+#ifdef __linux__
+#include "string"
+#include "vector"
+#include "sofarsolar_transport.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Modbus RTU transport over a Linux serial device or pty, for running the poller as a Linux process.
+		// The device is opened non-blocking, loop() has to be called regularly to receive the responses.
+		class SofarSolar_SerialTransport : public SofarSolar_Transport {
+		public:
+			SofarSolar_SerialTransport(const std::string &device, uint32_t baud_rate, uint32_t timeout = 500) : device_(device), baud_rate_(baud_rate), timeout_(timeout) {}
+			~SofarSolar_SerialTransport() override;
+
+			// Opens and configures the device for 8N1 raw mode, returns false if that failed
+			bool open();
+			void close();
+
+			void loop() override;
+			bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override;
+			bool is_connected() const override { return this->fd_ >= 0; }
+			uint32_t get_timeout() const override { return this->timeout_; }
+			uint32_t get_request_gap() const override { return 150; }
+
+		protected:
+			std::string device_;
+			uint32_t baud_rate_;
+			uint32_t timeout_;
+			int fd_ = -1;
+			std::vector<uint8_t> rx_buffer_; // Received bytes not yet parsed into a frame
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
+#endif
@@ -0,0 +1,124 @@
+#include "sofarsolar_simulation.h"
+#include "algorithm"
+#include "cmath"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		void SofarSolar_LoadProfile::add_step(uint32_t time, float power) {
+			this->points_.emplace_back(time, this->power_at(time)); // The previous level holds until the step
+			this->points_.emplace_back(time, power);
+			this->steps_.emplace_back(time, time);
+		}
+
+		void SofarSolar_LoadProfile::add_ramp(uint32_t time, uint32_t duration, float power) {
+			this->points_.emplace_back(time, this->power_at(time));
+			this->points_.emplace_back(time + duration, power);
+			this->steps_.emplace_back(time, time + duration);
+		}
+
+		float SofarSolar_LoadProfile::power_at(uint32_t time) const {
+			auto next = std::upper_bound(this->points_.begin(), this->points_.end(), time, [](uint32_t value, const std::pair<uint32_t, float> &point) { return value < point.first; });
+			if (next == this->points_.begin()) {
+				return next->second;
+			}
+			auto previous = std::prev(next);
+			if (next == this->points_.end()) {
+				return previous->second;
+			}
+			float share = static_cast<float>(time - previous->first) / (next->first - previous->first);
+			return previous->second + (next->second - previous->second) * share;
+		}
+
+		SofarSolar_SimulationReport SofarSolar_ZeroExportSimulation::run(uint32_t duration) {
+			SofarSolar_SimulationReport report;
+			this->grid_trace_.clear();
+			float output = 0; // Power the inverter delivers
+			int limit = this->initial_limit_; // Export limit the inverter applies
+			int last_written = -1;
+			float meter_value = NAN; // Last grid power the controller received, none before the first sample arrived
+			uint32_t next_sample = 0;
+			uint32_t next_control = this->control_interval_;
+			std::deque<std::pair<uint32_t, int>> pending_limits; // Writes on their way to the inverter, by the time they apply
+			std::deque<std::pair<uint32_t, float>> output_history; // Output by time, for the delayed power the inverter reports
+			std::deque<std::pair<uint32_t, float>> meter_samples; // Samples on their way to the controller, by the time they arrive
+			for (uint32_t time = 0; time <= duration; time += this->time_step_) {
+				while (!pending_limits.empty() && pending_limits.front().first <= time) {
+					limit = pending_limits.front().second;
+					pending_limits.pop_front();
+				}
+				// The output follows the limit with the ramp rate, as far as the available power allows
+				float target = std::min(this->inverter_.available_power_w, limit * this->inverter_.max_output_power_w / 1000.0f);
+				float max_change = this->inverter_.ramp_rate_w_per_s * this->time_step_ / 1000.0f;
+				output += std::max(-max_change, std::min(max_change, target - output));
+				output_history.emplace_back(time, output);
+				while (output_history.size() > 1 && output_history[1].first + this->inverter_.measurement_delay_ms <= time) {
+					output_history.pop_front();
+				}
+				float reported_output = output_history.front().second;
+
+				float grid = this->load_.power_at(time) - output;
+				this->grid_trace_.push_back(grid);
+				float energy = std::fabs(grid) * this->time_step_ / 3600000.0f;
+				if (grid < 0) {
+					report.exported_energy_wh += energy;
+					report.max_export_w = std::max(report.max_export_w, -grid);
+				} else {
+					report.imported_energy_wh += energy;
+				}
+
+				if (time >= next_sample) {
+					meter_samples.emplace_back(time + this->meter_.latency_ms, grid);
+					next_sample += this->meter_.sample_period_ms;
+				}
+				while (!meter_samples.empty() && meter_samples.front().first <= time) {
+					meter_value = meter_samples.front().second;
+					meter_samples.pop_front();
+				}
+
+				// The same control law and cadence as SofarSolar_Inverter::update_zero_export()
+				if (time >= next_control) {
+					next_control += this->control_interval_;
+					if (!std::isnan(meter_value)) {
+						int new_limit = zero_export_limit(zero_export_target(reported_output, meter_value), this->inverter_.max_output_power_w);
+						report.writes++;
+						if (new_limit != last_written) {
+							report.limit_changes++;
+						}
+						last_written = new_limit;
+						pending_limits.emplace_back(time + this->inverter_.command_delay_ms, new_limit);
+					}
+				}
+			}
+
+			// A step is settled from the last time step outside of the band before the next load change or the end
+			const std::vector<std::pair<uint32_t, uint32_t>> &steps = this->load_.get_steps();
+			for (size_t i = 0; i < steps.size(); i++) {
+				size_t first = steps[i].second / this->time_step_;
+				size_t end = std::min(this->grid_trace_.size(), i + 1 < steps.size() ? static_cast<size_t>(steps[i + 1].first / this->time_step_) : this->grid_trace_.size());
+				if (first >= end) {
+					continue;
+				}
+				size_t last_outside = first;
+				bool outside = false;
+				for (size_t index = end; index > first; index--) {
+					if (std::fabs(this->grid_trace_[index - 1]) > this->settling_band_) {
+						last_outside = index - 1;
+						outside = true;
+						break;
+					}
+				}
+				if (!outside) {
+					continue;
+				}
+				if (last_outside == end - 1) {
+					report.unsettled_steps++;
+					continue;
+				}
+				report.settling_time_ms = std::max<uint32_t>(report.settling_time_ms, (last_outside + 1 - first) * this->time_step_);
+			}
+			return report;
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
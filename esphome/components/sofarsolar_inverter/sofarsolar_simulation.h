@@ -0,0 +1,85 @@
+#pragma once
+#include "vector"
+#include "deque"
+#include "utility"
+#include "cstdint"
+#include "sofarsolar_zero_export.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Load of the site over time, piecewise linear between its points. Steps, ramps and recorded traces are
+		// all added as points, a step is two points at the same time.
+		class SofarSolar_LoadProfile {
+		public:
+			explicit SofarSolar_LoadProfile(float initial_power = 0) { this->points_.emplace_back(0, initial_power); }
+
+			// Changes the load at once, the change counts as a step for the settling time
+			void add_step(uint32_t time, float power);
+			// Changes the load linearly over the duration, the end of the ramp counts as a step for the settling time
+			void add_ramp(uint32_t time, uint32_t duration, float power);
+			// Adds one point of a recorded trace, the points have to be added in time order
+			void add_point(uint32_t time, float power) { this->points_.emplace_back(time, power); }
+
+			float power_at(uint32_t time) const;
+			const std::vector<std::pair<uint32_t, uint32_t>> &get_steps() const { return this->steps_; }
+
+		protected:
+			std::vector<std::pair<uint32_t, float>> points_; // Time in milliseconds and load in W
+			std::vector<std::pair<uint32_t, uint32_t>> steps_; // Times in milliseconds a load change starts and the load reaches its new level
+		};
+
+		struct SofarSolar_SimulatedInverter {
+			uint16_t max_output_power_w = 6000; // Rated power, the export limit is relative to it
+			float available_power_w = 6000; // Power the PV and battery can deliver
+			float ramp_rate_w_per_s = 600; // Speed the output follows a new limit with
+			uint32_t command_delay_ms = 300; // Time from sending the write until the inverter applies the limit
+			uint32_t measurement_delay_ms = 500; // Age of the power the inverter reports in its registers
+		};
+
+		struct SofarSolar_SimulatedMeter {
+			uint32_t sample_period_ms = 1000; // Time between two samples of the grid meter
+			uint32_t latency_ms = 200; // Time from sampling until the value reaches the controller
+		};
+
+		struct SofarSolar_SimulationReport {
+			float exported_energy_wh = 0; // Energy fed into the grid
+			float imported_energy_wh = 0; // Energy drawn from the grid
+			float max_export_w = 0; // Highest power fed into the grid, the overshoot of the control
+			uint32_t settling_time_ms = 0; // Longest time after a step until the grid power stayed within the band
+			uint32_t unsettled_steps = 0; // Steps after which the grid power never stayed within the band
+			uint32_t writes = 0; // Export limit writes sent to the inverter
+			uint32_t limit_changes = 0; // Writes that changed the export limit
+		};
+
+		// Runs the zero export control law of the inverter against a model of the inverter, the grid meter and the
+		// load, in fixed time steps and without real time. The controller sees the meter value and the reported
+		// inverter power with their delays and updates the export limit every ZERO_EXPORT_INTERVAL, like the
+		// inverter component does.
+		class SofarSolar_ZeroExportSimulation {
+		public:
+			SofarSolar_ZeroExportSimulation(const SofarSolar_SimulatedInverter &inverter, const SofarSolar_SimulatedMeter &meter, const SofarSolar_LoadProfile &load) : inverter_(inverter), meter_(meter), load_(load) {}
+
+			void set_time_step(uint32_t time_step) { this->time_step_ = time_step; }
+			void set_control_interval(uint32_t control_interval) { this->control_interval_ = control_interval; }
+			void set_settling_band(float settling_band) { this->settling_band_ = settling_band; }
+			void set_initial_limit(int initial_limit) { this->initial_limit_ = initial_limit; }
+
+			// Simulates the given time in milliseconds from the start of the load profile
+			SofarSolar_SimulationReport run(uint32_t duration);
+			// Grid power in W at every time step of the last run, positive when drawn from the grid
+			const std::vector<float> &get_grid_trace() const { return this->grid_trace_; }
+
+		protected:
+			SofarSolar_SimulatedInverter inverter_;
+			SofarSolar_SimulatedMeter meter_;
+			SofarSolar_LoadProfile load_;
+			uint32_t time_step_ = 10; // Resolution of the simulation in milliseconds
+			uint32_t control_interval_ = ZERO_EXPORT_INTERVAL;
+			float settling_band_ = 50; // Grid power in W around 0 counted as settled
+			int initial_limit_ = 0; // Export limit in 0.1 % at the start
+			std::vector<float> grid_trace_;
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,146 @@
+#include "sofarsolar_tcp.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+		static const char *TAG = "sofarsolar_inverter.tcp";
+
+		static const uint32_t TCP_CONNECT_TIMEOUT = 5000; // Time in milliseconds to wait for a connection
+		static const uint32_t TCP_RECONNECT_DELAY = 5000; // Time in milliseconds to wait before reconnecting
+
+		void SofarSolar_TcpTransport::loop() {
+			if (this->state_ == TCP_DISCONNECTED) {
+				if (millis() - this->state_since_ >= TCP_RECONNECT_DELAY) {
+					this->connect();
+				}
+				return;
+			}
+			if (this->state_ == TCP_CONNECTING) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				if (this->socket_->getsockopt(SOL_SOCKET, SO_ERROR, &error, &length) != 0 || (error != 0 && error != EINPROGRESS)) {
+					ESP_LOGW(TAG, "Connection to %s:%u failed: %d", this->host_.c_str(), this->port_, error);
+					this->disconnect();
+					return;
+				}
+				struct sockaddr_storage peer;
+				socklen_t peer_length = sizeof(peer);
+				if (this->socket_->getpeername(reinterpret_cast<struct sockaddr *>(&peer), &peer_length) == 0) {
+					ESP_LOGI(TAG, "Connected to %s:%u", this->host_.c_str(), this->port_);
+					this->state_ = TCP_CONNECTED;
+					this->state_since_ = millis();
+				} else if (millis() - this->state_since_ >= TCP_CONNECT_TIMEOUT) {
+					ESP_LOGW(TAG, "Connection to %s:%u timed out", this->host_.c_str(), this->port_);
+					this->disconnect();
+				}
+				return;
+			}
+			uint8_t buffer[128];
+			while (true) {
+				ssize_t received = this->socket_->read(buffer, sizeof(buffer));
+				if (received > 0) {
+					this->rx_buffer_.insert(this->rx_buffer_.end(), buffer, buffer + received);
+					continue;
+				}
+				if (received == 0) {
+					ESP_LOGW(TAG, "Connection closed by %s:%u", this->host_.c_str(), this->port_);
+					this->disconnect();
+					return;
+				}
+				if (errno != EWOULDBLOCK && errno != EAGAIN) {
+					ESP_LOGW(TAG, "Receiving from %s:%u failed: %d", this->host_.c_str(), this->port_, errno);
+					this->disconnect();
+					return;
+				}
+				break;
+			}
+			this->parse_buffer();
+		}
+
+		bool SofarSolar_TcpTransport::send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) {
+			if (this->state_ != TCP_CONNECTED) {
+				return false;
+			}
+			std::vector<uint8_t> packet;
+			if (this->protocol_ == TCP_PROTOCOL_MODBUS_TCP) {
+				// MBAP header: transaction id, protocol id 0, length of unit id and PDU
+				transaction_id = ++this->next_transaction_id_;
+				packet = {static_cast<uint8_t>(transaction_id >> 8), static_cast<uint8_t>(transaction_id & 0xFF), 0x00, 0x00, static_cast<uint8_t>(frame.size() >> 8), static_cast<uint8_t>(frame.size() & 0xFF)};
+				packet.insert(packet.end(), frame.begin(), frame.end());
+			} else {
+				if (!this->rx_buffer_.empty()) {
+					// Nothing is outstanding, the bytes belong to a response that already timed out
+					ESP_LOGW(TAG, "Discarding %u bytes of a late response", static_cast<unsigned>(this->rx_buffer_.size()));
+					this->rx_buffer_.clear();
+				}
+				transaction_id = 0;
+				packet = frame;
+				uint16_t crc = rtu_crc16(frame.data(), frame.size());
+				packet.push_back(crc & 0xFF);
+				packet.push_back(crc >> 8);
+			}
+			ssize_t sent = this->socket_->write(packet.data(), packet.size());
+			if (sent != static_cast<ssize_t>(packet.size())) {
+				ESP_LOGW(TAG, "Sending to %s:%u failed: %d", this->host_.c_str(), this->port_, errno);
+				this->disconnect();
+				return false;
+			}
+			return true;
+		}
+
+		void SofarSolar_TcpTransport::connect() {
+			this->state_since_ = millis();
+			this->rx_buffer_.clear();
+			this->socket_ = socket::socket_ip(SOCK_STREAM, 0);
+			if (this->socket_ == nullptr) {
+				ESP_LOGW(TAG, "Could not create socket");
+				return;
+			}
+			this->socket_->setblocking(false);
+			int enable = 1;
+			this->socket_->setsockopt(IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+			struct sockaddr_storage address;
+			socklen_t address_length = socket::set_sockaddr(reinterpret_cast<struct sockaddr *>(&address), sizeof(address), this->host_, this->port_);
+			if (address_length == 0) {
+				ESP_LOGE(TAG, "Invalid gateway address %s", this->host_.c_str());
+				this->socket_ = nullptr;
+				return;
+			}
+			if (this->socket_->connect(reinterpret_cast<struct sockaddr *>(&address), address_length) != 0 && errno != EINPROGRESS) {
+				ESP_LOGW(TAG, "Connecting to %s:%u failed: %d", this->host_.c_str(), this->port_, errno);
+				this->socket_ = nullptr;
+				return;
+			}
+			ESP_LOGD(TAG, "Connecting to %s:%u", this->host_.c_str(), this->port_);
+			this->state_ = TCP_CONNECTING;
+		}
+
+		void SofarSolar_TcpTransport::disconnect() {
+			if (this->socket_ != nullptr) {
+				this->socket_->close();
+				this->socket_ = nullptr;
+			}
+			this->rx_buffer_.clear();
+			this->state_ = TCP_DISCONNECTED;
+			this->state_since_ = millis();
+			if (this->on_disconnect) {
+				this->on_disconnect(); // Outstanding requests will not be answered anymore
+			}
+		}
+
+		void SofarSolar_TcpTransport::parse_buffer() {
+			size_t discarded;
+			if (this->protocol_ == TCP_PROTOCOL_MODBUS_TCP) {
+				discarded = parse_mbap_frames(*this, this->rx_buffer_, this->unit_id_);
+			} else {
+				discarded = parse_rtu_frames(*this, this->rx_buffer_, this->unit_id_);
+			}
+			if (discarded > 0) {
+				ESP_LOGW(TAG, "Discarded %u bytes of invalid frames or of responses of other units than %u", static_cast<unsigned>(discarded), this->unit_id_);
+			}
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
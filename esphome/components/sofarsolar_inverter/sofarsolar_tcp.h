@@ -0,0 +1,62 @@
+#pragma once
+#include "vector"
+#include "string"
+#include "memory"
+#include "esphome/components/socket/socket.h"
+#include "sofarsolar_transport.h"
+
+#define TCP_PROTOCOL_MODBUS_TCP 0x01
+#define TCP_PROTOCOL_RTU_OVER_TCP 0x02
+
+#define TCP_DISCONNECTED 0
+#define TCP_CONNECTING 1
+#define TCP_CONNECTED 2
+
+#define TCP_RTU_REQUEST_GAP 50 // Time in milliseconds between two RTU over TCP requests, a late response arrives in it
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Transport to a RS485 to Ethernet gateway. Requests are sent as Modbus TCP frames with a MBAP header or as
+		// raw RTU frames with CRC.
+		class SofarSolar_TcpTransport : public SofarSolar_Transport {
+		public:
+			SofarSolar_TcpTransport(const std::string &host, uint16_t port, uint8_t protocol, uint8_t max_outstanding, uint32_t timeout) : host_(host), port_(port), protocol_(protocol), max_outstanding_(max_outstanding), timeout_(timeout) {}
+
+			void loop() override;
+			bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override;
+			bool is_connected() const override { return this->state_ == TCP_CONNECTED; }
+
+			// Responses of RTU over TCP have no transaction id. Only one request is outstanding, so a late response
+			// cannot be taken for the response of the next request.
+			bool has_transaction_ids() const override { return this->protocol_ == TCP_PROTOCOL_MODBUS_TCP; }
+			uint8_t get_max_outstanding() const override { return this->protocol_ == TCP_PROTOCOL_MODBUS_TCP ? this->max_outstanding_ : 1; }
+			uint32_t get_timeout() const override { return this->timeout_; }
+			uint32_t get_request_gap() const override { return this->protocol_ == TCP_PROTOCOL_MODBUS_TCP ? 0 : TCP_RTU_REQUEST_GAP; }
+			const std::string &get_host() const { return this->host_; }
+			uint16_t get_port() const { return this->port_; }
+			uint8_t get_protocol() const { return this->protocol_; }
+			// Responses of other units behind the gateway are discarded
+			void set_unit_id(uint8_t unit_id) { this->unit_id_ = unit_id; }
+
+		protected:
+			void connect();
+			void disconnect();
+			void parse_buffer();
+
+			std::string host_;
+			uint16_t port_;
+			uint8_t protocol_;
+			uint8_t max_outstanding_;
+			uint32_t timeout_;
+			uint8_t unit_id_ = 1;
+
+			std::unique_ptr<socket::Socket> socket_;
+			uint8_t state_ = TCP_DISCONNECTED;
+			uint32_t state_since_ = 0; // Time in milliseconds of the last state change
+			uint16_t next_transaction_id_ = 0;
+			std::vector<uint8_t> rx_buffer_; // Received bytes not yet parsed into a frame
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
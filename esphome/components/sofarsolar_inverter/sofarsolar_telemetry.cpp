@@ -0,0 +1,111 @@
+#include "sofarsolar_telemetry.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		static uint64_t zigzag_encode(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+		static int64_t zigzag_decode(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+		static void put_uint32(uint8_t *data, uint32_t value) {
+			data[0] = value >> 24;
+			data[1] = value >> 16;
+			data[2] = value >> 8;
+			data[3] = value;
+		}
+
+		static uint32_t get_uint32(const uint8_t *data) {
+			return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+		}
+
+		static bool get_varint(const uint8_t *data, size_t size, size_t &offset, uint64_t &value) {
+			value = 0;
+			for (uint8_t shift = 0; shift < 64; shift += 7) {
+				if (offset >= size) {
+					return false;
+				}
+				uint8_t byte = data[offset++];
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool SofarSolar_TelemetryEncoder::add(uint8_t channel, uint32_t timestamp, int32_t value) {
+			if (channel >= TELEMETRY_MAX_CHANNELS) {
+				return true; // Not streamed, nothing to send for it
+			}
+			if (this->size_ == 0) {
+				// The header is written with the first sample, the count is updated with every sample
+				this->buffer_[0] = TELEMETRY_MAGIC_0;
+				this->buffer_[1] = TELEMETRY_MAGIC_1;
+				this->buffer_[2] = TELEMETRY_VERSION;
+				this->buffer_[3] = 0;
+				put_uint32(this->buffer_ + 4, this->sequence_);
+				put_uint32(this->buffer_ + 8, timestamp);
+				this->size_ = TELEMETRY_HEADER_SIZE;
+				this->start_ = timestamp;
+				this->last_timestamp_ = timestamp;
+			}
+			if (this->size_ + TELEMETRY_MAX_SAMPLE > TELEMETRY_MAX_PACKET || this->count_ == UINT16_MAX) {
+				return false;
+			}
+			this->buffer_[this->size_++] = channel;
+			this->put_varint(timestamp - this->last_timestamp_);
+			this->put_varint(zigzag_encode(static_cast<int64_t>(value) - this->last_values_[channel]));
+			this->last_timestamp_ = timestamp;
+			this->last_values_[channel] = value;
+			this->count_++;
+			this->buffer_[12] = this->count_ >> 8;
+			this->buffer_[13] = this->count_ & 0xFF;
+			return true;
+		}
+
+		void SofarSolar_TelemetryEncoder::reset() {
+			this->size_ = 0;
+			this->count_ = 0;
+			this->sequence_++;
+			for (int32_t &last_value : this->last_values_) {
+				last_value = 0;
+			}
+		}
+
+		void SofarSolar_TelemetryEncoder::put_varint(uint64_t value) {
+			while (value >= 0x80) {
+				this->buffer_[this->size_++] = static_cast<uint8_t>(value) | 0x80;
+				value >>= 7;
+			}
+			this->buffer_[this->size_++] = static_cast<uint8_t>(value);
+		}
+
+		bool decode_telemetry_packet(const uint8_t *data, size_t size, uint32_t &sequence, std::vector<SofarSolar_TelemetrySample> &samples) {
+			if (size < TELEMETRY_HEADER_SIZE || data[0] != TELEMETRY_MAGIC_0 || data[1] != TELEMETRY_MAGIC_1 || data[2] != TELEMETRY_VERSION) {
+				return false;
+			}
+			sequence = get_uint32(data + 4);
+			uint32_t timestamp = get_uint32(data + 8);
+			uint16_t count = (static_cast<uint16_t>(data[12]) << 8) | data[13];
+			int32_t last_values[TELEMETRY_MAX_CHANNELS] = {};
+			size_t offset = TELEMETRY_HEADER_SIZE;
+			samples.clear();
+			samples.reserve(count);
+			for (uint16_t i = 0; i < count; i++) {
+				uint64_t time_delta;
+				uint64_t value_delta;
+				if (offset >= size) {
+					return false;
+				}
+				uint8_t channel = data[offset++];
+				if (channel >= TELEMETRY_MAX_CHANNELS || !get_varint(data, size, offset, time_delta) || !get_varint(data, size, offset, value_delta)) {
+					return false;
+				}
+				timestamp += time_delta;
+				last_values[channel] = static_cast<int32_t>(last_values[channel] + zigzag_decode(value_delta));
+				samples.push_back(SofarSolar_TelemetrySample{channel, timestamp, last_values[channel]});
+			}
+			return offset == size;
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,59 @@
+#pragma once
+#include "vector"
+#include "cstddef"
+#include "cstdint"
+
+#define TELEMETRY_MAGIC_0 'S'
+#define TELEMETRY_MAGIC_1 'T'
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 14
+#define TELEMETRY_MAX_PACKET 1400 // Bytes of one packet, fits into one UDP datagram on Ethernet and WiFi
+#define TELEMETRY_MAX_SAMPLE 16 // Bytes of one sample in the worst case: channel, timestamp and value varints
+#define TELEMETRY_MAX_CHANNELS 32
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		struct SofarSolar_TelemetrySample {
+			uint8_t channel; // Index of the register in the configured telemetry list
+			uint32_t timestamp; // Time in milliseconds the value was received
+			int32_t value; // Raw register value without scaling
+		};
+
+		// Encodes raw register samples into packets of a fixed size buffer. A packet starts with a 14 byte header of
+		// magic "ST", version, a reserved byte, the sequence number, the timestamp of the first sample and the sample
+		// count, all big endian. Each sample follows as channel byte, the time since the previous sample as varint and
+		// the change against the previous value of its channel as zigzag varint. The first value of a channel in a
+		// packet is encoded against 0, so every packet can be decoded on its own and a lost packet only loses its
+		// own samples.
+		class SofarSolar_TelemetryEncoder {
+		public:
+			// Returns false if the sample does not fit anymore, the packet has to be sent and reset first
+			bool add(uint8_t channel, uint32_t timestamp, int32_t value);
+			// Starts the next packet with the next sequence number
+			void reset();
+
+			bool empty() const { return this->count_ == 0; }
+			uint16_t get_count() const { return this->count_; }
+			uint32_t get_sequence() const { return this->sequence_; }
+			uint32_t get_start() const { return this->start_; }
+			const uint8_t *data() const { return this->buffer_; }
+			size_t size() const { return this->size_; }
+
+		protected:
+			void put_varint(uint64_t value);
+
+			uint8_t buffer_[TELEMETRY_MAX_PACKET];
+			size_t size_ = 0; // Bytes used in the buffer, 0 until the first sample wrote the header
+			uint16_t count_ = 0;
+			uint32_t sequence_ = 0; // Sequence number of the packet in the buffer
+			uint32_t start_ = 0; // Timestamp of the first sample in the packet
+			uint32_t last_timestamp_ = 0;
+			int32_t last_values_[TELEMETRY_MAX_CHANNELS] = {};
+		};
+
+		// Decodes a packet of SofarSolar_TelemetryEncoder, for listeners on a host. Returns false if the packet is malformed.
+		bool decode_telemetry_packet(const uint8_t *data, size_t size, uint32_t &sequence, std::vector<SofarSolar_TelemetrySample> &samples);
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
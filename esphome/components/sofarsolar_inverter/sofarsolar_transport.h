@@ -0,0 +1,139 @@
+#pragma once
+#include "vector"
+#include "functional"
+#include "cstdint"
+#include "cstddef"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Asynchronous transport of Modbus requests. A request frame consists of the slave address and the PDU without
+		// CRC. Responses are handed back without framing: the register data of a read or a combined write and read,
+		// the address and count of a write.
+		class SofarSolar_Transport {
+		public:
+			virtual ~SofarSolar_Transport() = default;
+
+			virtual void loop() {}
+			virtual bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) = 0;
+			virtual bool is_connected() const { return true; }
+
+			// Transports without transaction ids answer in the order of the requests
+			virtual bool has_transaction_ids() const { return false; }
+			virtual uint8_t get_max_outstanding() const { return 1; }
+			virtual uint32_t get_timeout() const { return 500; }
+			// Minimum time in milliseconds between the end of an operation and the next request
+			virtual uint32_t get_request_gap() const { return 0; }
+
+			std::function<void(uint16_t transaction_id, const std::vector<uint8_t> &data)> on_data;
+			std::function<void(uint16_t transaction_id, uint8_t function_code, uint8_t exception_code)> on_error;
+			std::function<void()> on_disconnect;
+		};
+
+		// Modbus RTU CRC, appended low byte first. The CRC over a frame including its CRC is 0.
+		inline uint16_t rtu_crc16(const uint8_t *data, size_t size) {
+			uint16_t crc = 0xFFFF;
+			for (size_t i = 0; i < size; i++) {
+				crc ^= data[i];
+				for (uint8_t bit = 0; bit < 8; bit++) {
+					crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+				}
+			}
+			return crc;
+		}
+
+		// Size of the RTU response frame at the start of the buffer, 0 if not enough bytes are available to tell
+		inline size_t rtu_response_size(const uint8_t *data, size_t available) {
+			if (available < 3) {
+				return 0;
+			}
+			uint8_t function_code = data[1];
+			if (function_code & 0x80) {
+				return 5; // Address, function, exception code and CRC
+			}
+			if (function_code == 0x03 || function_code == 0x04 || function_code == 0x17) {
+				return 5 + data[2]; // Address, function, byte count, data and CRC
+			}
+			return 8; // Address, function, start address, register count and CRC
+		}
+
+		// Hands the PDU of a response to the callbacks of a transport, stripping the byte count of read responses
+		inline void dispatch_response_pdu(SofarSolar_Transport &transport, uint16_t transaction_id, const uint8_t *pdu, size_t size) {
+			if (size == 0) {
+				return;
+			}
+			uint8_t function_code = pdu[0];
+			if (function_code & 0x80) {
+				if (transport.on_error) {
+					transport.on_error(transaction_id, function_code, size > 1 ? pdu[1] : 0);
+				}
+				return;
+			}
+			std::vector<uint8_t> data;
+			if ((function_code == 0x03 || function_code == 0x04 || function_code == 0x17) && size >= 2) {
+				size_t end = 2 + static_cast<size_t>(pdu[1]);
+				data.assign(pdu + 2, pdu + (end < size ? end : size)); // Register data without the byte count
+			} else {
+				data.assign(pdu + 1, pdu + size);
+			}
+			if (transport.on_data) {
+				transport.on_data(transaction_id, data);
+			}
+		}
+
+		// Splits the received RTU byte stream into frames and dispatches the complete ones, the rest stays in the buffer.
+		// A frame with a wrong CRC is skipped one byte at a time to resynchronize. With a unit id other than 0 the frames
+		// of other units are discarded. Returns the number of bytes discarded.
+		inline size_t parse_rtu_frames(SofarSolar_Transport &transport, std::vector<uint8_t> &buffer, uint8_t unit_id = 0) {
+			size_t discarded = 0;
+			while (!buffer.empty()) {
+				size_t frame_size = rtu_response_size(buffer.data(), buffer.size());
+				if (frame_size == 0 || buffer.size() < frame_size) {
+					break;
+				}
+				if (rtu_crc16(buffer.data(), frame_size) != 0) {
+					buffer.erase(buffer.begin()); // Resynchronize on the next byte
+					discarded++;
+					continue;
+				}
+				// The frame leaves the buffer before the callbacks run, they may send, fail requests or disconnect
+				std::vector<uint8_t> frame(buffer.begin(), buffer.begin() + frame_size);
+				buffer.erase(buffer.begin(), buffer.begin() + frame_size);
+				if (unit_id != 0 && frame[0] != unit_id) {
+					discarded += frame_size;
+					continue;
+				}
+				dispatch_response_pdu(transport, 0, frame.data() + 1, frame_size - 3);
+			}
+			return discarded;
+		}
+
+		// Splits the received Modbus TCP byte stream into frames and dispatches the complete ones of the unit with their
+		// transaction id, the rest stays in the buffer. A byte that does not start a valid MBAP header is skipped to
+		// resynchronize, the frames following it are kept. Returns the number of bytes discarded.
+		inline size_t parse_mbap_frames(SofarSolar_Transport &transport, std::vector<uint8_t> &buffer, uint8_t unit_id) {
+			size_t discarded = 0;
+			while (buffer.size() >= 7) {
+				uint16_t length = (static_cast<uint16_t>(buffer[4]) << 8) | buffer[5];
+				if (buffer[2] != 0x00 || buffer[3] != 0x00 || length < 2 || length > 254) {
+					buffer.erase(buffer.begin()); // Protocol id or length invalid, resynchronize on the next byte
+					discarded++;
+					continue;
+				}
+				size_t frame_size = 6 + length;
+				if (buffer.size() < frame_size) {
+					break;
+				}
+				std::vector<uint8_t> frame(buffer.begin(), buffer.begin() + frame_size);
+				buffer.erase(buffer.begin(), buffer.begin() + frame_size);
+				if (frame[6] != unit_id) {
+					discarded += frame_size;
+					continue;
+				}
+				dispatch_response_pdu(transport, (static_cast<uint16_t>(frame[0]) << 8) | frame[1], frame.data() + 7, frame_size - 7);
+			}
+			return discarded;
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
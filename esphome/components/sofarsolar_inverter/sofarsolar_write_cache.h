@@ -0,0 +1,73 @@
+#pragma once
+#include "map"
+#include "vector"
+#include "algorithm"
+#include "cstdint"
+#include "sofarsolar_registers.h"
+
+#define WRITE_GROUP_REFRESH 60000 // Time in milliseconds unchanged values of a write group are not written again, in case the inverter lost them
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		struct SofarSolar_WrittenGroup {
+			uint32_t written; // Time in milliseconds the inverter acknowledged the write
+			std::vector<uint8_t> data; // Register data of the write
+		};
+
+		// Last acknowledged write of each write group, so repeated control writes of the same values do not wear the
+		// EEPROM of the inverter. Command groups are never cached or skipped, every write of them triggers an action.
+		class SofarSolar_WriteCache {
+		public:
+			void store(uint8_t group_key, uint32_t now, const std::vector<uint8_t> &data) {
+				if (!is_command_group(group_key)) {
+					this->groups_[group_key] = SofarSolar_WrittenGroup{now, data};
+				}
+			}
+
+			void forget(uint8_t group_key) { this->groups_.erase(group_key); }
+
+			// Last write of the group younger than WRITE_GROUP_REFRESH, nullptr if none
+			const SofarSolar_WrittenGroup *get(uint8_t group_key, uint32_t now) const {
+				auto written = this->groups_.find(group_key);
+				if (written == this->groups_.end() || now - written->second.written >= WRITE_GROUP_REFRESH) {
+					return nullptr;
+				}
+				return &written->second;
+			}
+
+			// A write of the data can be skipped if it is not forced, the group is no command group and the values
+			// fetched before the write or, without a fetch, the last write already hold the data
+			bool can_skip(uint8_t group_key, const std::vector<uint8_t> &data, const FrameView &current, bool forced, uint32_t now) const {
+				if (forced || is_command_group(group_key)) {
+					return false;
+				}
+				if (current.size() > 0) {
+					return current.size() == data.size() && std::equal(data.begin(), data.end(), current.data());
+				}
+				const SofarSolar_WrittenGroup *written = this->get(group_key, now);
+				return written != nullptr && written->data == data;
+			}
+
+			// Forgets the groups a read returned other values for than written, the inverter lost or changed them
+			void check_read(uint16_t start_address, const FrameView &frame) {
+				uint32_t end_address = start_address + frame.size() / 2;
+				for (auto it = this->groups_.begin(); it != this->groups_.end();) {
+					uint16_t group_start = G3_registers.at(it->first).start_address;
+					uint32_t group_end = group_start + it->second.data.size() / 2;
+					uint32_t first = std::max<uint32_t>(start_address, group_start);
+					uint32_t last = std::min(end_address, group_end);
+					if (first < last && !std::equal(frame.data() + (first - start_address) * 2, frame.data() + (last - start_address) * 2, it->second.data.begin() + (first - group_start) * 2)) {
+						it = this->groups_.erase(it);
+					} else {
+						++it;
+					}
+				}
+			}
+
+		protected:
+			std::map<uint8_t, SofarSolar_WrittenGroup> groups_; // Last acknowledged write by group key
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,28 @@
+#pragma once
+#include "cstdint"
+
+// Control law of the zero export loop, shared by the inverter, the site and the simulation.
+
+#define ZERO_EXPORT_OFFSET 10 // Power in W added to the consumption seen at the grid meter
+#define ZERO_EXPORT_INTERVAL 1000 // Time in milliseconds between two updates of the export limit
+#define ZERO_EXPORT_LIMIT_SPEED 1 // Value written to the active power limit speed register with every update
+#define ZERO_EXPORT_METER_MAX_AGE 5000 // Default time in milliseconds after which a grid meter reading is too old to control on
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Power in W the inverter has to deliver to cover what the grid meter shows on top of its current power.
+		// Positive grid power is drawn from the grid.
+		inline float zero_export_target(float inverter_power, float grid_power) { return inverter_power + grid_power + ZERO_EXPORT_OFFSET; }
+
+		// Export limit in 0.1 % of the rated power for the target power, truncated and clamped to 0 to 100 %
+		inline int zero_export_limit(float target_power, uint16_t max_output_power) {
+			int percentage = target_power * 1000 / max_output_power;
+			if (percentage < 0) {
+				return 0;
+			}
+			return percentage > 1000 ? 1000 : percentage;
+		}
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
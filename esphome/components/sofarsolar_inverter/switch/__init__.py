@@ -4,7 +4,6 @@ import esphome.config_validation as cv
 
 from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA, sofarsolar_inverter_ns
 
-DEPENDENCIES = ["modbus"]
 
 CONF_BATTERY_CHARGE_ONLY = "battery_charge_only"
 CONF_BATTERY_DISCHARGE_ONLY = "battery_discharge_only"
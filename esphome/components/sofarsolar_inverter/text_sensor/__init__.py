@@ -4,24 +4,41 @@ import esphome.config_validation as cv
 
 from .. import CONF_SOFARSOLAR_INVERTER_ID, SOFARSOLAR_INVERTER_COMPONENT_SCHEMA
 
-DEPENDENCIES = ["modbus"]
 
 CONF_OPERATIONAL_STATUS = "operational_status"
 CONF_SERIAL_NUMBER = "serial_number"
+CONF_HARDWARE_VERSION = "hardware_version"
+CONF_FIRMWARE_VERSION = "firmware_version"
+CONF_POLLING_PROFILE = "polling_profile"
+
+UPDATE_INTERVAL = "update_interval"
 
 TYPES = {
-    CONF_OPERATIONAL_STATUS,
-    CONF_SERIAL_NUMBER,
+    CONF_OPERATIONAL_STATUS: text_sensor.text_sensor_schema().extend(
+        {
+            cv.Optional(UPDATE_INTERVAL, default="10s"): cv.positive_time_period_seconds,
+        }
+    ),
+    # Static registers, read once after boot
+    CONF_SERIAL_NUMBER: text_sensor.text_sensor_schema(),
+    CONF_HARDWARE_VERSION: text_sensor.text_sensor_schema(),
+    CONF_FIRMWARE_VERSION: text_sensor.text_sensor_schema(),
 }
 
-CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend(
-    {cv.Optional(type): text_sensor.text_sensor_schema() for type in TYPES}
-)
+CONFIG_SCHEMA = SOFARSOLAR_INVERTER_COMPONENT_SCHEMA.extend({
+    **{cv.Optional(type): schema for type, schema in TYPES.items()},
+    cv.Optional(CONF_POLLING_PROFILE): text_sensor.text_sensor_schema(),
+})
 
 async def to_code(config):
     var = await cg.get_variable(config[CONF_SOFARSOLAR_INVERTER_ID])
 
-    for type in TYPES:
+    for type, _ in TYPES.items():
         if type in config:
-            sens = await text_sensor.new_text_sensor(config[type])
-            cg.add(getattr(var, f"set_{type}")(sens))
\ No newline at end of file
+            conf = config[type]
+            sens = await text_sensor.new_text_sensor(conf)
+            cg.add(getattr(var, f"set_{type}")(sens))
+            if UPDATE_INTERVAL in conf:
+                cg.add(getattr(var, f"set_{type}_update_interval")(conf[UPDATE_INTERVAL]))
+    if CONF_POLLING_PROFILE in config:
+        cg.add(var.set_polling_profile_text_sensor(await text_sensor.new_text_sensor(config[CONF_POLLING_PROFILE])))
@@ -0,0 +1,70 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_ID,
+    DEVICE_CLASS_POWER,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_WATT,
+)
+from esphome.components.sofarsolar_inverter import SofarSolar_Inverter
+
+DEPENDENCIES = ["sofarsolar_inverter"]
+AUTO_LOAD = ["sensor"]
+
+CONF_INVERTERS = "inverters"
+CONF_ZERO_EXPORT = "zero_export"
+CONF_POWER_ID = "power_id"
+CONF_POWER_METER_MAX_AGE = "power_meter_max_age"
+CONF_INVERTER_POWER = "inverter_power"
+CONF_PV_POWER = "pv_power"
+CONF_BATTERY_POWER = "battery_power"
+
+sofarsolar_site_ns = cg.esphome_ns.namespace("sofarsolar_site")
+SofarSolar_Site = sofarsolar_site_ns.class_("SofarSolar_Site", cg.PollingComponent)
+
+POWER_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_WATT,
+    accuracy_decimals=0,
+    device_class=DEVICE_CLASS_POWER,
+    state_class=STATE_CLASS_MEASUREMENT,
+)
+
+def validate_zero_export(config):
+    if config[CONF_ZERO_EXPORT] and CONF_POWER_ID not in config:
+        raise cv.Invalid(f"{CONF_POWER_ID} is required for {CONF_ZERO_EXPORT}")
+    return config
+
+CONFIG_SCHEMA = cv.All(
+    cv.Schema({
+        cv.GenerateID(): cv.declare_id(SofarSolar_Site),
+        cv.Required(CONF_INVERTERS): cv.All(cv.ensure_list(cv.use_id(SofarSolar_Inverter)), cv.Length(min=1)),
+        cv.Optional(CONF_ZERO_EXPORT, default=False): cv.boolean,
+        cv.Optional(CONF_POWER_ID): cv.use_id(sensor.Sensor),
+        cv.Optional(CONF_POWER_METER_MAX_AGE, default="5s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_INVERTER_POWER): POWER_SCHEMA,
+        cv.Optional(CONF_PV_POWER): POWER_SCHEMA,
+        cv.Optional(CONF_BATTERY_POWER): POWER_SCHEMA,
+    }).extend(cv.polling_component_schema("1s")),
+    validate_zero_export,
+)
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+    for inverter_id in config[CONF_INVERTERS]:
+        inverter = await cg.get_variable(inverter_id)
+        cg.add(var.add_inverter(inverter))
+        if config[CONF_ZERO_EXPORT]:
+            cg.add(inverter.set_site_controlled(True)) # Before the setup of the inverter, it enables the snapshots
+    cg.add(var.set_zero_export(config[CONF_ZERO_EXPORT]))
+    if CONF_POWER_ID in config:
+        power_sensor = await cg.get_variable(config[CONF_POWER_ID])
+        cg.add(var.set_power_id(power_sensor))
+    cg.add(var.set_power_meter_max_age(config[CONF_POWER_METER_MAX_AGE]))
+    if CONF_INVERTER_POWER in config:
+        cg.add(var.set_inverter_power_sensor(await sensor.new_sensor(config[CONF_INVERTER_POWER])))
+    if CONF_PV_POWER in config:
+        cg.add(var.set_pv_power_sensor(await sensor.new_sensor(config[CONF_PV_POWER])))
+    if CONF_BATTERY_POWER in config:
+        cg.add(var.set_battery_power_sensor(await sensor.new_sensor(config[CONF_BATTERY_POWER])))
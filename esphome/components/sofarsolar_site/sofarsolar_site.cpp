@@ -0,0 +1,164 @@
+#include "sofarsolar_site.h"
+#include "algorithm"
+#include "cmath"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+    namespace sofarsolar_site {
+        static const char *TAG = "sofarsolar_site";
+
+        static const float HEADROOM_RAMP = 0.1f; // Share of its rated power an inverter may ramp up per update above its current power
+        static const uint32_t SNAPSHOT_MAX_AGE_INTERVALS = 2; // Snapshot intervals after which the snapshot of an inverter is too old for the control
+
+        void SofarSolar_Site::setup() {
+            this->setup_time_ = millis();
+            if (this->power_sensor_ != nullptr) {
+                this->power_sensor_->add_on_state_callback([this](float /*state*/) { this->power_meter_last_update_ = millis(); });
+            }
+        }
+
+        void SofarSolar_Site::update() {
+            float inverter_power = 0;
+            float pv_power = 0;
+            float battery_power = 0;
+            std::vector<float> inverter_powers;
+            bool waiting = false;
+            for (SofarSolar_Inverter *inverter : this->inverters_) {
+                const sofarsolar_inverter::SofarSolar_Snapshot &snapshot = inverter->get_power_snapshot();
+                if (snapshot.acquisition_end == 0) {
+                    uint32_t since_setup = millis() - this->setup_time_;
+                    if (since_setup <= SNAPSHOT_MAX_AGE_INTERVALS * inverter->get_power_snapshot_interval()) {
+                        waiting = true;
+                        continue;
+                    }
+                    // An inverter that never answered must not leave the others without a limit
+                    ESP_LOGW(TAG, "No power flow snapshot of an inverter %u ms after setup, limiting the export to 0", since_setup);
+                    this->limit_export_to_zero();
+                    return;
+                }
+                uint32_t age = millis() - snapshot.acquisition_end;
+                if (!snapshot.valid || age > SNAPSHOT_MAX_AGE_INTERVALS * inverter->get_power_snapshot_interval()) {
+                    // Splitting on old inverter power would keep limits in force that nothing controls anymore
+                    ESP_LOGW(TAG, "Power flow snapshot of an inverter is %s (%u ms old), limiting the export to 0", snapshot.valid ? "too old" : "invalid", age);
+                    this->limit_export_to_zero();
+                    return;
+                }
+                inverter_powers.push_back(snapshot.value(TOTAL_ACTIVE_POWER_INVERTER));
+                inverter_power += snapshot.value(TOTAL_ACTIVE_POWER_INVERTER);
+                pv_power += snapshot.value(PV_POWER_TOTAL);
+                battery_power += snapshot.value(BATTERY_POWER_TOTAL);
+            }
+            if (waiting) {
+                ESP_LOGD(TAG, "Waiting for the power flow snapshots of all inverters");
+                return;
+            }
+            if (this->inverter_power_sensor_ != nullptr) {
+                this->inverter_power_sensor_->publish_state(inverter_power);
+            }
+            if (this->pv_power_sensor_ != nullptr) {
+                this->pv_power_sensor_->publish_state(pv_power);
+            }
+            if (this->battery_power_sensor_ != nullptr) {
+                this->battery_power_sensor_->publish_state(battery_power);
+            }
+            if (!this->zero_export_ || this->power_sensor_ == nullptr) {
+                return;
+            }
+            uint32_t meter_age = millis() - this->power_meter_last_update_;
+            if (this->power_meter_last_update_ == 0 || meter_age > this->power_meter_max_age_) {
+                // Limits split on an old reading may let the site export after the load dropped
+                ESP_LOGW(TAG, "Grid meter reading is missing or too old (%u ms), limiting the export to 0", meter_age);
+                this->limit_export_to_zero();
+                return;
+            }
+            if (std::isnan(this->power_sensor_->state)) {
+                return;
+            }
+            // The inverters may together produce what the site consumes, the grid meter shows the difference
+            float site_limit = sofarsolar_inverter::zero_export_target(inverter_power, this->power_sensor_->state);
+            ESP_LOGV(TAG, "Site inverter power %f W, grid %f W, export limit %f W", inverter_power, this->power_sensor_->state, site_limit);
+            std::vector<float> limits = this->split_export_limit(site_limit, inverter_powers);
+            for (size_t i = 0; i < this->inverters_.size(); i++) {
+                ESP_LOGV(TAG, "Inverter %d: %f W of %d W", i, limits[i], this->inverters_[i]->get_max_output_power());
+                this->inverters_[i]->apply_export_limit(sofarsolar_inverter::zero_export_limit(limits[i], this->inverters_[i]->get_max_output_power()));
+            }
+        }
+
+        void SofarSolar_Site::limit_export_to_zero() {
+            if (!this->zero_export_) {
+                return;
+            }
+            for (SofarSolar_Inverter *inverter : this->inverters_) {
+                inverter->apply_export_limit(0);
+            }
+        }
+
+        std::vector<float> SofarSolar_Site::split_export_limit(float site_limit, const std::vector<float> &inverter_powers) const {
+            size_t count = this->inverters_.size();
+            std::vector<float> limits(count, 0);
+            std::vector<float> caps(count);
+            std::vector<bool> open(count, true);
+            float total_rated = 0;
+            for (size_t i = 0; i < count; i++) {
+                float rated = this->inverters_[i]->get_max_output_power();
+                total_rated += rated;
+                // An inverter short of PV or battery power cannot use more than it produces plus a ramp
+                caps[i] = std::min(rated, std::max(0.0f, inverter_powers[i]) + rated * HEADROOM_RAMP);
+            }
+            float remaining = std::max(0.0f, site_limit);
+            // Split proportionally to the rated power, the share an inverter cannot use goes to the others
+            while (remaining > 0.5f) {
+                float open_rated = 0;
+                for (size_t i = 0; i < count; i++) {
+                    if (open[i]) {
+                        open_rated += this->inverters_[i]->get_max_output_power();
+                    }
+                }
+                if (open_rated == 0) {
+                    break;
+                }
+                float distributed = 0;
+                bool capped = false;
+                for (size_t i = 0; i < count; i++) {
+                    if (!open[i]) {
+                        continue;
+                    }
+                    float share = remaining * this->inverters_[i]->get_max_output_power() / open_rated;
+                    if (limits[i] + share >= caps[i]) {
+                        distributed += caps[i] - limits[i];
+                        limits[i] = caps[i];
+                        open[i] = false;
+                        capped = true;
+                    } else {
+                        limits[i] += share;
+                        distributed += share;
+                    }
+                }
+                remaining -= distributed;
+                if (!capped) {
+                    break; // Everything went to inverters with headroom left
+                }
+            }
+            if (remaining > 0.5f && total_rated > 0) {
+                // No inverter can use this right now, spread it so every inverter is allowed to ramp up
+                for (size_t i = 0; i < count; i++) {
+                    limits[i] += remaining * this->inverters_[i]->get_max_output_power() / total_rated;
+                }
+            }
+            return limits;
+        }
+
+        void SofarSolar_Site::dump_config() {
+            ESP_LOGCONFIG(TAG, "SofarSolar_Site");
+            ESP_LOGCONFIG(TAG, "  inverters = %d", this->inverters_.size());
+            ESP_LOGCONFIG(TAG, "  zero_export = %s", TRUEFALSE(this->zero_export_));
+            ESP_LOGCONFIG(TAG, "  power_sensor = %s", this->power_sensor_ ? this->power_sensor_->get_name().c_str() : "None");
+            ESP_LOGCONFIG(TAG, "  power_meter_max_age = %u ms", this->power_meter_max_age_);
+            for (SofarSolar_Inverter *inverter : this->inverters_) {
+                ESP_LOGCONFIG(TAG, "  inverter max output power = %d W", inverter->get_max_output_power());
+            }
+        }
+
+    }  // namespace sofarsolar_site
+}  // namespace esphome
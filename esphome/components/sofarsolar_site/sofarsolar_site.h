@@ -0,0 +1,46 @@
+#pragma once
+#include "vector"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/sofarsolar_inverter/sofarsolar_inverter.h"
+#include "esphome/core/component.h"
+
+namespace esphome {
+    namespace sofarsolar_site {
+
+        using sofarsolar_inverter::SofarSolar_Inverter;
+
+        // Several inverters behind one grid meter. The site sums their power flow snapshots and runs the only
+        // zero export loop, the inverters themselves just apply the export limit they are given.
+        class SofarSolar_Site : public PollingComponent {
+        public:
+            void setup() override;
+            void update() override;
+            void dump_config() override;
+
+            void add_inverter(SofarSolar_Inverter *inverter) { this->inverters_.push_back(inverter); }
+            void set_zero_export(bool zero_export) { this->zero_export_ = zero_export; }
+            void set_power_id(sensor::Sensor *power_id) { this->power_sensor_ = power_id; }
+            void set_power_meter_max_age(uint32_t power_meter_max_age) { this->power_meter_max_age_ = power_meter_max_age; }
+            void set_inverter_power_sensor(sensor::Sensor *inverter_power_sensor) { this->inverter_power_sensor_ = inverter_power_sensor; }
+            void set_pv_power_sensor(sensor::Sensor *pv_power_sensor) { this->pv_power_sensor_ = pv_power_sensor; }
+            void set_battery_power_sensor(sensor::Sensor *battery_power_sensor) { this->battery_power_sensor_ = battery_power_sensor; }
+
+            // Splits the export limit of the site between the inverters, returns the limit of each inverter in W
+            std::vector<float> split_export_limit(float site_limit, const std::vector<float> &inverter_powers) const;
+
+        protected:
+            void limit_export_to_zero();
+
+            std::vector<SofarSolar_Inverter *> inverters_;
+            bool zero_export_ = false;
+            uint32_t setup_time_ = 0; // Time in milliseconds of the setup, the first snapshots of the inverters are due from then on
+            sensor::Sensor *power_sensor_ = nullptr;
+            uint32_t power_meter_last_update_ = 0; // Time in milliseconds of the last reading of the grid meter, 0 before the first
+            uint32_t power_meter_max_age_ = ZERO_EXPORT_METER_MAX_AGE;
+            sensor::Sensor *inverter_power_sensor_ = nullptr;
+            sensor::Sensor *pv_power_sensor_ = nullptr;
+            sensor::Sensor *battery_power_sensor_ = nullptr;
+        };
+
+    }  // namespace sofarsolar_site
+}  // namespace esphome
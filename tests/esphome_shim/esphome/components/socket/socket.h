@@ -0,0 +1,64 @@
+#pragma once
+// Host replacement of the ESPHome socket component, the subset the TCP transport uses on top of POSIX sockets
+#include "cerrno"
+#include "cstring"
+#include "memory"
+#include "string"
+#include "arpa/inet.h"
+#include "fcntl.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "sys/socket.h"
+#include "unistd.h"
+
+namespace esphome {
+	namespace socket {
+
+		class Socket {
+		public:
+			explicit Socket(int fd) : fd_(fd) {}
+			~Socket() { this->close(); }
+
+			int connect(const struct sockaddr *address, socklen_t length) { return ::connect(this->fd_, address, length); }
+			int getpeername(struct sockaddr *address, socklen_t *length) { return ::getpeername(this->fd_, address, length); }
+			int getsockopt(int level, int name, void *value, socklen_t *length) { return ::getsockopt(this->fd_, level, name, value, length); }
+			int setsockopt(int level, int name, const void *value, socklen_t length) { return ::setsockopt(this->fd_, level, name, value, length); }
+			ssize_t read(void *buffer, size_t length) { return ::read(this->fd_, buffer, length); }
+			ssize_t write(const void *buffer, size_t length) { return ::send(this->fd_, buffer, length, MSG_NOSIGNAL); }
+
+			int setblocking(bool blocking) {
+				int flags = fcntl(this->fd_, F_GETFL, 0);
+				return fcntl(this->fd_, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+			}
+
+			int close() {
+				int result = this->fd_ >= 0 ? ::close(this->fd_) : 0;
+				this->fd_ = -1;
+				return result;
+			}
+
+		protected:
+			int fd_;
+		};
+
+		inline std::unique_ptr<Socket> socket_ip(int type, int protocol) {
+			int fd = ::socket(AF_INET, type, protocol);
+			return fd < 0 ? nullptr : std::unique_ptr<Socket>(new Socket(fd));
+		}
+
+		inline socklen_t set_sockaddr(struct sockaddr *address, socklen_t length, const std::string &ip_address, uint16_t port) {
+			if (length < sizeof(struct sockaddr_in)) {
+				return 0;
+			}
+			struct sockaddr_in *address_in = reinterpret_cast<struct sockaddr_in *>(address);
+			std::memset(address_in, 0, sizeof(struct sockaddr_in));
+			address_in->sin_family = AF_INET;
+			address_in->sin_port = htons(port);
+			if (inet_pton(AF_INET, ip_address.c_str(), &address_in->sin_addr) != 1) {
+				return 0;
+			}
+			return sizeof(struct sockaddr_in);
+		}
+
+	}  // namespace socket
+}  // namespace esphome
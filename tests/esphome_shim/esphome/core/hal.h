@@ -0,0 +1,12 @@
+#pragma once
+// Host replacement of the ESPHome HAL, the clock the TCP transport uses
+#include "chrono"
+#include "cstdint"
+
+namespace esphome {
+
+	inline uint32_t millis() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+}  // namespace esphome
@@ -0,0 +1,2 @@
+#pragma once
+// Host replacement of the ESPHome helpers, the TCP transport includes them but uses none
@@ -0,0 +1,9 @@
+#pragma once
+// Host replacement of the ESPHome logger, warnings and errors go to stderr
+#include "cstdio"
+
+#define ESP_LOGE(tag, format, ...) std::fprintf(stderr, "[E][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) std::fprintf(stderr, "[W][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) std::fprintf(stderr, "[I][%s] " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void) (tag))
+#define ESP_LOGV(tag, format, ...) ((void) (tag))
@@ -0,0 +1,205 @@
+// Fuzz target of the response path: RTU and MBAP framing, matching in the poller and the block decoder, and of the
+// decoder of the telemetry packets.
+//
+// With SOFARSOLAR_FUZZ the target is built for libFuzzer (clang). Otherwise main() below runs random, truncated and
+// corrupted responses through the same entry point: fuzz_frame [iterations]
+#include "sofarsolar_poller.h"
+#include "sofarsolar_telemetry.h"
+#include "cstdio"
+#include "cstdlib"
+#include "iterator"
+#include "random"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t fuzz_now = 0;
+
+static uint32_t now_ms() {
+	return fuzz_now++;
+}
+
+static void check(bool condition, const char *message) {
+	if (!condition) {
+		std::fprintf(stderr, "Check failed: %s\n", message);
+		std::abort();
+	}
+}
+
+class FuzzTransport : public SofarSolar_Transport {
+public:
+	bool send(const std::vector<uint8_t> & /*frame*/, uint16_t &transaction_id) override {
+		transaction_id = 0;
+		return true;
+	}
+};
+
+class FuzzSink : public SofarSolar_Sink {
+public:
+	void on_read_response(const register_read_task &task, const FrameView &frame) override {
+		this->decode(task.start_address, task.register_count, frame);
+	}
+
+	void on_write_response(const register_write_task &task, const FrameView &frame) override {
+		if (task.read_register_count > 0) {
+			this->decode(task.read_start_address, task.read_register_count, frame);
+		}
+	}
+
+	void on_request_failed(const in_flight_request & /*request*/, uint8_t /*reason*/) override {}
+
+protected:
+	void decode(uint16_t start_address, uint16_t register_count, const FrameView &frame) {
+		SofarSolar_DecodePlan plan;
+		build_decode_plan(start_address, register_count, plan);
+		size_t decoded = decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data());
+		check(decoded <= plan.numeric.size(), "more values decoded than described");
+		for (size_t i = 0; i < decoded; i++) {
+			check(frame.contains(plan.numeric[i].offset, plan.numeric[i].width * 2), "value decoded outside the frame");
+		}
+		if (decoded < plan.numeric.size()) {
+			check(!frame.contains(plan.numeric[decoded].offset, plan.numeric[decoded].width * 2), "decoding stopped at a contained value");
+		}
+	}
+};
+
+// The first byte selects the register a read starts at, the second the register count and the third whether a read,
+// a write or a combined write and read is in flight. The rest is the byte stream received from the bus.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (size < 3) {
+		return 0;
+	}
+	FuzzTransport transport;
+	FuzzSink sink;
+	SofarSolar_Poller poller;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+
+	const std::map<uint16_t, uint8_t> &index = G3_address_index();
+	auto it = std::next(index.begin(), data[0] % index.size());
+	uint16_t register_count = 1 + data[1] % MODBUS_MAX_READ_REGISTERS;
+	if (data[2] % 3 == 0) {
+		register_read_task task(it->second);
+		task.register_count = register_count;
+		poller.queue_read(task);
+	} else {
+		register_write_task task(it->second);
+		task.number_of_registers = 1;
+		task.data = {0x00, 0x00};
+		if (data[2] % 3 == 2) {
+			task.read_start_address = it->first;
+			task.read_register_count = register_count;
+		}
+		poller.queue_write(task);
+	}
+	poller.loop();
+
+	std::vector<uint8_t> buffer(data + 3, data + size);
+	parse_rtu_frames(transport, buffer, data[0] % 2 == 0 ? 0 : 1);
+	// The TCP gateway hands out the PDU of a response the same way, without the RTU framing
+	poller.queue_read(register_read_task(it->second));
+	poller.loop();
+	dispatch_response_pdu(transport, 0, data + 3, size - 3);
+	// The same bytes as a Modbus TCP stream with MBAP headers
+	poller.queue_read(register_read_task(it->second));
+	poller.loop();
+	buffer.assign(data + 3, data + size);
+	parse_mbap_frames(transport, buffer, 1);
+
+	// The same bytes as a telemetry packet received by a listener, every sample takes at least 3 bytes
+	uint32_t sequence;
+	std::vector<SofarSolar_TelemetrySample> samples;
+	if (decode_telemetry_packet(data + 3, size - 3, sequence, samples)) {
+		check(TELEMETRY_HEADER_SIZE + samples.size() * 3 <= size - 3, "more telemetry samples decoded than the packet holds");
+		for (const SofarSolar_TelemetrySample &sample : samples) {
+			check(sample.channel < TELEMETRY_MAX_CHANNELS, "telemetry channel out of range");
+		}
+	}
+	return 0;
+}
+
+#ifndef SOFARSOLAR_LIBFUZZER
+// Appends the RTU CRC to a frame
+static void append_crc(std::vector<uint8_t> &frame, size_t start) {
+	uint16_t crc = rtu_crc16(frame.data() + start, frame.size() - start);
+	frame.push_back(crc & 0xFF);
+	frame.push_back(crc >> 8);
+}
+
+int main(int argc, char **argv) {
+	unsigned long iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::mt19937 random(0x50FA);
+	std::vector<uint8_t> input;
+	for (unsigned long i = 0; i < iterations; i++) {
+		input = {static_cast<uint8_t>(random()), static_cast<uint8_t>(random()), static_cast<uint8_t>(random())};
+		switch (random() % 5) {
+			case 0: {
+				// Random bytes
+				size_t size = random() % 300;
+				for (size_t j = 0; j < size; j++) {
+					input.push_back(static_cast<uint8_t>(random()));
+				}
+				break;
+			}
+			case 1: {
+				// Well formed read response with a random byte count, truncated at a random position
+				uint8_t byte_count = static_cast<uint8_t>(random());
+				input.insert(input.end(), {0x01, 0x03, byte_count});
+				for (size_t j = 0; j < byte_count; j++) {
+					input.push_back(static_cast<uint8_t>(random()));
+				}
+				append_crc(input, 3);
+				input.resize(3 + random() % (input.size() - 2));
+				break;
+			}
+			case 2: {
+				// Write, combined write and read or exception response with a random payload and a valid CRC
+				static const uint8_t function_codes[] = {0x10, 0x17, 0x83, 0x90, 0x97};
+				uint8_t function_code = function_codes[random() % sizeof(function_codes)];
+				input.insert(input.end(), {0x01, function_code});
+				size_t size = random() % 12;
+				for (size_t j = 0; j < size; j++) {
+					input.push_back(static_cast<uint8_t>(random()));
+				}
+				append_crc(input, 3);
+				break;
+			}
+			case 3: {
+				// Telemetry packet of random samples with one byte changed and truncated at a random position
+				SofarSolar_TelemetryEncoder encoder;
+				size_t samples = random() % 64;
+				for (size_t j = 0; j < samples; j++) {
+					encoder.add(random() % (TELEMETRY_MAX_CHANNELS + 1), static_cast<uint32_t>(random()), static_cast<int32_t>(random()));
+				}
+				std::vector<uint8_t> packet(encoder.data(), encoder.data() + encoder.size());
+				if (!packet.empty() && random() % 2 == 0) {
+					packet[random() % packet.size()] = static_cast<uint8_t>(random());
+				}
+				input.insert(input.end(), packet.begin(), packet.begin() + (packet.empty() ? 0 : random() % (packet.size() + 1)));
+				break;
+			}
+			default: {
+				// Several responses back to back with garbage in between
+				size_t frames = 1 + random() % 4;
+				for (size_t f = 0; f < frames; f++) {
+					size_t garbage = random() % 4;
+					for (size_t j = 0; j < garbage; j++) {
+						input.push_back(static_cast<uint8_t>(random()));
+					}
+					size_t start = input.size();
+					uint8_t byte_count = static_cast<uint8_t>(2 * (random() % 8));
+					input.insert(input.end(), {0x01, 0x03, byte_count});
+					for (size_t j = 0; j < byte_count; j++) {
+						input.push_back(static_cast<uint8_t>(random()));
+					}
+					append_crc(input, start);
+				}
+				break;
+			}
+		}
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+	std::printf("Ran %lu inputs\n", iterations);
+	return 0;
+}
+#endif
@@ -0,0 +1,126 @@
+#pragma once
+#include "map"
+#include "vector"
+#include "sofarsolar_transport.h"
+
+namespace esphome {
+	namespace sofarsolar_inverter {
+
+		// Modbus RTU slave answering from a register map, for the host tests. Registers that were never set read as 0.
+		class SimulatedDevice {
+		public:
+			explicit SimulatedDevice(uint8_t modbus_address = 1) : modbus_address_(modbus_address) {}
+
+			// Consumes the complete requests at the start of the buffer and appends their responses, with CRC
+			void receive(std::vector<uint8_t> &buffer, std::vector<uint8_t> &response) {
+				while (buffer.size() >= 8) {
+					size_t size = request_size(buffer.data(), buffer.size());
+					if (size == 0 && buffer[1] != 0x10 && buffer[1] != 0x17) {
+						buffer.erase(buffer.begin()); // Unknown function code, resynchronize on the next byte
+						continue;
+					}
+					if (size == 0 || buffer.size() < size) {
+						return;
+					}
+					if (rtu_crc16(buffer.data(), size) != 0) {
+						buffer.erase(buffer.begin());
+						continue;
+					}
+					this->requests++;
+					if (buffer[0] == this->modbus_address_) {
+						std::vector<uint8_t> answer = this->answer(buffer.data(), size - 2);
+						uint16_t crc = rtu_crc16(answer.data(), answer.size());
+						answer.push_back(crc & 0xFF);
+						answer.push_back(crc >> 8);
+						response.insert(response.end(), answer.begin(), answer.end());
+					}
+					buffer.erase(buffer.begin(), buffer.begin() + size);
+				}
+			}
+
+			// Response to a request without CRC
+			std::vector<uint8_t> answer(const uint8_t *frame, size_t size) {
+				uint8_t function_code = frame[1];
+				uint16_t start_address = (frame[2] << 8) | frame[3];
+				uint16_t register_count = (frame[4] << 8) | frame[5];
+				if (function_code == 0x10 && size >= 7) {
+					this->write(start_address, register_count, frame + 7);
+					return {this->modbus_address_, function_code, frame[2], frame[3], frame[4], frame[5]};
+				}
+				if (function_code == 0x17 && size >= 11) {
+					this->write((frame[6] << 8) | frame[7], (frame[8] << 8) | frame[9], frame + 11);
+				} else if (function_code != 0x03 && function_code != 0x04) {
+					return {this->modbus_address_, static_cast<uint8_t>(function_code | 0x80), 0x01}; // Illegal function
+				}
+				if (register_count == 0 || register_count > 125) {
+					return {this->modbus_address_, static_cast<uint8_t>(function_code | 0x80), 0x03}; // Illegal data value
+				}
+				std::vector<uint8_t> response = {this->modbus_address_, function_code, static_cast<uint8_t>(register_count * 2)};
+				for (uint16_t i = 0; i < register_count; i++) {
+					auto it = this->registers.find(start_address + i);
+					uint16_t value = it != this->registers.end() ? it->second : 0;
+					response.push_back(value >> 8);
+					response.push_back(value & 0xFF);
+				}
+				return response;
+			}
+
+			// Size of the request at the start of the buffer including its CRC, 0 if unknown
+			static size_t request_size(const uint8_t *data, size_t available) {
+				switch (data[1]) {
+					case 0x03:
+					case 0x04:
+						return 8;
+					case 0x10:
+						return available >= 7 ? 9 + data[6] : 0;
+					case 0x17:
+						return available >= 11 ? 13 + data[10] : 0;
+					default:
+						return 0;
+				}
+			}
+
+			std::map<uint16_t, uint16_t> registers; // Register values by address
+			uint32_t requests = 0; // Requests received, including the ones for other addresses
+
+		protected:
+			void write(uint16_t start_address, uint16_t register_count, const uint8_t *data) {
+				for (uint16_t i = 0; i < register_count; i++) {
+					this->registers[start_address + i] = (data[i * 2] << 8) | data[i * 2 + 1];
+				}
+			}
+
+			uint8_t modbus_address_;
+		};
+
+		// Transport answering each request with the simulated device on the next loop
+		class SimulatedDeviceTransport : public SofarSolar_Transport {
+		public:
+			explicit SimulatedDeviceTransport(SimulatedDevice &device) : device_(device) {}
+
+			bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override {
+				transaction_id = 0;
+				this->sent++;
+				this->response_ = this->device_.answer(frame.data(), frame.size());
+				this->answered_ = true;
+				return true;
+			}
+
+			void loop() override {
+				if (this->answered_) {
+					this->answered_ = false;
+					std::vector<uint8_t> response = this->response_;
+					dispatch_response_pdu(*this, 0, response.data() + 1, response.size() - 1);
+				}
+			}
+
+			uint32_t sent = 0; // Requests sent
+
+		protected:
+			SimulatedDevice &device_;
+			std::vector<uint8_t> response_; // Answer delivered on the next loop
+			bool answered_ = false;
+		};
+
+	}  // namespace sofarsolar_inverter
+}  // namespace esphome
@@ -0,0 +1,184 @@
+// Runs the baud rate negotiation and the poller against a simulated device that only answers at its own baud rate
+#include "sofarsolar_baud.h"
+#include "sofarsolar_poller.h"
+#include "simulated_device.h"
+#include "test_util.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+#define SPEED_SETTING_REGISTER 0x1009
+
+static uint32_t clock_now = 0;
+
+static uint32_t now_ms() {
+	return clock_now;
+}
+
+static const std::map<uint16_t, uint32_t> speed_setting_rates = {{0, 9600}, {1, 19200}, {2, 38400}, {3, 115200}};
+
+// Line between the UART and the device. A request sent at another rate than the device uses is lost. A write to the
+// speed setting switches the device after its answer, unless the device ignores the setting.
+class SimulatedLink : public SofarSolar_Transport {
+public:
+	bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override {
+		transaction_id = 0;
+		if (!this->connected || this->uart_baud_rate != this->device_baud_rate) {
+			return true;
+		}
+		this->response_ = this->device.answer(frame.data(), frame.size());
+		this->answered_ = true;
+		auto setting = this->device.registers.find(SPEED_SETTING_REGISTER);
+		if (this->accepts_speed_setting && setting != this->device.registers.end()) {
+			this->device_baud_rate = speed_setting_rates.at(setting->second);
+		}
+		return true;
+	}
+
+	void loop() override {
+		if (!this->answered_) {
+			return;
+		}
+		this->answered_ = false;
+		std::vector<uint8_t> response = this->response_;
+		dispatch_response_pdu(*this, 0, response.data() + 1, response.size() - 1);
+	}
+
+	SimulatedDevice device;
+	uint32_t uart_baud_rate = 0;
+	uint32_t device_baud_rate = 9600;
+	bool connected = true; // Flag to indicate that a device is on the line at all
+	bool accepts_speed_setting = true;
+
+protected:
+	std::vector<uint8_t> response_; // Answer delivered on the next loop
+	bool answered_ = false;
+};
+
+// Does what the inverter does with the decisions of the negotiation: probes with a read of the operational status and
+// writes the speed setting
+class NegotiationSink : public SofarSolar_Sink {
+public:
+	NegotiationSink(SofarSolar_BaudNegotiation &negotiation, SofarSolar_Poller &poller, SimulatedLink &link) : negotiation_(negotiation), poller_(poller), link_(link) {}
+
+	void probe(uint32_t baud_rate) {
+		this->link_.uart_baud_rate = baud_rate;
+		this->probes++;
+		register_read_task task(OPERATIONAL_STATUS);
+		task.probe = true;
+		this->poller_.queue_read(task);
+	}
+
+	void on_read_response(const register_read_task & /*task*/, const FrameView & /*frame*/) override {
+		if (this->negotiation_.on_probe_answered(this->link_.uart_baud_rate) == BAUD_SWITCH) {
+			register_write_task task;
+			task.start_address = SPEED_SETTING_REGISTER;
+			task.number_of_registers = 1;
+			for (const auto &setting : speed_setting_rates) {
+				if (setting.second == this->negotiation_.get_target_baud_rate()) {
+					task.data = {static_cast<uint8_t>(setting.first >> 8), static_cast<uint8_t>(setting.first & 0xFF)};
+				}
+			}
+			this->writes++;
+			this->poller_.queue_write(task);
+		}
+	}
+
+	void on_write_response(const register_write_task & /*task*/, const FrameView & /*frame*/) override {
+		this->probe(this->negotiation_.on_switch_sent());
+	}
+
+	void on_request_failed(const in_flight_request &request, uint8_t /*reason*/) override {
+		if (request.is_write) {
+			this->probe(this->negotiation_.on_switch_sent());
+			return;
+		}
+		uint32_t baud_rate = this->negotiation_.on_probe_failed();
+		if (this->negotiation_.get_state() == BAUD_DONE) {
+			this->link_.uart_baud_rate = baud_rate; // Fallback
+			return;
+		}
+		this->probe(baud_rate);
+	}
+
+	uint32_t probes = 0;
+	uint32_t writes = 0;
+
+protected:
+	SofarSolar_BaudNegotiation &negotiation_;
+	SofarSolar_Poller &poller_;
+	SimulatedLink &link_;
+};
+
+struct negotiation_result {
+	uint32_t baud_rate; // Rate of the UART when the negotiation settled
+	uint32_t probes;
+	uint32_t writes;
+};
+
+static negotiation_result negotiate(SimulatedLink &link, uint32_t original_baud_rate, uint32_t target_baud_rate) {
+	SofarSolar_BaudNegotiation negotiation;
+	for (uint32_t baud_rate : {9600, 19200, 38400, 115200}) {
+		negotiation.add_baud_rate(baud_rate);
+	}
+	negotiation.set_target_baud_rate(target_baud_rate);
+	link.device.registers[0x0404] = 2; // Operational status grid connected
+	SofarSolar_Poller poller;
+	NegotiationSink sink(negotiation, poller, link);
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&link);
+	sink.probe(negotiation.start(original_baud_rate));
+	for (uint32_t i = 0; i < 100000 && negotiation.get_state() != BAUD_DONE; i++) {
+		poller.loop();
+		clock_now++;
+	}
+	CHECK(negotiation.get_state() == BAUD_DONE);
+	return negotiation_result{link.uart_baud_rate, sink.probes, sink.writes};
+}
+
+int main() {
+	{
+		// Correct configuration, a single probe
+		SimulatedLink link;
+		negotiation_result result = negotiate(link, 9600, 0);
+		CHECK(result.baud_rate == 9600);
+		CHECK(result.probes == 1);
+		CHECK(result.writes == 0);
+	}
+	{
+		// Device at another rate than configured
+		SimulatedLink link;
+		link.device_baud_rate = 38400;
+		negotiation_result result = negotiate(link, 9600, 0);
+		CHECK(result.baud_rate == 38400);
+		CHECK(result.probes == 3);
+	}
+	{
+		// Switch to the target rate, verified with a probe at the new rate
+		SimulatedLink link;
+		negotiation_result result = negotiate(link, 9600, 115200);
+		CHECK(result.baud_rate == 115200);
+		CHECK(link.device_baud_rate == 115200);
+		CHECK(result.writes == 1);
+		CHECK(result.probes == 2);
+	}
+	{
+		// Device ignores the speed setting, the verify fails and the detection finds the old rate without a second switch
+		SimulatedLink link;
+		link.accepts_speed_setting = false;
+		link.device_baud_rate = 19200;
+		negotiation_result result = negotiate(link, 9600, 115200);
+		CHECK(result.baud_rate == 19200);
+		CHECK(result.writes == 1);
+	}
+	{
+		// Nobody answers, fall back to the configured rate
+		SimulatedLink link;
+		link.connected = false;
+		negotiation_result result = negotiate(link, 19200, 115200);
+		CHECK(result.baud_rate == 19200);
+		CHECK(result.writes == 0);
+		CHECK(result.probes == 4);
+	}
+	return test_failures == 0 ? 0 : 1;
+}
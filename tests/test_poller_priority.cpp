@@ -0,0 +1,89 @@
+// Checks the dispatch order of the read queue while a capture keeps re-queuing its reads
+#include "sofarsolar_poller.h"
+#include "simulated_device.h"
+#include "test_util.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t clock_now = 0;
+
+static uint32_t now_ms() {
+	return clock_now;
+}
+
+// Re-queues every capture read as soon as it is answered, like the inverter does while a capture is active
+class CaptureSink : public SofarSolar_Sink {
+public:
+	explicit CaptureSink(SofarSolar_Poller &poller) : poller_(poller) {}
+
+	void on_read_response(const register_read_task &task, const FrameView & /*frame*/) override {
+		if (task.capture) {
+			this->capture_samples++;
+			this->poller_.queue_read(task);
+		} else if (task.snapshot) {
+			this->snapshot_blocks++;
+		} else if (task.write_group) {
+			this->group_fetches++;
+		} else {
+			this->plain_reads++;
+		}
+	}
+
+	void on_write_response(const register_write_task & /*task*/, const FrameView & /*frame*/) override {}
+	void on_request_failed(const in_flight_request & /*request*/, uint8_t /*reason*/) override {}
+
+	uint32_t capture_samples = 0;
+	uint32_t snapshot_blocks = 0;
+	uint32_t group_fetches = 0;
+	uint32_t plain_reads = 0;
+
+protected:
+	SofarSolar_Poller &poller_;
+};
+
+int main() {
+	SimulatedDevice device;
+	SimulatedDeviceTransport transport(device);
+	SofarSolar_Poller poller;
+	CaptureSink sink(poller);
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+
+	register_read_task capture(TOTAL_ACTIVE_POWER_INVERTER);
+	capture.capture = true;
+	poller.queue_read(capture);
+	for (int i = 0; i < 10; i++) {
+		poller.loop();
+		clock_now++;
+	}
+	CHECK(sink.capture_samples > 0);
+
+	// A snapshot started during the capture completes after the capture read in flight, with one read per block
+	for (uint8_t register_key : power_flow_snapshot_registers) {
+		register_read_task block(register_key);
+		block.snapshot = true;
+		poller.queue_read(block);
+	}
+	register_read_task fetch(DESIRED_GRID_POWER);
+	fetch.write_group = true;
+	poller.queue_read(fetch);
+	poller.queue_read(register_read_task(PV_GENERATION_TODAY));
+	uint32_t samples = sink.capture_samples;
+	for (size_t i = 0; i < power_flow_snapshot_registers.size() + 2; i++) {
+		poller.loop();
+		clock_now++;
+	}
+	CHECK(sink.group_fetches == 1);
+	CHECK(sink.snapshot_blocks == power_flow_snapshot_registers.size());
+	CHECK(sink.capture_samples == samples + 1);
+
+	// The capture continues afterwards, and the plain reads queued before it wait for its end
+	for (int i = 0; i < 10; i++) {
+		poller.loop();
+		clock_now++;
+	}
+	CHECK(sink.capture_samples > samples);
+	CHECK(sink.plain_reads == 0);
+	return test_failures == 0 ? 0 : 1;
+}
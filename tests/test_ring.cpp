@@ -0,0 +1,70 @@
+// Checks the SPSC ring on one thread and with a producer and a consumer thread
+#include "sofarsolar_ring.h"
+#include "test_util.h"
+#include "thread"
+#include "vector"
+
+using namespace esphome::sofarsolar_inverter;
+
+#define THREADED_COUNT 200000
+
+int main() {
+	{
+		// Holds Size - 1 elements and keeps the order across the wrap around
+		SofarSolar_SpscRing<int, 4> ring;
+		CHECK(ring.empty());
+		for (int round = 0; round < 3; round++) {
+			for (int i = 0; i < 3; i++) {
+				int value = round * 10 + i;
+				CHECK(ring.push(std::move(value)));
+			}
+			int full = 99;
+			CHECK(!ring.push(std::move(full)));
+			for (int i = 0; i < 3; i++) {
+				int value = -1;
+				CHECK(ring.pop(value));
+				CHECK(value == round * 10 + i);
+			}
+			int value = -1;
+			CHECK(!ring.pop(value));
+			CHECK(ring.empty());
+		}
+	}
+	{
+		// A value rejected by a full ring is not moved from
+		SofarSolar_SpscRing<std::vector<int>, 2> ring;
+		CHECK(ring.push(std::vector<int>{1}));
+		std::vector<int> rejected = {42};
+		CHECK(!ring.push(std::move(rejected)));
+		CHECK(rejected.size() == 1 && rejected[0] == 42);
+	}
+	{
+		// The producer pushes a sequence with heap allocated payloads, the consumer has to see every element once and in order
+		static SofarSolar_SpscRing<std::vector<uint32_t>, 16> ring;
+		std::thread producer([] {
+			for (uint32_t i = 0; i < THREADED_COUNT; i++) {
+				std::vector<uint32_t> value(1 + i % 8, i);
+				while (!ring.push(std::move(value))) {
+					std::this_thread::yield();
+				}
+			}
+		});
+		uint32_t expected = 0;
+		uint32_t errors = 0;
+		while (expected < THREADED_COUNT) {
+			std::vector<uint32_t> value;
+			if (!ring.pop(value)) {
+				std::this_thread::yield();
+				continue;
+			}
+			if (value.size() != 1 + expected % 8 || value.front() != expected || value.back() != expected) {
+				errors++;
+			}
+			expected++;
+		}
+		producer.join();
+		CHECK(errors == 0);
+		CHECK(ring.empty());
+	}
+	return test_failures == 0 ? 0 : 1;
+}
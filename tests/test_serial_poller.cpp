@@ -0,0 +1,113 @@
+// Runs the poller on the serial transport against a simulated device on the other end of a pty
+#include "sofarsolar_poller.h"
+#include "sofarsolar_serial.h"
+#include "simulated_device.h"
+#include "test_util.h"
+#include "chrono"
+#include "cmath"
+#include "fcntl.h"
+#include "thread"
+#include "unistd.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class RecordingSink : public SofarSolar_Sink {
+public:
+	void on_read_response(const register_read_task &task, const FrameView &frame) override {
+		SofarSolar_DecodePlan plan;
+		build_decode_plan(task.start_address, task.register_count, plan);
+		decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data());
+		for (const DecodeDescriptor &descriptor : plan.numeric) {
+			this->values[plan.registers[descriptor.slot].register_key] = plan.values[descriptor.slot];
+		}
+	}
+
+	void on_write_response(const register_write_task & /*task*/, const FrameView & /*frame*/) override {
+		this->writes++;
+	}
+
+	void on_request_failed(const in_flight_request & /*request*/, uint8_t reason) override {
+		if (reason == REQUEST_TIMEOUT) {
+			this->timeouts++;
+		}
+	}
+
+	std::map<uint8_t, float> values;
+	uint32_t writes = 0;
+	uint32_t timeouts = 0;
+};
+
+// Runs the poller and the device until the poller has nothing left to do
+static void run(SofarSolar_Poller &poller, SimulatedDevice &device, int master) {
+	std::vector<uint8_t> received;
+	uint32_t start = now_ms();
+	while ((poller.get_read_queue_size() > 0 || poller.get_write_queue_size() > 0 || poller.get_in_flight_count() > 0) && now_ms() - start < 5000) {
+		poller.loop();
+		uint8_t buffer[128];
+		ssize_t size;
+		while ((size = read(master, buffer, sizeof(buffer))) > 0) {
+			received.insert(received.end(), buffer, buffer + size);
+		}
+		std::vector<uint8_t> response;
+		device.receive(received, response);
+		if (!response.empty()) {
+			CHECK(write(master, response.data(), response.size()) == static_cast<ssize_t>(response.size()));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+int main() {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		std::fprintf(stderr, "Cannot open a pty\n");
+		return 1;
+	}
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	SofarSolar_SerialTransport transport(ptsname(master), 9600);
+	CHECK(transport.open());
+
+	SimulatedDevice device(1);
+	device.registers[0x0485] = 0x0123; // Total active power 291 * 10 W
+	device.registers[0x0667] = 0xFFF6; // Battery power total -10 * 100 W
+	device.registers[0x0684] = 0x0000; // PV generation today 1234 * 0.01 kWh
+	device.registers[0x0685] = 0x04D2;
+
+	RecordingSink sink;
+	SofarSolar_Poller poller;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+	poller.set_modbus_address(1);
+
+	poller.queue_read(register_read_task(TOTAL_ACTIVE_POWER_INVERTER));
+	poller.queue_read(register_read_task(BATTERY_POWER_TOTAL));
+	poller.queue_read(register_read_task(PV_GENERATION_TODAY));
+	run(poller, device, master);
+	CHECK(sink.values.count(TOTAL_ACTIVE_POWER_INVERTER) && sink.values[TOTAL_ACTIVE_POWER_INVERTER] == 2910.0f);
+	CHECK(sink.values.count(BATTERY_POWER_TOTAL) && sink.values[BATTERY_POWER_TOTAL] == -1000.0f);
+	CHECK(sink.values.count(PV_GENERATION_TODAY) && std::fabs(sink.values[PV_GENERATION_TODAY] - 12.34f) < 0.001f);
+
+	// -5000 W minimum battery power as S_DWORD
+	register_write_task write(MINIMUM_BATTERY_POWER);
+	write.number_of_registers = 2;
+	write.data = {0xFF, 0xFF, 0xEC, 0x78};
+	poller.queue_write(write);
+	run(poller, device, master);
+	CHECK(sink.writes == 1);
+	CHECK(device.registers[0x1189] == 0xFFFF && device.registers[0x118A] == 0xEC78);
+
+	// Nobody answers for another slave address, the request runs into the timeout
+	poller.set_modbus_address(2);
+	poller.queue_read(register_read_task(TOTAL_ACTIVE_POWER_INVERTER));
+	run(poller, device, master);
+	CHECK(sink.timeouts == 1);
+
+	transport.close();
+	close(master);
+	return test_failures == 0 ? 0 : 1;
+}
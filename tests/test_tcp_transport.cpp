@@ -0,0 +1,254 @@
+// Runs the poller on the TCP transport against a gateway on a loopback socket that answers out of order, drops a
+// response and sends corrupt frames
+#include "sofarsolar_poller.h"
+#include "sofarsolar_tcp.h"
+#include "esphome/core/hal.h"
+#include "simulated_device.h"
+#include "test_util.h"
+#include "chrono"
+#include "thread"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t now_ms() {
+	return esphome::millis();
+}
+
+// Value of the register at an address in the simulated device, differs for every address
+static uint16_t register_value(uint16_t address) {
+	return address ^ 0x5A5A;
+}
+
+class CheckingSink : public SofarSolar_Sink {
+public:
+	void on_read_response(const register_read_task &task, const FrameView &frame) override {
+		uint16_t value = 0;
+		if (frame.size() == task.register_count * 2u && frame.read_uint16(0, value) && value == register_value(task.start_address)) {
+			this->matched++;
+		} else {
+			this->mismatched++; // The registers of another request were taken for the ones of this request
+		}
+	}
+
+	void on_write_response(const register_write_task & /*task*/, const FrameView & /*frame*/) override {}
+
+	void on_request_failed(const in_flight_request & /*request*/, uint8_t reason) override {
+		if (reason == REQUEST_TIMEOUT) {
+			this->timeouts++;
+		}
+	}
+
+	void on_unmatched_response(uint16_t /*transaction_id*/) override {
+		this->unmatched++;
+	}
+
+	uint32_t matched = 0;
+	uint32_t mismatched = 0;
+	uint32_t timeouts = 0;
+	uint32_t unmatched = 0;
+};
+
+// Gateway on a loopback socket. It collects the requests and answers them only when the test tells it to.
+class LoopbackGateway {
+public:
+	struct Request {
+		uint16_t transaction_id; // 0 for RTU over TCP
+		std::vector<uint8_t> frame; // Unit id and PDU
+	};
+
+	explicit LoopbackGateway(uint8_t protocol) : protocol_(protocol) {
+		for (uint8_t register_key : power_flow_snapshot_registers) {
+			uint16_t address = G3_registers.at(register_key).start_address;
+			this->device.registers[address] = register_value(address);
+		}
+		this->listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length = sizeof(address);
+		CHECK(::bind(this->listen_fd_, reinterpret_cast<struct sockaddr *>(&address), length) == 0);
+		CHECK(::listen(this->listen_fd_, 1) == 0);
+		CHECK(::getsockname(this->listen_fd_, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+		this->port_ = ntohs(address.sin_port);
+		fcntl(this->listen_fd_, F_SETFL, O_NONBLOCK);
+	}
+
+	~LoopbackGateway() {
+		if (this->client_fd_ >= 0) {
+			::close(this->client_fd_);
+		}
+		::close(this->listen_fd_);
+	}
+
+	uint16_t get_port() const { return this->port_; }
+
+	// Accepts the connection of the transport and collects the complete requests
+	void loop() {
+		if (this->client_fd_ < 0) {
+			this->client_fd_ = ::accept(this->listen_fd_, nullptr, nullptr);
+			if (this->client_fd_ >= 0) {
+				fcntl(this->client_fd_, F_SETFL, O_NONBLOCK);
+			}
+			return;
+		}
+		uint8_t buffer[256];
+		ssize_t size;
+		while ((size = ::read(this->client_fd_, buffer, sizeof(buffer))) > 0) {
+			this->received_.insert(this->received_.end(), buffer, buffer + size);
+		}
+		while (true) {
+			Request request;
+			size_t request_size;
+			if (this->protocol_ == TCP_PROTOCOL_MODBUS_TCP) {
+				if (this->received_.size() < 7 || this->received_.size() < 6u + this->received_[5]) {
+					return;
+				}
+				request_size = 6 + this->received_[5];
+				request.transaction_id = (this->received_[0] << 8) | this->received_[1];
+				request.frame.assign(this->received_.begin() + 6, this->received_.begin() + request_size);
+			} else {
+				request_size = this->received_.size() >= 2 ? SimulatedDevice::request_size(this->received_.data(), this->received_.size()) : 0;
+				if (request_size == 0 || this->received_.size() < request_size) {
+					return;
+				}
+				CHECK(rtu_crc16(this->received_.data(), request_size) == 0);
+				request.transaction_id = 0;
+				request.frame.assign(this->received_.begin(), this->received_.begin() + request_size - 2);
+			}
+			this->received_.erase(this->received_.begin(), this->received_.begin() + request_size);
+			this->requests.push_back(request);
+		}
+	}
+
+	// Response of the device to a request, framed for the protocol
+	std::vector<uint8_t> response(const Request &request, uint8_t unit_id = 1) {
+		std::vector<uint8_t> answer = this->device.answer(request.frame.data(), request.frame.size());
+		answer[0] = unit_id;
+		if (this->protocol_ == TCP_PROTOCOL_MODBUS_TCP) {
+			std::vector<uint8_t> packet = {static_cast<uint8_t>(request.transaction_id >> 8), static_cast<uint8_t>(request.transaction_id & 0xFF), 0x00, 0x00, 0x00, static_cast<uint8_t>(answer.size())};
+			packet.insert(packet.end(), answer.begin(), answer.end());
+			return packet;
+		}
+		uint16_t crc = rtu_crc16(answer.data(), answer.size());
+		answer.push_back(crc & 0xFF);
+		answer.push_back(crc >> 8);
+		return answer;
+	}
+
+	void send(const std::vector<uint8_t> &data) {
+		CHECK(::write(this->client_fd_, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+	}
+
+	SimulatedDevice device;
+	std::vector<Request> requests; // Requests not answered yet, in the order they arrived
+
+protected:
+	uint8_t protocol_;
+	int listen_fd_ = -1;
+	int client_fd_ = -1;
+	uint16_t port_ = 0;
+	std::vector<uint8_t> received_; // Received bytes not yet parsed into a request
+};
+
+// Runs the poller and the gateway until the condition holds or the time is up
+template<typename Condition> static bool run_until(SofarSolar_Poller &poller, LoopbackGateway &gateway, Condition condition, uint32_t timeout = 3000) {
+	uint32_t start = now_ms();
+	while (!condition()) {
+		if (now_ms() - start > timeout) {
+			return false;
+		}
+		poller.loop();
+		gateway.loop();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static void queue_snapshot(SofarSolar_Poller &poller, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		poller.queue_read(register_read_task(power_flow_snapshot_registers[i]));
+	}
+}
+
+static void test_modbus_tcp() {
+	LoopbackGateway gateway(TCP_PROTOCOL_MODBUS_TCP);
+	SofarSolar_TcpTransport transport("127.0.0.1", gateway.get_port(), TCP_PROTOCOL_MODBUS_TCP, 4, 300);
+	SofarSolar_Poller poller;
+	CheckingSink sink;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+	CHECK(run_until(poller, gateway, [&]() { return transport.is_connected(); }));
+
+	// Four requests in flight, answered in reverse order, each is matched by its transaction id
+	queue_snapshot(poller, 4);
+	CHECK(run_until(poller, gateway, [&]() { return gateway.requests.size() == 4; }));
+	for (auto it = gateway.requests.rbegin(); it != gateway.requests.rend(); ++it) {
+		gateway.send(gateway.response(*it));
+	}
+	gateway.requests.clear();
+	CHECK(run_until(poller, gateway, [&]() { return sink.matched == 4; }));
+
+	// A bad MBAP header in front of two responses only costs its own bytes, the response of another unit is
+	// discarded and the dropped response times out
+	queue_snapshot(poller, 4);
+	CHECK(run_until(poller, gateway, [&]() { return gateway.requests.size() == 4; }));
+	std::vector<uint8_t> data = {0x00, 0x07, 0x12, 0x34, 0x00, 0x05, 0x01, 0x03};
+	std::vector<uint8_t> response = gateway.response(gateway.requests[2]);
+	data.insert(data.end(), response.begin(), response.end());
+	response = gateway.response(gateway.requests[0], 7);
+	data.insert(data.end(), response.begin(), response.end());
+	response = gateway.response(gateway.requests[1]);
+	data.insert(data.end(), response.begin(), response.end());
+	gateway.send(data);
+	gateway.send(gateway.response(gateway.requests[3]));
+	gateway.requests.clear();
+	CHECK(run_until(poller, gateway, [&]() { return sink.timeouts == 1; }));
+	CHECK(sink.matched == 7);
+	CHECK(sink.mismatched == 0);
+	CHECK(transport.is_connected());
+}
+
+static void test_rtu_over_tcp() {
+	LoopbackGateway gateway(TCP_PROTOCOL_RTU_OVER_TCP);
+	SofarSolar_TcpTransport transport("127.0.0.1", gateway.get_port(), TCP_PROTOCOL_RTU_OVER_TCP, 1, 200);
+	SofarSolar_Poller poller;
+	CheckingSink sink;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+	CHECK(run_until(poller, gateway, [&]() { return transport.is_connected(); }));
+	CHECK(transport.get_max_outstanding() == 1);
+
+	// A frame with a wrong CRC and the response of another unit in front of the response are skipped
+	queue_snapshot(poller, 3);
+	CHECK(run_until(poller, gateway, [&]() { return gateway.requests.size() == 1; }));
+	std::vector<uint8_t> data = gateway.response(gateway.requests[0]);
+	data[3] ^= 0xFF;
+	std::vector<uint8_t> response = gateway.response(gateway.requests[0], 7);
+	data.insert(data.end(), response.begin(), response.end());
+	response = gateway.response(gateway.requests[0]);
+	data.insert(data.end(), response.begin(), response.end());
+	gateway.send(data);
+	gateway.requests.clear();
+	CHECK(run_until(poller, gateway, [&]() { return sink.matched == 1; }));
+
+	// The second request is not answered in time, its late response is not taken for the one of the third request
+	CHECK(run_until(poller, gateway, [&]() { return gateway.requests.size() == 1; }));
+	LoopbackGateway::Request late = gateway.requests[0];
+	gateway.requests.clear();
+	CHECK(run_until(poller, gateway, [&]() { return sink.timeouts == 1; }));
+	gateway.send(gateway.response(late));
+	CHECK(run_until(poller, gateway, [&]() { return gateway.requests.size() == 1; }));
+	gateway.send(gateway.response(gateway.requests[0]));
+	gateway.requests.clear();
+	CHECK(run_until(poller, gateway, [&]() { return sink.matched == 2; }));
+	CHECK(sink.unmatched == 1);
+	CHECK(sink.mismatched == 0);
+}
+
+int main() {
+	test_modbus_tcp();
+	test_rtu_over_tcp();
+	return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Round trip of the telemetry packets through the encoder and the decoder, and over a loopback UDP socket
+#include "sofarsolar_telemetry.h"
+#include "test_util.h"
+#include "climits"
+#include "arpa/inet.h"
+#include "netinet/in.h"
+#include "sys/socket.h"
+#include "sys/time.h"
+#include "unistd.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+static bool same_samples(const std::vector<SofarSolar_TelemetrySample> &a, const std::vector<SofarSolar_TelemetrySample> &b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].channel != b[i].channel || a[i].timestamp != b[i].timestamp || a[i].value != b[i].value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_round_trip() {
+	// Negative values, the extremes of the raw values and a timestamp wrapping around
+	std::vector<SofarSolar_TelemetrySample> sent = {
+		{0, 4294967000u, 1234},
+		{1, 4294967100u, -5},
+		{0, 4294967290u, 1240},
+		{2, 30, INT32_MAX},
+		{2, 280, INT32_MIN},
+		{31, 280, 0},
+		{1, 100000, -70000},
+	};
+	SofarSolar_TelemetryEncoder encoder;
+	CHECK(encoder.empty());
+	for (const SofarSolar_TelemetrySample &sample : sent) {
+		CHECK(encoder.add(sample.channel, sample.timestamp, sample.value));
+	}
+	CHECK(encoder.add(TELEMETRY_MAX_CHANNELS, 0, 1)); // Not streamed, accepted without a sample
+	CHECK(encoder.get_count() == sent.size());
+	CHECK(encoder.get_start() == sent.front().timestamp);
+	uint32_t sequence = 1;
+	std::vector<SofarSolar_TelemetrySample> received;
+	CHECK(decode_telemetry_packet(encoder.data(), encoder.size(), sequence, received));
+	CHECK(sequence == 0);
+	CHECK(same_samples(sent, received));
+}
+
+static void test_full_packet() {
+	// Changing values of many channels fill the packet, the sample that did not fit starts the next one
+	SofarSolar_TelemetryEncoder encoder;
+	std::vector<SofarSolar_TelemetrySample> sent;
+	uint32_t timestamp = 1000;
+	int32_t value = 0;
+	SofarSolar_TelemetrySample sample{};
+	while (true) {
+		sample = SofarSolar_TelemetrySample{static_cast<uint8_t>(sent.size() % TELEMETRY_MAX_CHANNELS), timestamp, value};
+		if (!encoder.add(sample.channel, sample.timestamp, sample.value)) {
+			break;
+		}
+		sent.push_back(sample);
+		timestamp += 250;
+		value = value >= 0 ? -value - 100003 : -value + 7;
+	}
+	CHECK(encoder.size() <= TELEMETRY_MAX_PACKET);
+	CHECK(encoder.size() + TELEMETRY_MAX_SAMPLE > TELEMETRY_MAX_PACKET);
+	uint32_t sequence;
+	std::vector<SofarSolar_TelemetrySample> received;
+	CHECK(decode_telemetry_packet(encoder.data(), encoder.size(), sequence, received));
+	CHECK(same_samples(sent, received));
+
+	encoder.reset();
+	CHECK(encoder.empty());
+	CHECK(encoder.add(sample.channel, sample.timestamp, sample.value));
+	CHECK(decode_telemetry_packet(encoder.data(), encoder.size(), sequence, received));
+	CHECK(sequence == 1);
+	CHECK(same_samples({sample}, received));
+}
+
+static void test_sequence_gap() {
+	// Every packet decodes on its own, a lost packet shows as a gap in the sequence numbers
+	SofarSolar_TelemetryEncoder encoder;
+	std::vector<std::vector<uint8_t>> packets;
+	for (int i = 0; i < 3; i++) {
+		CHECK(encoder.add(3, 1000 * i, 500 + i));
+		CHECK(encoder.add(3, 1000 * i + 250, 510 + i));
+		packets.emplace_back(encoder.data(), encoder.data() + encoder.size());
+		encoder.reset();
+	}
+	uint32_t sequence;
+	std::vector<SofarSolar_TelemetrySample> received;
+	CHECK(decode_telemetry_packet(packets[0].data(), packets[0].size(), sequence, received));
+	uint32_t previous = sequence;
+	CHECK(decode_telemetry_packet(packets[2].data(), packets[2].size(), sequence, received));
+	CHECK(sequence - previous - 1 == 1);
+	CHECK(same_samples({{3, 2000, 502}, {3, 2250, 512}}, received));
+}
+
+static void test_malformed() {
+	SofarSolar_TelemetryEncoder encoder;
+	CHECK(encoder.add(0, 100, 300));
+	CHECK(encoder.add(1, 150, -300));
+	const std::vector<uint8_t> packet(encoder.data(), encoder.data() + encoder.size());
+	uint32_t sequence;
+	std::vector<SofarSolar_TelemetrySample> received;
+	for (size_t size = 0; size < packet.size(); size++) {
+		CHECK(!decode_telemetry_packet(packet.data(), size, sequence, received)); // Truncated
+	}
+	std::vector<uint8_t> data = packet;
+	data.push_back(0);
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Trailing byte
+	data = packet;
+	data[0] = 'X';
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Magic
+	data = packet;
+	data[2] = TELEMETRY_VERSION + 1;
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Version
+	data = packet;
+	data[13]++;
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Count larger than the samples
+	data = packet;
+	data[TELEMETRY_HEADER_SIZE] = TELEMETRY_MAX_CHANNELS;
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Channel
+	data.assign(packet.begin(), packet.begin() + TELEMETRY_HEADER_SIZE);
+	data[13] = 1;
+	data.push_back(0);
+	data.insert(data.end(), 10, 0x80);
+	data.push_back(0x00);
+	data.push_back(0x00);
+	CHECK(!decode_telemetry_packet(data.data(), data.size(), sequence, received)); // Varint longer than 64 bits
+}
+
+static void test_udp_loopback() {
+	// A packet sent the way the inverter sends it arrives as one datagram and decodes on the listener
+	int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+	int sender = ::socket(AF_INET, SOCK_DGRAM, 0);
+	CHECK(receiver >= 0 && sender >= 0);
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	CHECK(::bind(receiver, reinterpret_cast<struct sockaddr *>(&address), length) == 0);
+	CHECK(::getsockname(receiver, reinterpret_cast<struct sockaddr *>(&address), &length) == 0);
+	struct timeval timeout = {2, 0};
+	::setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	SofarSolar_TelemetryEncoder encoder;
+	std::vector<SofarSolar_TelemetrySample> sent;
+	for (uint32_t i = 0; encoder.add(i % 4, 5000 + i * 250, static_cast<int32_t>(i * 37) - 900); i++) {
+		sent.push_back(SofarSolar_TelemetrySample{static_cast<uint8_t>(i % 4), 5000 + i * 250, static_cast<int32_t>(i * 37) - 900});
+	}
+	CHECK(::sendto(sender, encoder.data(), encoder.size(), 0, reinterpret_cast<struct sockaddr *>(&address), length) == static_cast<ssize_t>(encoder.size()));
+	uint8_t buffer[TELEMETRY_MAX_PACKET + 1];
+	ssize_t received_size = ::recv(receiver, buffer, sizeof(buffer), 0);
+	CHECK(received_size == static_cast<ssize_t>(encoder.size()));
+	uint32_t sequence;
+	std::vector<SofarSolar_TelemetrySample> received;
+	CHECK(received_size > 0 && decode_telemetry_packet(buffer, received_size, sequence, received));
+	CHECK(same_samples(sent, received));
+	::close(sender);
+	::close(receiver);
+}
+
+int main() {
+	test_round_trip();
+	test_full_packet();
+	test_sequence_gap();
+	test_malformed();
+	test_udp_loopback();
+	return test_failures == 0 ? 0 : 1;
+}
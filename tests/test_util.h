@@ -0,0 +1,13 @@
+#pragma once
+#include "cstdio"
+
+// Minimal checks for the host tests. A failed check is printed and the test returns 1 from main.
+static int test_failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			test_failures++; \
+		} \
+	} while (0)
@@ -0,0 +1,104 @@
+// Checks which group writes the write cache skips, and that a repeated battery activation reaches the transport
+#include "sofarsolar_poller.h"
+#include "sofarsolar_write_cache.h"
+#include "test_util.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t clock_now = 0;
+
+static uint32_t now_ms() {
+	return clock_now;
+}
+
+class CountingTransport : public SofarSolar_Transport {
+public:
+	bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override {
+		transaction_id = 0;
+		this->frames.push_back(frame);
+		this->answer = true;
+		return true;
+	}
+
+	void loop() override {
+		if (this->answer) {
+			this->answer = false;
+			const std::vector<uint8_t> &frame = this->frames.back();
+			this->on_data(0, std::vector<uint8_t>(frame.begin() + 2, frame.begin() + 6)); // Address and count of the write
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> frames;
+
+protected:
+	bool answer = false;
+};
+
+// Stores acknowledged writes like the inverter does
+class CacheSink : public SofarSolar_Sink {
+public:
+	explicit CacheSink(SofarSolar_WriteCache &cache) : cache_(cache) {}
+	void on_read_response(const register_read_task & /*task*/, const FrameView & /*frame*/) override {}
+	void on_write_response(const register_write_task &task, const FrameView & /*frame*/) override { this->cache_.store(task.first_register_key, clock_now, task.data); }
+	void on_request_failed(const in_flight_request &request, uint8_t /*reason*/) override { this->cache_.forget(request.write_task.first_register_key); }
+
+protected:
+	SofarSolar_WriteCache &cache_;
+};
+
+// Writes the group unless the cache tells the inverter holds the data already, returns true if it was written
+static bool write_group(SofarSolar_Poller &poller, SofarSolar_WriteCache &cache, uint8_t group_key, const std::vector<uint8_t> &data, bool forced) {
+	if (cache.can_skip(group_key, data, FrameView(), forced, clock_now)) {
+		return false;
+	}
+	register_write_task task(group_key);
+	task.number_of_registers = data.size() / 2;
+	task.data = data;
+	poller.queue_write(task);
+	while (poller.get_write_queue_size() > 0 || poller.get_in_flight_count() > 0) {
+		poller.loop();
+		clock_now++;
+	}
+	return true;
+}
+
+int main() {
+	SofarSolar_WriteCache cache;
+	CountingTransport transport;
+	CacheSink sink(cache);
+	SofarSolar_Poller poller;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+
+	// A repeated control write of the same values is skipped until the refresh, a changed value or a forced write goes out
+	const std::vector<uint8_t> limit = {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xEC, 0x78, 0x00, 0x00, 0x13, 0x88};
+	CHECK(write_group(poller, cache, DESIRED_GRID_POWER, limit, false));
+	CHECK(!write_group(poller, cache, DESIRED_GRID_POWER, limit, false));
+	CHECK(write_group(poller, cache, DESIRED_GRID_POWER, limit, true));
+	std::vector<uint8_t> changed = limit;
+	changed[3] = 0x64;
+	CHECK(write_group(poller, cache, DESIRED_GRID_POWER, changed, false));
+	clock_now += WRITE_GROUP_REFRESH;
+	CHECK(write_group(poller, cache, DESIRED_GRID_POWER, changed, false));
+	CHECK(transport.frames.size() == 4);
+
+	// A read that shows other values than written makes the next write go out
+	CHECK(!write_group(poller, cache, DESIRED_GRID_POWER, changed, false));
+	const uint8_t lost[] = {0x00, 0x00, 0x00, 0x00};
+	cache.check_read(G3_registers.at(DESIRED_GRID_POWER).start_address, FrameView(lost, sizeof(lost)));
+	CHECK(write_group(poller, cache, DESIRED_GRID_POWER, changed, false));
+	// A read of the same values keeps the cache
+	cache.check_read(G3_registers.at(DESIRED_GRID_POWER).start_address, FrameView(changed.data(), 4));
+	CHECK(!write_group(poller, cache, DESIRED_GRID_POWER, changed, false));
+
+	// Every battery activation reaches the transport, even right after the one written at boot and with the values fetched
+	const std::vector<uint8_t> activation = {0x00, 0x01, 0x00, 0x01};
+	size_t before = transport.frames.size();
+	CHECK(write_group(poller, cache, BATTERY_ACTIVE_CONTROL, activation, false));
+	CHECK(write_group(poller, cache, BATTERY_ACTIVE_CONTROL, activation, false));
+	CHECK(!cache.can_skip(BATTERY_ACTIVE_CONTROL, activation, FrameView(activation.data(), activation.size()), false, clock_now));
+	CHECK(transport.frames.size() == before + 2);
+	CHECK(transport.frames.back()[1] == 0x10);
+	return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+// Checks that the zero export control law settles against the inverter, meter and load models
+#include "sofarsolar_simulation.h"
+#include "test_util.h"
+
+using namespace esphome::sofarsolar_inverter;
+
+static SofarSolar_LoadProfile steps_and_ramp() {
+	SofarSolar_LoadProfile load(800);
+	load.add_step(60000, 3000);
+	load.add_step(120000, 500);
+	load.add_ramp(180000, 30000, 2500);
+	return load;
+}
+
+int main() {
+	// Without delays and ramp limit the output follows each step with the next update of the limit
+	SofarSolar_SimulatedInverter ideal;
+	ideal.ramp_rate_w_per_s = 100000;
+	ideal.command_delay_ms = 0;
+	ideal.measurement_delay_ms = 0;
+	SofarSolar_SimulatedMeter fast_meter;
+	fast_meter.sample_period_ms = 10;
+	fast_meter.latency_ms = 0;
+	SofarSolar_SimulationReport report = SofarSolar_ZeroExportSimulation(ideal, fast_meter, steps_and_ramp()).run(300000);
+	CHECK(report.unsettled_steps == 0);
+	CHECK(report.settling_time_ms <= ZERO_EXPORT_INTERVAL);
+	CHECK(report.writes == 300);
+	CHECK(report.exported_energy_wh < 1.0f);
+
+	// The same run gives the same report
+	SofarSolar_SimulationReport again = SofarSolar_ZeroExportSimulation(ideal, fast_meter, steps_and_ramp()).run(300000);
+	CHECK(again.exported_energy_wh == report.exported_energy_wh);
+	CHECK(again.settling_time_ms == report.settling_time_ms);
+	CHECK(again.limit_changes == report.limit_changes);
+
+	// A ramp limited inverter needs the time of the largest step at its ramp rate plus an update or two
+	SofarSolar_SimulatedInverter ramped = ideal;
+	ramped.ramp_rate_w_per_s = 600;
+	report = SofarSolar_ZeroExportSimulation(ramped, fast_meter, steps_and_ramp()).run(300000);
+	CHECK(report.unsettled_steps == 0);
+	CHECK(report.settling_time_ms <= 2500 * 1000 / 600 + 2 * ZERO_EXPORT_INTERVAL);
+
+	// Without enough PV and battery power the grid covers the rest and nothing is exported
+	SofarSolar_SimulatedInverter weak = ideal;
+	weak.available_power_w = 400;
+	report = SofarSolar_ZeroExportSimulation(weak, fast_meter, steps_and_ramp()).run(300000);
+	CHECK(report.max_export_w == 0);
+	CHECK(report.imported_energy_wh > 100);
+	return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Compares the decode time per register of the cached decode plans against the per register decoding they replaced.
+//
+// Usage: sofarsolar_decode_bench [iterations]
+//
+// The per register path resolves every register of a response through the address index and the catalogue, switches
+// on its type and looks up the scale. The plan path builds the descriptors once per block layout, like the adapter
+// caches them, and converts a response with decode_block. Both paths must decode the same values.
+#include "sofarsolar_registers.h"
+#include "chrono"
+#include "cmath"
+#include "cstdio"
+#include "cstdlib"
+#include "random"
+
+using namespace esphome::sofarsolar_inverter;
+
+struct block {
+	uint16_t start_address;
+	uint16_t register_count;
+};
+
+// Blocks of the size the adapter reads, over the realtime registers of the catalogue
+static const block blocks[] = {
+	{0x0404, 0x40},
+	{0x0484, 0x30},
+	{0x0580, 0x30},
+	{0x05C4, 0x10},
+	{0x0604, 0x68},
+	{0x0684, 0x30},
+};
+
+static size_t decode_per_register(const block &block, const FrameView &frame, std::map<uint8_t, float> &cache) {
+	size_t decoded = 0;
+	const std::map<uint16_t, uint8_t> &address_index = G3_address_index();
+	uint32_t end_address = block.start_address + block.register_count;
+	for (auto it = address_index.lower_bound(block.start_address); it != address_index.end() && it->first < end_address; ++it) {
+		const SofarSolar_Register &reg = G3_registers.at(it->second);
+		if (reg.start_address + reg.register_count > end_address) {
+			continue;
+		}
+		size_t offset = (reg.start_address - block.start_address) * 2;
+		float new_state;
+		bool valid;
+		switch (reg.type) {
+		case U_WORD: {
+				uint16_t value = 0;
+				valid = frame.read_uint16(offset, value);
+				new_state = static_cast<float>(value) * get_power_of_ten(reg.scale);
+				break;
+		}
+		case S_WORD: {
+				uint16_t value = 0;
+				valid = frame.read_uint16(offset, value);
+				new_state = static_cast<float>(static_cast<int16_t>(value)) * get_power_of_ten(reg.scale);
+				break;
+		}
+		case U_DWORD: {
+				uint32_t value = 0;
+				valid = frame.read_uint32(offset, value);
+				new_state = static_cast<float>(value) * get_power_of_ten(reg.scale);
+				break;
+		}
+		case S_DWORD: {
+				uint32_t value = 0;
+				valid = frame.read_uint32(offset, value);
+				new_state = static_cast<float>(static_cast<int32_t>(value)) * get_power_of_ten(reg.scale);
+				break;
+		}
+		default:
+			continue;
+		}
+		if (!valid) {
+			break;
+		}
+		auto entry = cache.find(it->second); // The dynamic entry lookup of the adapter
+		if (entry != cache.end()) {
+			entry->second = new_state;
+		}
+		decoded++;
+	}
+	return decoded;
+}
+
+int main(int argc, char **argv) {
+	unsigned long iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+	std::mt19937 random(0x50FA);
+	const size_t block_count = sizeof(blocks) / sizeof(blocks[0]);
+	std::vector<std::vector<uint8_t>> responses(block_count);
+	std::vector<SofarSolar_DecodePlan> plans(block_count);
+	std::map<uint8_t, float> cache;
+	size_t registers_per_round = 0;
+	for (size_t i = 0; i < block_count; i++) {
+		responses[i].resize(blocks[i].register_count * 2);
+		for (uint8_t &byte : responses[i]) {
+			byte = static_cast<uint8_t>(random());
+		}
+		build_decode_plan(blocks[i].start_address, blocks[i].register_count, plans[i]);
+		registers_per_round += plans[i].numeric.size();
+		for (const SofarSolar_DecodeEntry &entry : plans[i].registers) {
+			cache[entry.register_key] = NAN;
+		}
+	}
+
+	// Both paths have to agree before their times are compared
+	for (size_t i = 0; i < block_count; i++) {
+		FrameView frame(responses[i].data(), responses[i].size());
+		decode_per_register(blocks[i], frame, cache);
+		decode_block(frame, plans[i].numeric.data(), plans[i].numeric.size(), plans[i].values.data());
+		for (const DecodeDescriptor &descriptor : plans[i].numeric) {
+			float expected = cache.at(plans[i].registers[descriptor.slot].register_key);
+			if (plans[i].values[descriptor.slot] != expected) {
+				std::fprintf(stderr, "Register %u decoded as %g instead of %g\n", plans[i].registers[descriptor.slot].register_key, plans[i].values[descriptor.slot], expected);
+				return 1;
+			}
+		}
+	}
+
+	volatile size_t decoded = 0; // Keeps the compiler from dropping the loops
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long n = 0; n < iterations; n++) {
+		for (size_t i = 0; i < block_count; i++) {
+			decoded = decoded + decode_per_register(blocks[i], FrameView(responses[i].data(), responses[i].size()), cache);
+		}
+	}
+	auto middle = std::chrono::steady_clock::now();
+	for (unsigned long n = 0; n < iterations; n++) {
+		for (size_t i = 0; i < block_count; i++) {
+			decoded = decoded + decode_block(FrameView(responses[i].data(), responses[i].size()), plans[i].numeric.data(), plans[i].numeric.size(), plans[i].values.data());
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double registers = static_cast<double>(registers_per_round) * iterations;
+	double per_register = std::chrono::duration<double, std::nano>(middle - start).count() / registers;
+	double plan = std::chrono::duration<double, std::nano>(end - middle).count() / registers;
+	std::printf("%zu blocks, %zu numeric registers, %lu iterations\n", block_count, registers_per_round, iterations);
+	std::printf("Per register decoding: %.2f ns/register\n", per_register);
+	std::printf("Decode plan:           %.2f ns/register\n", plan);
+	std::printf("Speedup:               %.1fx\n", plan > 0 ? per_register / plan : 0.0);
+	return 0;
+}
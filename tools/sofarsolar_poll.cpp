@@ -0,0 +1,76 @@
+// Polls an inverter through a Linux serial device or pty and prints the decoded registers.
+//
+// Usage: sofarsolar_poll <device> [baud rate] [modbus address] [interval ms] [rounds]
+//
+// Every round reads the registers of the power flow snapshot. Without a number of rounds it polls until stopped.
+#include "sofarsolar_poller.h"
+#include "sofarsolar_serial.h"
+#include "chrono"
+#include "cstdio"
+#include "cstdlib"
+#include "thread"
+
+using namespace esphome::sofarsolar_inverter;
+
+static uint32_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class PrintSink : public SofarSolar_Sink {
+public:
+	void on_read_response(const register_read_task &task, const FrameView &frame) override {
+		SofarSolar_DecodePlan plan;
+		build_decode_plan(task.start_address, task.register_count, plan);
+		decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data());
+		for (const DecodeDescriptor &descriptor : plan.numeric) {
+			const SofarSolar_DecodeEntry &entry = plan.registers[descriptor.slot];
+			std::printf("%u 0x%04X key %u = %g\n", now_ms(), task.start_address + entry.offset / 2, entry.register_key, plan.values[descriptor.slot]);
+		}
+	}
+
+	void on_write_response(const register_write_task & /*task*/, const FrameView & /*frame*/) override {}
+
+	void on_request_failed(const in_flight_request &request, uint8_t reason) override {
+		std::printf("%u 0x%04X failed with reason %u\n", now_ms(), request.read_task.start_address, reason);
+	}
+};
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: %s <device> [baud rate] [modbus address] [interval ms] [rounds]\n", argv[0]);
+		return 2;
+	}
+	uint32_t baud_rate = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 9600;
+	uint8_t modbus_address = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1;
+	uint32_t interval = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 5000;
+	unsigned long rounds = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+
+	SofarSolar_SerialTransport transport(argv[1], baud_rate);
+	if (!transport.open()) {
+		std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	PrintSink sink;
+	SofarSolar_Poller poller;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+	poller.set_modbus_address(modbus_address);
+
+	for (unsigned long round = 0; rounds == 0 || round < rounds; round++) {
+		uint32_t start = now_ms();
+		for (uint8_t register_key : power_flow_snapshot_registers) {
+			poller.queue_read(register_read_task(register_key));
+		}
+		while (poller.get_read_queue_size() > 0 || poller.get_in_flight_count() > 0) {
+			poller.loop();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::fflush(stdout);
+		uint32_t elapsed = now_ms() - start;
+		if (elapsed < interval && (rounds == 0 || round + 1 < rounds)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(interval - elapsed));
+		}
+	}
+	return 0;
+}
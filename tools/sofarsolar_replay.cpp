@@ -0,0 +1,269 @@
+// Replays a bus recorder dump through the poller and decodes the recorded responses.
+//
+// Usage: sofarsolar_replay <log file>
+//
+// The log is the output of the bus_recorder_dump button, lines without "REC" are ignored. Every recorded request is
+// queued to the poller again, a replay transport answers it with the response that followed it in the recording.
+// Requests without a response run into the timeout of the poller, like they did on the bus.
+#include "sofarsolar_poller.h"
+#include "cstdio"
+#include "cstring"
+#include "fstream"
+#include "sstream"
+#include "string"
+
+using namespace esphome::sofarsolar_inverter;
+
+struct recorded_frame {
+	uint32_t timestamp; // Time in milliseconds the frame was recorded
+	uint8_t direction; // RECORD_TX, RECORD_RX or RECORD_ERROR
+	size_t size; // Original size of the frame, the recorded bytes may be truncated
+	std::vector<uint8_t> data; // Recorded bytes
+};
+
+static uint32_t replay_now = 0; // Time of the replay in milliseconds, follows the timestamps of the recording
+
+static uint32_t now_ms() {
+	return replay_now;
+}
+
+static bool parse_frame(const std::string &line, recorded_frame &frame) {
+	size_t start = line.find("REC ");
+	if (start == std::string::npos) {
+		return false;
+	}
+	std::istringstream stream(line.substr(start + 4));
+	std::string direction;
+	if (!(stream >> frame.timestamp >> direction >> frame.size)) {
+		return false;
+	}
+	if (direction == "TX") {
+		frame.direction = RECORD_TX;
+	} else if (direction == "RX") {
+		frame.direction = RECORD_RX;
+	} else if (direction == "ERR") {
+		frame.direction = RECORD_ERROR;
+	} else {
+		return false;
+	}
+	frame.data.clear();
+	std::string byte;
+	while (stream >> byte) {
+		frame.data.push_back(static_cast<uint8_t>(std::strtoul(byte.c_str(), nullptr, 16)));
+	}
+	return true;
+}
+
+static std::string to_hex(const uint8_t *data, size_t size) {
+	std::string result;
+	for (size_t i = 0; i < size; i++) {
+		char buf[4];
+		std::snprintf(buf, sizeof(buf), "%02X ", data[i]);
+		result += buf;
+	}
+	return result;
+}
+
+// Answers the requests of the poller from the recording. A request is matched to the next recorded request, the
+// recorded response following it is handed back on the next loop.
+class ReplayTransport : public SofarSolar_Transport {
+public:
+	explicit ReplayTransport(const std::vector<recorded_frame> &frames) : frames_(frames) {}
+
+	bool send(const std::vector<uint8_t> &frame, uint16_t &transaction_id) override {
+		transaction_id = 0;
+		while (this->position_ < this->frames_.size() && this->frames_[this->position_].direction != RECORD_TX) {
+			this->position_++; // Response without a request, the recording started in the middle of an operation
+		}
+		if (this->position_ == this->frames_.size()) {
+			this->pending_ = true; // Runs into the timeout
+			return false;
+		}
+		const std::vector<uint8_t> &recorded = this->frames_[this->position_].data;
+		if (recorded.size() > frame.size() || !std::equal(recorded.begin(), recorded.end(), frame.begin())) {
+			this->mismatches++;
+		}
+		replay_now = this->frames_[this->position_].timestamp;
+		this->position_++;
+		this->pending_ = true;
+		return true;
+	}
+
+	void loop() override {
+		if (!this->pending_) {
+			return;
+		}
+		this->pending_ = false;
+		if (this->position_ == this->frames_.size() || this->frames_[this->position_].direction == RECORD_TX) {
+			replay_now += this->get_timeout() + 1; // Not answered on the bus either
+			return;
+		}
+		const recorded_frame &response = this->frames_[this->position_++];
+		replay_now = response.timestamp;
+		if (response.direction == RECORD_ERROR) {
+			this->on_error(0, response.data.size() > 0 ? response.data[0] : 0, response.data.size() > 1 ? response.data[1] : 0);
+		} else {
+			this->on_data(0, response.data);
+		}
+	}
+
+	bool is_pending() const { return this->pending_; }
+
+	uint32_t mismatches = 0; // Requests of the poller that differ from the recorded request
+
+protected:
+	const std::vector<recorded_frame> &frames_;
+	size_t position_ = 0; // Index of the next recorded frame
+	bool pending_ = false; // Flag to indicate that a request waits for its recorded response
+};
+
+class ReplaySink : public SofarSolar_Sink {
+public:
+	void on_read_response(const register_read_task &task, const FrameView &frame) override {
+		this->responses++;
+		this->print_registers(task.start_address, task.register_count, frame);
+	}
+
+	void on_write_response(const register_write_task &task, const FrameView &frame) override {
+		this->responses++;
+		std::printf("%u 0x%04X write of %u registers acknowledged\n", replay_now, task.start_address, task.number_of_registers);
+		if (task.read_register_count > 0) {
+			this->print_registers(task.read_start_address, task.read_register_count, frame);
+		}
+	}
+
+	void on_request_failed(const in_flight_request &request, uint8_t reason) override {
+		uint16_t start_address = request.is_write ? request.write_task.start_address : request.read_task.start_address;
+		if (reason == REQUEST_TIMEOUT) {
+			this->timeouts++;
+			std::printf("%u 0x%04X timeout\n", replay_now, start_address);
+		} else if (reason == REQUEST_EXCEPTION) {
+			this->exceptions++;
+			std::printf("%u 0x%04X exception\n", replay_now, start_address);
+		} else {
+			std::printf("%u 0x%04X failed with reason %u\n", replay_now, start_address, reason);
+		}
+	}
+
+	uint32_t responses = 0;
+	uint32_t exceptions = 0;
+	uint32_t timeouts = 0;
+
+protected:
+	void print_registers(uint16_t start_address, uint16_t register_count, const FrameView &frame) {
+		SofarSolar_DecodePlan plan;
+		build_decode_plan(start_address, register_count, plan);
+		if (plan.registers.empty()) {
+			std::printf("%u 0x%04X raw %s\n", replay_now, start_address, to_hex(frame.data(), frame.size()).c_str());
+			return;
+		}
+		decode_block(frame, plan.numeric.data(), plan.numeric.size(), plan.values.data());
+		for (size_t i = 0; i < plan.registers.size(); i++) {
+			const SofarSolar_DecodeEntry &entry = plan.registers[i];
+			uint16_t address = start_address + entry.offset / 2;
+			if (!frame.contains(entry.offset, entry.register_count * 2)) {
+				std::printf("%u 0x%04X key %u truncated\n", replay_now, address, entry.register_key);
+			} else if (entry.type == ASCII || entry.type == ENUM || entry.type == BITMAP) {
+				std::printf("%u 0x%04X key %u raw %s\n", replay_now, address, entry.register_key, to_hex(frame.data() + entry.offset, entry.register_count * 2).c_str());
+			} else {
+				std::printf("%u 0x%04X key %u = %g\n", replay_now, address, entry.register_key, plan.values[i]);
+			}
+		}
+	}
+};
+
+// Builds the poller task of a recorded request, returns false for function codes the poller does not send
+static bool build_task(const recorded_frame &frame, in_flight_request &request) {
+	const std::vector<uint8_t> &data = frame.data;
+	if (data.size() < 6) {
+		return false;
+	}
+	uint16_t start_address = (data[2] << 8) | data[3];
+	uint16_t register_count = (data[4] << 8) | data[5];
+	auto key = G3_address_index().find(start_address);
+	uint8_t register_key = key != G3_address_index().end() ? key->second : 0;
+	if (data[1] == 0x03 || data[1] == 0x04) {
+		request.is_write = false;
+		request.read_task.register_key = register_key;
+		request.read_task.start_address = start_address;
+		request.read_task.register_count = register_count;
+		request.read_task.scan = register_key == 0;
+		return true;
+	}
+	if (data[1] == 0x10 && data.size() >= 7 && frame.size == data.size()) {
+		request.is_write = true;
+		request.write_task.first_register_key = register_key;
+		request.write_task.start_address = start_address;
+		request.write_task.number_of_registers = register_count;
+		request.write_task.data.assign(data.begin() + 7, data.end());
+		return true;
+	}
+	if (data[1] == 0x17 && data.size() >= 11 && frame.size == data.size()) {
+		uint16_t write_start_address = (data[6] << 8) | data[7];
+		auto write_key = G3_address_index().find(write_start_address);
+		request.is_write = true;
+		request.write_task.first_register_key = write_key != G3_address_index().end() ? write_key->second : 0;
+		request.write_task.start_address = write_start_address;
+		request.write_task.number_of_registers = (data[8] << 8) | data[9];
+		request.write_task.data.assign(data.begin() + 11, data.end());
+		request.write_task.read_register_key = register_key;
+		request.write_task.read_start_address = start_address;
+		request.write_task.read_register_count = register_count;
+		return true;
+	}
+	return false;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		std::fprintf(stderr, "Usage: %s <log file>\n", argv[0]);
+		return 2;
+	}
+	std::ifstream file(argv[1]);
+	if (!file) {
+		std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+		return 2;
+	}
+	std::vector<recorded_frame> frames;
+	std::string line;
+	while (std::getline(file, line)) {
+		recorded_frame frame;
+		if (parse_frame(line, frame)) {
+			frames.push_back(frame);
+		}
+	}
+
+	ReplayTransport transport(frames);
+	ReplaySink sink;
+	SofarSolar_Poller poller;
+	poller.set_clock(now_ms);
+	poller.set_sink(&sink);
+	poller.set_transport(&transport);
+
+	uint32_t requests = 0;
+	uint32_t skipped = 0;
+	for (const recorded_frame &frame : frames) {
+		if (frame.direction != RECORD_TX) {
+			continue;
+		}
+		in_flight_request request;
+		if (!build_task(frame, request)) {
+			skipped++; // Unknown function code or a write truncated by the recorder
+			continue;
+		}
+		requests++;
+		poller.set_modbus_address(frame.data[0]);
+		// One request at a time, the priority queues of the poller would reorder the recorded requests
+		if (request.is_write) {
+			poller.queue_write(request.write_task);
+		} else {
+			poller.queue_read(request.read_task);
+		}
+		while (poller.get_read_queue_size() > 0 || poller.get_write_queue_size() > 0 || poller.get_in_flight_count() > 0 || transport.is_pending()) {
+			poller.loop();
+		}
+	}
+
+	std::printf("Replayed %u requests: %u responses, %u exceptions, %u timeouts, %u mismatches, %u skipped\n", requests, sink.responses, sink.exceptions, sink.timeouts, transport.mismatches, skipped);
+	return transport.mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// Runs the zero export control law against the inverter, meter and load models and prints the report.
+//
+// Usage: sofarsolar_zero_export_sim [load trace]
+//
+// Without a trace the load steps from 800 W to 3000 W, down to 500 W and ramps up to 2500 W within 5 minutes. A trace
+// has one "<time ms> <load W>" pair per line in time order, the simulation runs until its last point.
+#include "sofarsolar_simulation.h"
+#include "cstdio"
+#include "fstream"
+
+using namespace esphome::sofarsolar_inverter;
+
+int main(int argc, char **argv) {
+	SofarSolar_SimulatedInverter inverter;
+	inverter.max_output_power_w = 6000;
+	inverter.ramp_rate_w_per_s = 600;
+	SofarSolar_SimulatedMeter meter;
+	meter.sample_period_ms = 1000;
+
+	SofarSolar_LoadProfile load(800);
+	uint32_t duration = 300000;
+	if (argc > 1) {
+		std::ifstream file(argv[1]);
+		if (!file) {
+			std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+			return 2;
+		}
+		uint32_t time;
+		float power;
+		bool first = true;
+		while (file >> time >> power) {
+			if (first) {
+				load = SofarSolar_LoadProfile(power);
+				first = false;
+			}
+			load.add_point(time, power);
+			duration = time;
+		}
+	} else {
+		load.add_step(60000, 3000);
+		load.add_step(120000, 500);
+		load.add_ramp(180000, 30000, 2500);
+	}
+
+	SofarSolar_ZeroExportSimulation simulation(inverter, meter, load);
+	SofarSolar_SimulationReport report = simulation.run(duration);
+	std::printf("Exported %.2f Wh, imported %.2f Wh\n", report.exported_energy_wh, report.imported_energy_wh);
+	std::printf("Max export %.0f W, settling time %u ms, unsettled steps %u\n", report.max_export_w, report.settling_time_ms, report.unsettled_steps);
+	std::printf("Writes %u, limit changes %u\n", report.writes, report.limit_changes);
+	return 0;
+}